@@ -0,0 +1,18 @@
+REM Build script for benchmarks
+@ECHO OFF
+SetLocal EnableDelayedExpansion
+
+REM Get a list of all the .c files.
+SET cFilenames=
+FOR /R %%f in (*.c) do (
+    SET cFilenames=!cFilenames! %%f
+)
+
+SET assembly=bench
+SET compilerFlags=-g -O2
+SET includeFlags=-I../engine
+SET linkerFlags=-L../bin/ -lengine
+SET defines=
+
+ECHO "Building %assembly%%..."
+clang %cFilenames% %compilerFlags% -o ../bin/%assembly%.exe %defines% %includeFlags% %linkerFlags%
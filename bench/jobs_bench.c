@@ -0,0 +1,73 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "core/caffeine_jobs.h"
+#include "core/caffeine_time.h"
+
+// jobs submitted per caff_jobs_run, below the capacity of a job deque so none of them run inline
+#define BENCH_BATCH 1024
+#define BENCH_DEFAULT_JOBS 1000000
+
+static void bench_empty_job(void *data)
+{
+  (void)data;
+}
+
+static double bench_run(uint32_t worker_count, uint32_t job_count)
+{
+  if (!caff_jobs_init(worker_count))
+    return -1.0;
+
+  caff_job jobs[BENCH_BATCH];
+  for (uint32_t i = 0; i < BENCH_BATCH; i++)
+    jobs[i] = (caff_job){.function = bench_empty_job, .data = NULL};
+
+  // one batch to wake the workers up before timing
+  caff_job_counter counter = {0};
+  caff_jobs_run(jobs, BENCH_BATCH, &counter);
+  caff_jobs_wait(&counter);
+
+  double spawn = 0.0;
+  double start = caff_time_precise();
+
+  for (uint32_t done = 0; done < job_count; done += BENCH_BATCH)
+  {
+    uint32_t count = job_count - done < BENCH_BATCH ? job_count - done : BENCH_BATCH;
+    double spawn_start = caff_time_precise();
+    caff_jobs_run(jobs, count, &counter);
+    spawn += caff_time_precise() - spawn_start;
+    caff_jobs_wait(&counter);
+  }
+
+  double elapsed = caff_time_precise() - start;
+
+  // without workers caff_jobs_run executes every job before returning, there is no spawn to tell apart
+  if (caff_jobs_worker_count() == 0)
+    printf("%-8s workers=%-3u jobs=%-9u %8.1f ns/job\n", "inline", 0u, job_count, elapsed * 1e9 / job_count);
+  else
+    printf("%-8s workers=%-3u jobs=%-9u %8.1f ns/job %8.1f ns/spawn\n", "stealing", caff_jobs_worker_count(), job_count,
+           elapsed * 1e9 / job_count, spawn * 1e9 / job_count);
+
+  caff_jobs_shutdown();
+  return elapsed;
+}
+
+int main(int argc, char **argv)
+{
+  // bench [jobs] [workers], 0 workers starts one per extra processor
+  uint32_t job_count = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : BENCH_DEFAULT_JOBS;
+  uint32_t worker_count = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 10) : 0;
+  if (job_count == 0)
+    job_count = BENCH_DEFAULT_JOBS;
+
+  // baseline, the caller runs every job inline without touching a deque
+  if (bench_run(CAFF_JOBS_NO_WORKERS, job_count) < 0.0)
+    return 1;
+
+  // the caller pushes every job to its deque, spawn is the time spent pushing and waking the workers,
+  // the workers steal while the caller drains the deque in caff_jobs_wait
+  if (bench_run(worker_count, job_count) < 0.0)
+    return 1;
+
+  return 0;
+}
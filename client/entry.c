@@ -20,8 +20,8 @@ void update_position_a(query_it iterator, uint32_t lenght, double delta_time)
   if (caff_input_is_key_pressed(KEY_A))
   {
 
-    position_component *positions = (position_component *)ecs_iterator_get_component_data_by_name(iterator, "position_component");
-    speed_component *speeds = (speed_component *)ecs_iterator_get_component_data_by_name(iterator, "speed_component");
+    position_component *positions = ecs_iterator_column(iterator, position_component, 0);
+    speed_component *speeds = ecs_iterator_column(iterator, speed_component, 1);
 
     for (size_t i = 0; i < lenght; i++)
     {
@@ -38,8 +38,8 @@ void update_position_b(query_it iterator, uint32_t lenght, double delta_time)
   if (caff_input_is_key_pressed(KEY_S))
   {
 
-    position_component *positions = (position_component *)ecs_iterator_get_component_data_by_name(iterator, "position_component");
-    speed_component *speeds = (speed_component *)ecs_iterator_get_component_data_by_name(iterator, "speed_component");
+    position_component *positions = ecs_iterator_column(iterator, position_component, 0);
+    speed_component *speeds = ecs_iterator_column(iterator, speed_component, 1);
 
     for (size_t i = 0; i < lenght; i++)
     {
@@ -53,11 +53,11 @@ void update_position_b(query_it iterator, uint32_t lenght, double delta_time)
 
 void register_components(ecs_world *world)
 {
-  component_id position_id = ecs_world_add_component(world, "position_component", sizeof(position_component), 8);
-  component_id speed_id = ecs_world_add_component(world, "speed_component", sizeof(speed_component), 8);
-  component_id physic_id = ecs_world_add_component(world, "physic_component", sizeof(physic_component), 8);
-  component_id team_a_id = ecs_world_add_tag(world, "team_a");
-  component_id team_b_id = ecs_world_add_tag(world, "team_b");
+  component_id position_id = ecs_world_add_component(world, "position_component", sizeof(position_component), 8, NULL);
+  component_id speed_id = ecs_world_add_component(world, "speed_component", sizeof(speed_component), 8, NULL);
+  component_id physic_id = ecs_world_add_component(world, "physic_component", sizeof(physic_component), 8, NULL);
+  component_id team_a_id = ecs_world_add_row_tag(world, "team_a");
+  component_id team_b_id = ecs_world_add_row_tag(world, "team_b");
 }
 
 void register_entities(ecs_world *world)
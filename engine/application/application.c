@@ -8,6 +8,7 @@
 #include "../core/caffeine_events.h"
 #include "../core/caffeine_input.h"
 #include "../core/caffeine_time.h"
+#include "../core/caffeine_jobs.h"
 
 typedef struct
 {
@@ -61,6 +62,15 @@ bool caffeine_application_init(char *app_name, void (*ecs_init)(ecs_world *))
 
     cff_platform_set_quit_clkb(_caffeine_on_quit);
 
+    if (!caff_jobs_init(0))
+    {
+        caff_log(LOG_LEVEL_ERROR, "Failed to initialize job system\n");
+
+        caffeine_application_shutdown();
+
+        return false;
+    }
+
     caff_log(LOG_LEVEL_TRACE, "Application initalized\n");
 
     _application.world = ecs_world_new();
@@ -103,6 +113,7 @@ void caffeine_application_shutdown()
 
     ecs_world_release(_application.world);
 
+    caff_jobs_shutdown();
     cff_platform_shutdown();
     caff_input_end();
     caffeine_event_shutdown();
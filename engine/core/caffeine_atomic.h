@@ -0,0 +1,70 @@
+#pragma once
+
+#include "../caffeine_types.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CFF_CPU_RELAX() __builtin_ia32_pause()
+#else
+#define CFF_CPU_RELAX()
+#endif
+
+typedef volatile int32_t cff_spinlock;
+
+static inline int32_t cff_atomic_load_i32(const volatile int32_t *value)
+{
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+
+static inline void cff_atomic_store_i32(volatile int32_t *value, int32_t new_value)
+{
+    __atomic_store_n(value, new_value, __ATOMIC_RELEASE);
+}
+
+static inline int32_t cff_atomic_add_i32(volatile int32_t *value, int32_t amount)
+{
+    return __atomic_add_fetch(value, amount, __ATOMIC_ACQ_REL);
+}
+
+static inline bool cff_atomic_cas_i32(volatile int32_t *value, int32_t expected, int32_t desired)
+{
+    return __atomic_compare_exchange_n(value, &expected, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+static inline int64_t cff_atomic_load_i64(const volatile int64_t *value)
+{
+    return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+
+static inline void cff_atomic_store_i64(volatile int64_t *value, int64_t new_value)
+{
+    __atomic_store_n(value, new_value, __ATOMIC_RELEASE);
+}
+
+static inline int64_t cff_atomic_add_i64(volatile int64_t *value, int64_t amount)
+{
+    return __atomic_add_fetch(value, amount, __ATOMIC_ACQ_REL);
+}
+
+static inline bool cff_atomic_cas_i64(volatile int64_t *value, int64_t expected, int64_t desired)
+{
+    return __atomic_compare_exchange_n(value, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+}
+
+static inline void cff_atomic_fence()
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+static inline void cff_spinlock_lock(cff_spinlock *lock)
+{
+    while (__atomic_exchange_n(lock, 1, __ATOMIC_ACQUIRE))
+    {
+        while (__atomic_load_n(lock, __ATOMIC_RELAXED))
+            CFF_CPU_RELAX();
+    }
+}
+
+static inline void cff_spinlock_unlock(cff_spinlock *lock)
+{
+    __atomic_store_n(lock, 0, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,380 @@
+#include "caffeine_jobs.h"
+#include "caffeine_atomic.h"
+#include "caffeine_memory.h"
+#include "caffeine_logging.h"
+#include "../platform/caffeine_platform.h"
+
+// must be a power of two
+#define JOB_DEQUE_CAPACITY 4096
+#define JOB_STEAL_ATTEMPTS 64
+
+typedef struct
+{
+    caff_job_fn function;
+    void *data;
+    caff_job_counter *counter;
+} job_entry;
+
+// Chase-Lev deque, the owner thread pushes and pops at the bottom, the others steal from the top
+typedef struct
+{
+    volatile int64_t top;
+    uint8_t top_padding[64 - sizeof(int64_t)];
+    volatile int64_t bottom;
+    uint8_t bottom_padding[64 - sizeof(int64_t)];
+    job_entry *buffer;
+} job_deque;
+
+typedef struct
+{
+    // deque 0 belongs to the thread that called caff_jobs_init, the others to the workers
+    job_deque *deques;
+    uint32_t deque_count;
+
+    cff_thread *workers;
+    uint32_t worker_count;
+    cff_semaphore wake;
+    volatile int32_t sleeping;
+    volatile int32_t running;
+} job_system;
+
+static job_system _jobs = {0};
+static _Thread_local uint32_t _thread_index = 0;
+static _Thread_local uint32_t _thread_seed = 0;
+
+static bool _deque_init(job_deque *deque);
+static void _deque_release(job_deque *deque);
+static bool _deque_push(job_deque *deque, job_entry entry);
+static bool _deque_pop(job_deque *deque, job_entry *out);
+static bool _deque_steal(job_deque *deque, job_entry *out);
+static void _slot_write(job_entry *slot, job_entry entry);
+static job_entry _slot_read(const job_entry *slot);
+
+static void _jobs_release(void);
+static bool _jobs_find(job_entry *out);
+static void _jobs_execute(job_entry entry);
+static uint32_t _jobs_worker_main(void *data);
+
+bool caff_jobs_init(uint32_t worker_count)
+{
+    caff_log(LOG_LEVEL_TRACE, "Init job system\n");
+
+    if (worker_count == 0)
+    {
+        uint32_t processors = cff_platform_processor_count();
+        worker_count = processors > 1 ? processors - 1 : 0;
+    }
+    else if (worker_count == CAFF_JOBS_NO_WORKERS)
+    {
+        worker_count = 0;
+    }
+
+    _jobs.deques = (job_deque *)CFF_ALLOC(sizeof(job_deque) * (worker_count + 1), "JOB DEQUES");
+    _jobs.workers = (cff_thread *)CFF_ALLOC(sizeof(cff_thread) * (worker_count ? worker_count : 1), "JOB WORKERS");
+
+    if (_jobs.deques == NULL || _jobs.workers == NULL)
+    {
+        caff_log(LOG_LEVEL_ERROR, "Failed to allocate job system\n");
+        _jobs_release();
+        return false;
+    }
+
+    for (uint32_t i = 0; i < worker_count + 1; i++)
+    {
+        if (!_deque_init(_jobs.deques + i))
+        {
+            caff_log(LOG_LEVEL_ERROR, "Failed to allocate job deque\n");
+            _jobs_release();
+            return false;
+        }
+        _jobs.deque_count++;
+    }
+
+    _jobs.wake = cff_platform_semaphore_create(0);
+    if (_jobs.wake == NULL)
+    {
+        caff_log(LOG_LEVEL_ERROR, "Failed to create job semaphore\n");
+        _jobs_release();
+        return false;
+    }
+    _jobs.worker_count = 0;
+    _jobs.sleeping = 0;
+    _jobs.running = 1;
+    _thread_index = 0;
+
+    // a worker reads deque_count, every deque must exist before it starts
+    for (uint32_t i = 0; i < worker_count; i++)
+    {
+        cff_thread worker = cff_platform_thread_create(_jobs_worker_main, (void *)(uintptr_t)(i + 1));
+        if (worker == NULL)
+            break;
+        _jobs.workers[_jobs.worker_count] = worker;
+        _jobs.worker_count++;
+    }
+
+    caff_log(LOG_LEVEL_TRACE, "Job system initialized with %u workers\n", _jobs.worker_count);
+    return true;
+}
+
+void caff_jobs_shutdown()
+{
+    caff_log(LOG_LEVEL_TRACE, "Shutdown job system\n");
+
+    if (_jobs.deques == NULL)
+        return;
+
+    cff_atomic_store_i32(&_jobs.running, 0);
+    cff_platform_semaphore_post(_jobs.wake, _jobs.worker_count);
+
+    for (uint32_t i = 0; i < _jobs.worker_count; i++)
+    {
+        cff_platform_thread_join(_jobs.workers[i]);
+    }
+
+    _jobs_release();
+}
+
+uint32_t caff_jobs_worker_count()
+{
+    return _jobs.worker_count;
+}
+
+uint32_t caff_jobs_thread_index()
+{
+    return _thread_index;
+}
+
+void caff_jobs_run(const caff_job *const jobs, uint32_t count, caff_job_counter *const counter)
+{
+    cff_atomic_add_i32(&counter->pending, (int32_t)count);
+
+    uint32_t pushed = 0;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        job_entry entry = {.function = jobs[i].function, .data = jobs[i].data, .counter = counter};
+
+        // without workers or with a full deque the caller runs the job itself
+        if (_jobs.worker_count > 0 && _deque_push(_jobs.deques + _thread_index, entry))
+        {
+            pushed++;
+        }
+        else
+        {
+            _jobs_execute(entry);
+        }
+    }
+
+    if (pushed == 0)
+        return;
+
+    // pairs with the fence a worker does before sleeping, either it sees the jobs or we see it sleeping
+    cff_atomic_fence();
+
+    int32_t sleeping = cff_atomic_load_i32(&_jobs.sleeping);
+    if (sleeping > 0)
+    {
+        cff_platform_semaphore_post(_jobs.wake, pushed < (uint32_t)sleeping ? pushed : (uint32_t)sleeping);
+    }
+}
+
+void caff_jobs_wait(caff_job_counter *const counter)
+{
+    // the waiting thread keeps running jobs instead of sleeping
+    while (!caff_jobs_is_done(counter))
+    {
+        job_entry entry;
+        if (_jobs_find(&entry))
+        {
+            _jobs_execute(entry);
+        }
+        else
+        {
+            cff_platform_thread_yield();
+        }
+    }
+}
+
+bool caff_jobs_is_done(const caff_job_counter *const counter)
+{
+    return cff_atomic_load_i32(&counter->pending) <= 0;
+}
+
+static void _jobs_release(void)
+{
+    // init may fail half way, only what was created is released
+    for (uint32_t i = 0; i < _jobs.deque_count; i++)
+    {
+        _deque_release(_jobs.deques + i);
+    }
+
+    if (_jobs.wake != NULL)
+        cff_platform_semaphore_release(_jobs.wake);
+    if (_jobs.workers != NULL)
+        CFF_RELEASE(_jobs.workers);
+    if (_jobs.deques != NULL)
+        CFF_RELEASE(_jobs.deques);
+
+    _jobs = (job_system){0};
+}
+
+static bool _jobs_find(job_entry *out)
+{
+    if (_jobs.deque_count == 0)
+        return false;
+
+    if (_deque_pop(_jobs.deques + _thread_index, out))
+        return true;
+
+    // xorshift, each thread starts stealing from a different victim
+    uint32_t seed = _thread_seed ? _thread_seed : _thread_index * 2654435761u + 1;
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    _thread_seed = seed;
+
+    uint32_t first = seed % _jobs.deque_count;
+    for (uint32_t i = 0; i < _jobs.deque_count; i++)
+    {
+        uint32_t victim = (first + i) % _jobs.deque_count;
+        if (victim == _thread_index)
+            continue;
+
+        if (_deque_steal(_jobs.deques + victim, out))
+            return true;
+    }
+
+    return false;
+}
+
+static void _jobs_execute(job_entry entry)
+{
+    entry.function(entry.data);
+    cff_atomic_add_i32(&entry.counter->pending, -1);
+}
+
+static uint32_t _jobs_worker_main(void *data)
+{
+    _thread_index = (uint32_t)(uintptr_t)data;
+
+    while (cff_atomic_load_i32(&_jobs.running))
+    {
+        job_entry entry;
+        bool found = false;
+
+        for (uint32_t attempt = 0; attempt < JOB_STEAL_ATTEMPTS && !found; attempt++)
+        {
+            found = _jobs_find(&entry);
+            if (!found)
+                CFF_CPU_RELAX();
+        }
+
+        if (!found)
+        {
+            cff_atomic_add_i32(&_jobs.sleeping, 1);
+            cff_atomic_fence();
+
+            found = _jobs_find(&entry);
+            if (!found)
+                cff_platform_semaphore_wait(_jobs.wake);
+
+            cff_atomic_add_i32(&_jobs.sleeping, -1);
+        }
+
+        if (found)
+            _jobs_execute(entry);
+    }
+
+    return 0;
+}
+
+#pragma region DEQUE
+
+static bool _deque_init(job_deque *deque)
+{
+    *deque = (job_deque){0};
+    deque->buffer = (job_entry *)CFF_ALLOC(sizeof(job_entry) * JOB_DEQUE_CAPACITY, "JOB DEQUE");
+    return deque->buffer != NULL;
+}
+
+static void _deque_release(job_deque *deque)
+{
+    CFF_RELEASE(deque->buffer);
+    deque->buffer = NULL;
+}
+
+static bool _deque_push(job_deque *deque, job_entry entry)
+{
+    int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED);
+    int64_t top = cff_atomic_load_i64(&deque->top);
+
+    if (bottom - top >= JOB_DEQUE_CAPACITY)
+        return false;
+
+    _slot_write(deque->buffer + (bottom & (JOB_DEQUE_CAPACITY - 1)), entry);
+    cff_atomic_store_i64(&deque->bottom, bottom + 1);
+
+    return true;
+}
+
+static bool _deque_pop(job_deque *deque, job_entry *out)
+{
+    int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&deque->bottom, bottom, __ATOMIC_RELAXED);
+    cff_atomic_fence();
+    int64_t top = __atomic_load_n(&deque->top, __ATOMIC_RELAXED);
+
+    if (top > bottom)
+    {
+        __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    *out = _slot_read(deque->buffer + (bottom & (JOB_DEQUE_CAPACITY - 1)));
+
+    if (top != bottom)
+        return true;
+
+    // last job, race the thieves for it
+    bool won = cff_atomic_cas_i64(&deque->top, top, top + 1);
+    __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+
+    return won;
+}
+
+static bool _deque_steal(job_deque *deque, job_entry *out)
+{
+    int64_t top = cff_atomic_load_i64(&deque->top);
+    cff_atomic_fence();
+    int64_t bottom = cff_atomic_load_i64(&deque->bottom);
+
+    if (top >= bottom)
+        return false;
+
+    job_entry entry = _slot_read(deque->buffer + (top & (JOB_DEQUE_CAPACITY - 1)));
+
+    if (!cff_atomic_cas_i64(&deque->top, top, top + 1))
+        return false;
+
+    *out = entry;
+    return true;
+}
+
+// slots are read by thieves while the owner may write them, each field is accessed atomically
+static void _slot_write(job_entry *slot, job_entry entry)
+{
+    __atomic_store_n(&slot->function, entry.function, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->data, entry.data, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->counter, entry.counter, __ATOMIC_RELAXED);
+}
+
+static job_entry _slot_read(const job_entry *slot)
+{
+    return (job_entry){
+        .function = __atomic_load_n(&slot->function, __ATOMIC_RELAXED),
+        .data = __atomic_load_n(&slot->data, __ATOMIC_RELAXED),
+        .counter = __atomic_load_n(&slot->counter, __ATOMIC_RELAXED),
+    };
+}
+
+#pragma endregion
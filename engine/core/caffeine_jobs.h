@@ -0,0 +1,30 @@
+#pragma once
+
+#include "../caffeine_types.h"
+
+typedef void (*caff_job_fn)(void *data);
+
+typedef struct
+{
+    caff_job_fn function;
+    void *data;
+} caff_job;
+
+typedef struct
+{
+    volatile int32_t pending;
+} caff_job_counter;
+
+// worker_count for caff_jobs_init where the calling thread runs every job itself, 0 starts one worker per extra processor
+#define CAFF_JOBS_NO_WORKERS UINT32_MAX
+
+CAFF_API bool caff_jobs_init(uint32_t worker_count);
+CAFF_API void caff_jobs_shutdown();
+
+CAFF_API uint32_t caff_jobs_worker_count();
+CAFF_API uint32_t caff_jobs_thread_index();
+
+// only the thread that called caff_jobs_init and the jobs themselves may submit and wait
+CAFF_API void caff_jobs_run(const caff_job *const jobs, uint32_t count, caff_job_counter *const counter);
+CAFF_API void caff_jobs_wait(caff_job_counter *const counter);
+CAFF_API bool caff_jobs_is_done(const caff_job_counter *const counter);
@@ -1,11 +1,13 @@
 #include "caffeine_memory.h"
 #include "../platform/caffeine_platform.h"
 #include "caffeine_logging.h"
+#include "caffeine_atomic.h"
 
 #ifdef CFF_DEBUG
 #include <stdio.h>
-static uint64_t _mem_allocked = 0;
-static uint64_t _count = 0;
+// job threads allocate too, the counters are only touched atomically
+static volatile int64_t _mem_allocked = 0;
+static volatile int64_t _count = 0;
 
 typedef struct
 {
@@ -21,8 +23,7 @@ typedef struct
 
 static int _get_id()
 {
-  _count++;
-  return _count;
+  return (int)cff_atomic_add_i64(&_count, 1);
 }
 
 static mem_header *_get_header(const void *ptr)
@@ -37,10 +38,26 @@ static void *_get_block(mem_header *header)
   return result;
 }
 
+// aligned blocks keep the pointer returned by the allocator right before the aligned address
+static void *_align_block(void *raw, uint64_t align)
+{
+  if (raw == NULL)
+    return NULL;
+
+  uintptr_t aligned = ((uintptr_t)raw + sizeof(void *) + (uintptr_t)align - 1) & ~((uintptr_t)align - 1);
+  ((void **)aligned)[-1] = raw;
+  return (void *)aligned;
+}
+
+static void *_get_aligned_raw(const void *ptr)
+{
+  return ((void *const *)ptr)[-1];
+}
+
 void cff_memory_init()
 {
 #ifdef CFF_DEBUG
-  _mem_allocked = 0;
+  cff_atomic_store_i64(&_mem_allocked, 0);
 #endif
 }
 
@@ -48,7 +65,7 @@ void cff_memory_end()
 {
 #ifdef CFF_DEBUG
   char msg[64];
-  sprintf_s(msg, 64, "Bytes not freed: %llu\n", _mem_allocked);
+  sprintf_s(msg, 64, "Bytes not freed: %llu\n", (unsigned long long)cff_atomic_load_i64(&_mem_allocked));
   cff_print_console(LOG_LEVEL_INFO, msg);
 #endif
 }
@@ -72,6 +89,18 @@ void cff_mem_release(const void *const ptr_owning)
     cff_free(ptr_owning);
 }
 
+void *cff_mem_alloc_aligned(uint64_t size, uint64_t align)
+{
+  void *raw = cff_mem_alloc(size + align + sizeof(void *));
+  return _align_block(raw, align);
+}
+
+void cff_mem_release_aligned(const void *const ptr_owning)
+{
+  if (ptr_owning != NULL)
+    cff_mem_release(_get_aligned_raw(ptr_owning));
+}
+
 #ifdef CFF_DEBUG
 
 void *cff_mem_alloc_dbg(uint64_t size, const char *const block_name, const char *const file, uint64_t line)
@@ -87,7 +116,7 @@ void *cff_mem_alloc_dbg(uint64_t size, const char *const block_name, const char
   debug_result->size = size;
   debug_result->freed = 0;
 
-  _mem_allocked += size;
+  cff_atomic_add_i64(&_mem_allocked, (int64_t)size);
 
   void *result = _get_block(debug_result);
 
@@ -101,11 +130,11 @@ void *cff_mem_realloc_dbg(const void *ptr_owning, uint64_t size, const char *con
   (void)file;
   (void)line;
   mem_header *old_header = _get_header(ptr_owning);
-  _mem_allocked -= old_header->size;
+  cff_atomic_add_i64(&_mem_allocked, -(int64_t)old_header->size);
 
   mem_header *new_header = (mem_header *)cff_mem_realloc(old_header, size + sizeof(mem_header));
   new_header->size = size;
-  _mem_allocked -= size;
+  cff_atomic_add_i64(&_mem_allocked, (int64_t)size);
 
   void *result = _get_block(new_header);
   return result;
@@ -122,13 +151,25 @@ void cff_mem_release_dbg(const void *const ptr_owning, const char *const file, u
   }
 
   header->freed = 1;
-  _mem_allocked -= header->size;
+  cff_atomic_add_i64(&_mem_allocked, -(int64_t)header->size);
 
   // caff_log_trace("[%s:%llu] Free %d.%s - %u bytes\n", file, line, (int)header->id, header->block_name, header->size);
 
   cff_mem_release(header);
 }
 
+void *cff_mem_alloc_aligned_dbg(uint64_t size, uint64_t align, const char *const block_name, const char *const file, uint64_t line)
+{
+  void *raw = cff_mem_alloc_dbg(size + align + sizeof(void *), block_name, file, line);
+  return _align_block(raw, align);
+}
+
+void cff_mem_release_aligned_dbg(const void *const ptr_owning, const char *const file, uint64_t line)
+{
+  if (ptr_owning != NULL)
+    cff_mem_release_dbg(_get_aligned_raw(ptr_owning), file, line);
+}
+
 void cff_mem_copy_dbg(const void *const from_ref, void *const dest_mut_ref, uint64_t size, const char *const file, uint64_t line)
 {
   (void)file;
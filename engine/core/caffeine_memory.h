@@ -10,6 +10,10 @@ void *cff_mem_realloc(const void *ptr_owning, uint64_t size);
 
 void cff_mem_release(const void *const ptr_owning);
 
+void *cff_mem_alloc_aligned(uint64_t size, uint64_t align);
+
+void cff_mem_release_aligned(const void *const ptr_owning);
+
 void cff_mem_copy(const void *const from_ref, void *const dest_mut_ref, uint64_t size);
 
 void cff_mem_move(const void *const from_ref, void *const dest_mut_ref, uint64_t size);
@@ -28,6 +32,10 @@ void *cff_mem_realloc_dbg(const void *ptr_owning, uint64_t size, const char *con
 
 void cff_mem_release_dbg(const void *const ptr_owning, const char *const file, uint64_t line);
 
+void *cff_mem_alloc_aligned_dbg(uint64_t size, uint64_t align, const char *const block_name, const char *const file, uint64_t line);
+
+void cff_mem_release_aligned_dbg(const void *const ptr_owning, const char *const file, uint64_t line);
+
 void cff_mem_copy_dbg(const void *const from_ref, void *const dest_mut_ref, uint64_t size, const char *const file, uint64_t line);
 
 void cff_mem_move_dbg(const void *const from_ref, void *const dest_mut_ref, uint64_t size, const char *const file, uint64_t line);
@@ -48,6 +56,10 @@ void cff_mem_zero_dbg(void *const dest_mut_ref, uint64_t buffer_lenght, const ch
 
 #define CFF_RELEASE(PTR_OWNING) cff_mem_release_dbg(PTR_OWNING, __CFF_FILE_NAME__, __LINE__)
 
+#define CFF_ALIGNED_ALLOC(SIZE, ALIGN, NAME) cff_mem_alloc_aligned_dbg(SIZE, ALIGN, NAME, __CFF_FILE_NAME__, __LINE__)
+
+#define CFF_ALIGNED_RELEASE(PTR_OWNING) cff_mem_release_aligned_dbg(PTR_OWNING, __CFF_FILE_NAME__, __LINE__)
+
 #define CFF_COPY(FROM_REF, DEST_MUT_REF, SIZE) cff_mem_copy_dbg(FROM_REF, DEST_MUT_REF, SIZE, __CFF_FILE_NAME__, __LINE__)
 
 #define CFF_MOVE(FROM_REF, DEST_MUT_REF, SIZE) cff_mem_move_dbg(FROM_REF, DEST_MUT_REF, SIZE, __CFF_FILE_NAME__, __LINE__)
@@ -66,6 +78,10 @@ void cff_mem_zero_dbg(void *const dest_mut_ref, uint64_t buffer_lenght, const ch
 
 #define CFF_RELEASE(PTR_OWNING) cff_mem_release(PTR_OWNING)
 
+#define CFF_ALIGNED_ALLOC(SIZE, ALIGN, NAME) cff_mem_alloc_aligned(SIZE, ALIGN)
+
+#define CFF_ALIGNED_RELEASE(PTR_OWNING) cff_mem_release_aligned(PTR_OWNING)
+
 #define CFF_COPY(FROM_REF, DEST_MUT_REF, SIZE) cff_mem_copy(FROM_REF, DEST_MUT_REF, SIZE)
 
 #define CFF_MOVE(FROM_REF, DEST_MUT_REF, SIZE) cff_mem_move(FROM_REF, DEST_MUT_REF, SIZE)
@@ -23,6 +23,13 @@ double caff_time_delta(void)
     return delta_time;
 }
 
+double caff_time_precise(void)
+{
+    struct timespec now;
+    timespec_get(&now, TIME_UTC);
+    return (double)now.tv_sec + now.tv_nsec / 1e9;
+}
+
 void caff_time_sleep(uint64_t ms)
 {
     cff_platform_sleep(ms);
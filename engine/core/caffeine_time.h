@@ -2,7 +2,11 @@
 
 #include <stdint.h>
 
+#include "../caffeine_defs.h"
+
 void caff_time_tick(void);
 double caff_time_current(void);
 double caff_time_delta(void);
+// wall clock in seconds read on every call, unlike caff_time_current it is not tied to the frame
+CAFF_API double caff_time_precise(void);
 void caff_time_sleep(uint64_t ms);
\ No newline at end of file
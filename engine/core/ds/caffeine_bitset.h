@@ -0,0 +1,95 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "../caffeine_memory.h"
+
+// growable bitset, bits past word_count read as zero
+typedef struct cff_bitset
+{
+    uint64_t *words;
+    uint32_t word_count;
+} cff_bitset;
+
+static inline void cff_bitset_init(cff_bitset *set)
+{
+    set->words = NULL;
+    set->word_count = 0;
+}
+
+static inline void cff_bitset_release(cff_bitset *set)
+{
+    if (set->words != NULL)
+        CFF_RELEASE(set->words);
+    set->words = NULL;
+    set->word_count = 0;
+}
+
+static inline bool cff_bitset_reserve(cff_bitset *set, uint32_t bit_count)
+{
+    uint32_t word_count = (bit_count + 63) / 64;
+    if (word_count <= set->word_count)
+        return true;
+
+    uint64_t *words = (uint64_t *)CFF_ALLOC(sizeof(uint64_t) * word_count, "BITSET");
+    if (words == NULL)
+        return false;
+
+    memset(words, 0, sizeof(uint64_t) * word_count);
+    if (set->words != NULL)
+    {
+        memcpy(words, set->words, sizeof(uint64_t) * set->word_count);
+        CFF_RELEASE(set->words);
+    }
+
+    set->words = words;
+    set->word_count = word_count;
+    return true;
+}
+
+static inline void cff_bitset_set(cff_bitset *set, uint32_t bit)
+{
+    if (cff_bitset_reserve(set, bit + 1))
+        set->words[bit / 64] |= (uint64_t)1 << (bit % 64);
+}
+
+static inline void cff_bitset_clear(cff_bitset *set, uint32_t bit)
+{
+    if (bit / 64 < set->word_count)
+        set->words[bit / 64] &= ~((uint64_t)1 << (bit % 64));
+}
+
+static inline bool cff_bitset_test(const cff_bitset *set, uint32_t bit)
+{
+    if (bit / 64 >= set->word_count)
+        return false;
+    return (set->words[bit / 64] >> (bit % 64)) & 1;
+}
+
+// true when every bit of subset is also set in set
+static inline bool cff_bitset_contains(const cff_bitset *set, const cff_bitset *subset)
+{
+    uint32_t shared = set->word_count < subset->word_count ? set->word_count : subset->word_count;
+
+    // branch free over the shared words so the compiler can vectorize it
+    uint64_t missing = 0;
+    for (uint32_t i = 0; i < shared; i++)
+        missing |= subset->words[i] & ~set->words[i];
+
+    for (uint32_t i = shared; i < subset->word_count; i++)
+        missing |= subset->words[i];
+
+    return missing == 0;
+}
+
+static inline bool cff_bitset_intersects(const cff_bitset *set, const cff_bitset *other)
+{
+    uint32_t shared = set->word_count < other->word_count ? set->word_count : other->word_count;
+
+    uint64_t common = 0;
+    for (uint32_t i = 0; i < shared; i++)
+        common |= set->words[i] & other->words[i];
+
+    return common != 0;
+}
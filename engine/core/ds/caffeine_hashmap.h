@@ -240,17 +240,29 @@
         alloc_gen_array(m_ptr->used_slot, capacity);                                                  \
         CFF_ZERO(m_ptr->used_slot, capacity * sizeof(uint8_t));                                       \
     }                                                                                                 \
+    uint32_t NAME##_find(const NAME *m_ptr, KEY_TYPE key)                                             \
+    {                                                                                                 \
+        /* removed slots leave holes, every probe up to the longest chain is visited */               \
+        for (uint32_t hash_collision = 0; hash_collision <= m_ptr->colision_count; hash_collision++)  \
+        {                                                                                             \
+            uint32_t hash_index = (m_ptr->hash_key_fn(&key, hash_collision) % m_ptr->capacity);       \
+            KEY_TYPE *tmp_key = &m_ptr->key_buffer[hash_index];                                       \
+            if (m_ptr->used_slot[hash_index] && m_ptr->cmp_key_fn(&key, tmp_key))                     \
+                return hash_index;                                                                    \
+        }                                                                                             \
+        return UINT32_MAX;                                                                            \
+    }                                                                                                 \
     uint32_t NAME##_resolve_collision(NAME *m_ptr, KEY_TYPE key, uint32_t hash_index, DATA_TYPE data) \
     {                                                                                                 \
-        uint32_t hash_collision = 1;                                                                  \
+        uint32_t existing = NAME##_find(m_ptr, key);                                                  \
+        if (existing != UINT32_MAX)                                                                   \
+        {                                                                                             \
+            m_ptr->data_buffer[existing] = data;                                                      \
+            return existing;                                                                          \
+        }                                                                                             \
+        uint32_t hash_collision = 0;                                                                  \
         while (m_ptr->used_slot[hash_index])                                                          \
         {                                                                                             \
-            KEY_TYPE tmp_key = m_ptr->key_buffer[hash_index];                                         \
-            if (m_ptr->cmp_key_fn(&key, &tmp_key))                                                    \
-            {                                                                                         \
-                m_ptr->data_buffer[hash_index] = data;                                                \
-                return hash_collision;                                                                \
-            }                                                                                         \
             hash_collision++;                                                                         \
             hash_index = (m_ptr->hash_key_fn(&key, hash_collision) % m_ptr->capacity);                \
         }                                                                                             \
@@ -267,24 +279,27 @@
                                                                                                       \
     void NAME##_resize(NAME *m_ptr, uint32_t new_capacity)                                            \
     {                                                                                                 \
-        DATA_TYPE *n_data_buffer = (DATA_TYPE *)CFF_ARR_NEW(DATA_TYPE, new_capacity, "ARRAY BLOCK");  \
-        KEY_TYPE *n_key_buffer = (KEY_TYPE *)CFF_ARR_NEW(KEY_TYPE, new_capacity, "ARRAY BLOCK");      \
-        uint8_t *n_used_buffer = (uint8_t *)CFF_ARR_NEW(uint8_t, new_capacity, "ARRAY BLOCK");        \
-        CFF_ZERO(n_used_buffer, new_capacity * sizeof(uint8_t));                                      \
-        for (uint32_t m_i = 0; m_i < m_ptr->count; m_i++)                                             \
+        DATA_TYPE *o_data_buffer = m_ptr->data_buffer;                                                \
+        KEY_TYPE *o_key_buffer = m_ptr->key_buffer;                                                   \
+        uint8_t *o_used_buffer = m_ptr->used_slot;                                                    \
+        uint32_t o_capacity = m_ptr->capacity;                                                        \
+        m_ptr->data_buffer = (DATA_TYPE *)CFF_ARR_NEW(DATA_TYPE, new_capacity, "ARRAY BLOCK");        \
+        m_ptr->key_buffer = (KEY_TYPE *)CFF_ARR_NEW(KEY_TYPE, new_capacity, "ARRAY BLOCK");           \
+        m_ptr->used_slot = (uint8_t *)CFF_ARR_NEW(uint8_t, new_capacity, "ARRAY BLOCK");              \
+        CFF_ZERO(m_ptr->used_slot, new_capacity * sizeof(uint8_t));                                   \
+        m_ptr->capacity = new_capacity;                                                               \
+        m_ptr->count = 0;                                                                             \
+        m_ptr->colision_count = 0;                                                                    \
+        for (uint32_t m_i = 0; m_i < o_capacity; m_i++)                                               \
         {                                                                                             \
-            KEY_TYPE curr_key = m_ptr->key_buffer[m_i];                                               \
-            DATA_TYPE curr_data = m_ptr->data_buffer[m_i];                                            \
-            uint32_t hash_index = m_ptr->hash_key_fn(&curr_key, 0) % new_capacity;                    \
-            NAME##_resolve_collision(m_ptr, curr_key, hash_index, curr_data);                         \
+            if (!o_used_buffer[m_i])                                                                  \
+                continue;                                                                             \
+            uint32_t hash_index = m_ptr->hash_key_fn(&o_key_buffer[m_i], 0) % new_capacity;           \
+            NAME##_resolve_collision(m_ptr, o_key_buffer[m_i], hash_index, o_data_buffer[m_i]);       \
         }                                                                                             \
-        cff_release(m_ptr->data_buffer);                                                              \
-        cff_release(m_ptr->key_buffer);                                                               \
-        cff_release(m_ptr->used_slot);                                                                \
-        m_ptr->data_buffer = n_data_buffer;                                                           \
-        m_ptr->key_buffer = n_key_buffer;                                                             \
-        m_ptr->used_slot = n_used_buffer;                                                             \
-        m_ptr->capacity = new_capacity;                                                               \
+        cff_release(o_data_buffer);                                                                   \
+        cff_release(o_key_buffer);                                                                    \
+        cff_release(o_used_buffer);                                                                   \
     }                                                                                                 \
                                                                                                       \
     uint32_t NAME##_add(NAME *hash_ptr, KEY_TYPE key, DATA_TYPE data)                                 \
@@ -299,87 +314,32 @@
     }                                                                                                 \
     int8_t NAME##_get(const NAME *m_ptr, KEY_TYPE key, DATA_TYPE *result)                             \
     {                                                                                                 \
-        uint32_t hash_collision = 0;                                                                  \
-        uint32_t hash_index = (m_ptr->hash_key_fn(&key, hash_collision) % m_ptr->capacity);           \
-        int8_t found = 0;                                                                             \
-        while (m_ptr->used_slot[hash_index])                                                          \
-        {                                                                                             \
-            KEY_TYPE tmp_key = m_ptr->key_buffer[hash_index];                                         \
-            if (m_ptr->cmp_key_fn(&key, &tmp_key))                                                    \
-            {                                                                                         \
-                *result = m_ptr->data_buffer[hash_index];                                             \
-                found = 1;                                                                            \
-                break;                                                                                \
-            }                                                                                         \
-            hash_collision++;                                                                         \
-            if (hash_collision > m_ptr->colision_count)                                               \
-                break;                                                                                \
-            hash_index = (m_ptr->hash_key_fn(&key, hash_collision) % m_ptr->capacity);                \
-        }                                                                                             \
-        return found;                                                                                 \
+        uint32_t hash_index = NAME##_find(m_ptr, key);                                                \
+        if (hash_index == UINT32_MAX)                                                                 \
+            return 0;                                                                                 \
+        *result = m_ptr->data_buffer[hash_index];                                                     \
+        return 1;                                                                                     \
     }                                                                                                 \
     int8_t NAME##_get_ref(NAME *m_ptr, KEY_TYPE key, DATA_TYPE **result)                              \
     {                                                                                                 \
-        uint32_t hash_collision = 0;                                                                  \
-        uint32_t hash_index = (m_ptr->hash_key_fn(&key, hash_collision) % m_ptr->capacity);           \
-        int8_t found = 0;                                                                             \
-        while (m_ptr->used_slot[hash_index])                                                          \
-        {                                                                                             \
-            KEY_TYPE tmp_key = m_ptr->key_buffer[hash_index];                                         \
-            if (m_ptr->cmp_key_fn(&key, &tmp_key))                                                    \
-            {                                                                                         \
-                *result = &(m_ptr->data_buffer[hash_index]);                                          \
-                found = 1;                                                                            \
-                break;                                                                                \
-            }                                                                                         \
-            hash_collision++;                                                                         \
-            if (hash_collision > m_ptr->colision_count)                                               \
-                break;                                                                                \
-            hash_index = (m_ptr->hash_key_fn(&key, hash_collision) % m_ptr->capacity);                \
-        }                                                                                             \
-        return found;                                                                                 \
+        uint32_t hash_index = NAME##_find(m_ptr, key);                                                \
+        if (hash_index == UINT32_MAX)                                                                 \
+            return 0;                                                                                 \
+        *result = &(m_ptr->data_buffer[hash_index]);                                                  \
+        return 1;                                                                                     \
     }                                                                                                 \
     int8_t NAME##_exist(NAME *m_ptr, KEY_TYPE key)                                                    \
     {                                                                                                 \
-        uint32_t hash_collision = 0;                                                                  \
-        uint32_t hash_index = (m_ptr->hash_key_fn(&key, hash_collision) % m_ptr->capacity);           \
-        int8_t found = 0;                                                                             \
-        while (m_ptr->used_slot[hash_index])                                                          \
-        {                                                                                             \
-            KEY_TYPE tmp_key = m_ptr->key_buffer[hash_index];                                         \
-            if (m_ptr->cmp_key_fn(&key, &tmp_key))                                                    \
-            {                                                                                         \
-                found = 1;                                                                            \
-                break;                                                                                \
-            }                                                                                         \
-            hash_collision++;                                                                         \
-            if (hash_collision > m_ptr->colision_count)                                               \
-                break;                                                                                \
-            hash_index = (m_ptr->hash_key_fn(&key, hash_collision) % m_ptr->capacity);                \
-        }                                                                                             \
-        return found;                                                                                 \
+        return NAME##_find(m_ptr, key) != UINT32_MAX;                                                 \
     }                                                                                                 \
     int8_t NAME##_remove(NAME *m_ptr, KEY_TYPE key)                                                   \
     {                                                                                                 \
-        uint32_t hash_collision = 0;                                                                  \
-        uint32_t hash_index = (m_ptr->hash_key_fn(&key, hash_collision) % m_ptr->capacity);           \
-        int8_t found = 0;                                                                             \
-        while (m_ptr->used_slot[hash_index])                                                          \
-        {                                                                                             \
-            KEY_TYPE tmp_key = m_ptr->key_buffer[hash_index];                                         \
-            if (m_ptr->cmp_key_fn(&key, &tmp_key))                                                    \
-            {                                                                                         \
-                m_ptr->used_slot[hash_index] = 0;                                                     \
-                m_ptr->count--;                                                                       \
-                found = 1;                                                                            \
-                break;                                                                                \
-            }                                                                                         \
-            hash_collision++;                                                                         \
-            if (hash_collision > m_ptr->colision_count)                                               \
-                break;                                                                                \
-            hash_index = (m_ptr->hash_key_fn(&key, hash_collision) % m_ptr->capacity);                \
-        }                                                                                             \
-        return found;                                                                                 \
+        uint32_t hash_index = NAME##_find(m_ptr, key);                                                \
+        if (hash_index == UINT32_MAX)                                                                 \
+            return 0;                                                                                 \
+        m_ptr->used_slot[hash_index] = 0;                                                             \
+        m_ptr->count--;                                                                               \
+        return 1;                                                                                     \
     }                                                                                                 \
     void NAME##_release(const NAME *m_ptr)                                                            \
     {                                                                                                 \
@@ -11,6 +11,10 @@
 #define alloc_gen_array(PTR, CAPACITY) PTR = CFF_ARR_NEW(__typeof__(PTR[0]), CAPACITY, "ARRAY BLOCK")
 #endif
 
+// keys without a dense entry
+#define CFF_SPARSE_EMPTY 0xffffffffu
+
+// dense holds the values packed, sparse maps each key to its dense position
 #define cff_sparse_dcltype(NAME, TYPE) \
     typedef struct                     \
     {                                  \
@@ -18,6 +22,7 @@
         uint32_t *sparse;              \
         uint32_t count;                \
         uint32_t capacity;             \
+        uint32_t sparse_capacity;      \
     } NAME
 
 #define cff_sparse_init(PTR, CAPACITY)                    \
@@ -27,26 +32,95 @@
         uint32_t c = (uint32_t)(CAPACITY ? CAPACITY : 4); \
         __m_ptr->count = 0;                               \
         __m_ptr->capacity = c;                            \
+        __m_ptr->sparse_capacity = c;                     \
         alloc_gen_array(__m_ptr->dense, c);               \
         alloc_gen_array(__m_ptr->sparse, c);              \
-    } while (0);
-
-#define cff_sparse_resize(PTR, CAPACITY)                                                           \
-    do                                                                                             \
-    {                                                                                              \
-        __typeof__(PTR) __m_ptr = (PTR);                                                           \
-        uint32_t __m_cap = (uint32_t)CAPACITY;                                                     \
-        __typeof__(__m_ptr->dense) __m_tmp_dense = CFF_ARR_RESIZE(__m_ptr->dense, __m_cap);        \
-        if (__m_tmp_dense != NULL)                                                                 \
-        {                                                                                          \
-            __typeof__(__m_ptr->sparse) __m_tmp_sparse = CFF_ARR_RESIZE(__m_ptr->sparse, __m_cap); \
-            if (__m_tmp_sparse != NULL)                                                            \
-            {                                                                                      \
-                __m_ptr->dense = __m_tmp_dense;                                                    \
-                __m_ptr->sparse = __m_tmp_sparse;                                                  \
-                __m_ptr->capacity = __m_cap;                                                       \
-            }                                                                                      \
-        }                                                                                          \
-    } while (0);
-
-#define cff_sparse_add(PTR, DATA, OUT_INDEX)
+        for (uint32_t __m_i = 0; __m_i < c; __m_i++)      \
+            __m_ptr->sparse[__m_i] = CFF_SPARSE_EMPTY;    \
+    } while (0)
+
+// only the dense side, the sparse side grows with the keys
+#define cff_sparse_resize(PTR, CAPACITY)                                                    \
+    do                                                                                      \
+    {                                                                                       \
+        __typeof__(PTR) __m_ptr = (PTR);                                                    \
+        uint32_t __m_cap = (uint32_t)CAPACITY;                                              \
+        __typeof__(__m_ptr->dense) __m_tmp_dense = CFF_ARR_RESIZE(__m_ptr->dense, __m_cap); \
+        if (__m_tmp_dense != NULL)                                                          \
+        {                                                                                   \
+            __m_ptr->dense = __m_tmp_dense;                                                 \
+            __m_ptr->capacity = __m_cap;                                                    \
+        }                                                                                   \
+    } while (0)
+
+#define cff_sparse_reserve_key(PTR, KEY)                                                    \
+    do                                                                                      \
+    {                                                                                       \
+        __typeof__(PTR) __m_ptr_1 = (PTR);                                                  \
+        uint32_t __m_key = (uint32_t)(KEY);                                                 \
+        if (__m_key >= __m_ptr_1->sparse_capacity)                                          \
+        {                                                                                   \
+            uint32_t __m_cap = __m_ptr_1->sparse_capacity * 2;                              \
+            __m_cap = __m_cap > __m_key ? __m_cap : __m_key + 1;                            \
+            uint32_t *__m_tmp_sparse = CFF_ARR_RESIZE(__m_ptr_1->sparse, __m_cap);          \
+            if (__m_tmp_sparse != NULL)                                                     \
+            {                                                                               \
+                for (uint32_t __m_i = __m_ptr_1->sparse_capacity; __m_i < __m_cap; __m_i++) \
+                    __m_tmp_sparse[__m_i] = CFF_SPARSE_EMPTY;                               \
+                __m_ptr_1->sparse = __m_tmp_sparse;                                         \
+                __m_ptr_1->sparse_capacity = __m_cap;                                       \
+            }                                                                               \
+        }                                                                                   \
+    } while (0)
+
+// the key must not be in the set, OUT_INDEX gets the dense position of the value
+#define cff_sparse_add(PTR, KEY, DATA, OUT_INDEX)                  \
+    do                                                             \
+    {                                                              \
+        __typeof__(PTR) __m_ptr_2 = (PTR);                         \
+        uint32_t __m_add_key = (uint32_t)(KEY);                    \
+        cff_sparse_reserve_key(__m_ptr_2, __m_add_key);            \
+        if (__m_ptr_2->count == __m_ptr_2->capacity)               \
+        {                                                          \
+            cff_sparse_resize(__m_ptr_2, __m_ptr_2->capacity * 2); \
+        }                                                          \
+        __m_ptr_2->dense[__m_ptr_2->count] = (DATA);               \
+        __m_ptr_2->sparse[__m_add_key] = __m_ptr_2->count;         \
+        (OUT_INDEX) = __m_ptr_2->count;                            \
+        __m_ptr_2->count++;                                        \
+    } while (0)
+
+// swaps the last value into the removed position, KEY_OF gives the key of a dense value
+#define cff_sparse_remove(PTR, KEY, KEY_OF)                                               \
+    do                                                                                    \
+    {                                                                                     \
+        __typeof__(PTR) __m_ptr_3 = (PTR);                                                \
+        uint32_t __m_rem_key = (uint32_t)(KEY);                                           \
+        uint32_t __m_pos = cff_sparse_index_of(__m_ptr_3, __m_rem_key);                   \
+        if (__m_pos != CFF_SPARSE_EMPTY)                                                  \
+        {                                                                                 \
+            uint32_t __m_last = __m_ptr_3->count - 1;                                     \
+            if (__m_pos != __m_last)                                                      \
+            {                                                                             \
+                __m_ptr_3->dense[__m_pos] = __m_ptr_3->dense[__m_last];                   \
+                __m_ptr_3->sparse[(uint32_t)KEY_OF(__m_ptr_3->dense[__m_pos])] = __m_pos; \
+            }                                                                             \
+            __m_ptr_3->sparse[__m_rem_key] = CFF_SPARSE_EMPTY;                            \
+            __m_ptr_3->count--;                                                           \
+        }                                                                                 \
+    } while (0)
+
+#define cff_sparse_index_of(PTR, KEY) ((uint32_t)(KEY) < (PTR)->sparse_capacity ? (PTR)->sparse[(uint32_t)(KEY)] : CFF_SPARSE_EMPTY)
+
+#define cff_sparse_contains(PTR, KEY) (cff_sparse_index_of(PTR, KEY) != CFF_SPARSE_EMPTY)
+
+#define cff_sparse_get(PTR, INDEX) (PTR)->dense[(uint32_t)(INDEX)]
+
+#define cff_sparse_get_ref(PTR, INDEX) ((PTR)->dense + (uint32_t)(INDEX))
+
+#define cff_sparse_release(PTR)     \
+    do                              \
+    {                               \
+        cff_release((PTR)->dense);  \
+        cff_release((PTR)->sparse); \
+    } while (0)
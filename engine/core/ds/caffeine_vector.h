@@ -118,7 +118,7 @@
     {                                                                                                      \
         arr->count = 0;                                                                                    \
         arr->capacity = capacity ? capacity : 4;                                                           \
-        alloc_gen_array(arr->buffer, capacity);                                                            \
+        alloc_gen_array(arr->buffer, arr->capacity);                                                       \
     }                                                                                                      \
                                                                                                            \
     void ARRAY_NAME##_resize(ARRAY_NAME *arr, uint32_t capacity)                                           \
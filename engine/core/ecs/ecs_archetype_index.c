@@ -4,6 +4,7 @@
 #include "../caffeine_logging.h"
 #include "../ds/caffeine_vector.h"
 #include "../ds/caffeine_hashmap.h"
+#include "../ds/caffeine_bitset.h"
 
 #define INVALID_INDEX (uint32_t)(0xffffffff)
 
@@ -13,6 +14,8 @@ cff_hash_impl(archetype_navigation, component_id, archetype_id);
 struct archetype_info
 {
     ecs_archetype archetype;
+    // bit component_id_index(c) is set for every component c of the archetype
+    cff_bitset mask;
     archetype_navigation on_add;
     archetype_navigation on_remove;
 };
@@ -82,6 +85,7 @@ archetype_id ecs_register_archetype(archetype_index *const index_mut_ref, ecs_ar
         archetype_id existent = INVALID_ID;
         if (archetype_reversed_map_get(map_archetype_to_id, archetype_owning, &existent))
         {
+            CFF_RELEASE(archetype_owning.components);
             return existent;
         }
     }
@@ -119,6 +123,21 @@ archetype_id ecs_get_archetype_id(const archetype_index *const index_ref, uint32
     return INVALID_ID;
 }
 
+uint32_t ecs_archetype_get_generated_count(const archetype_index *const index_ref)
+{
+    return index_ref->archetypes_generated;
+}
+
+const cff_bitset *ecs_archetype_get_mask(const archetype_index *const index_ref, archetype_id archetype)
+{
+    archetype_info *info = NULL;
+
+    if (!archetype_map_get_ref((archetype_map *)&index_ref->map_components_to_id, archetype, &info))
+        return NULL;
+
+    return &info->mask;
+}
+
 bool ecs_archetype_has_component(const archetype_index *const index_ref, archetype_id archetype, component_id component)
 {
     const archetype_map *const map_id_to_archetype = &index_ref->map_components_to_id;
@@ -132,7 +151,7 @@ bool ecs_archetype_has_component(const archetype_index *const index_ref, archety
         return false;
     }
 
-    return ecs_archetype_contains(&info->archetype, component);
+    return cff_bitset_test(&info->mask, component_id_index(component));
 }
 
 void ecs_remove_archetype(archetype_index *const index_mut_ref, archetype_id id)
@@ -147,6 +166,7 @@ void ecs_remove_archetype(archetype_index *const index_mut_ref, archetype_id id)
         return;
     }
 
+    cff_bitset_release(&info->mask);
     archetype_reversed_map_remove(map_archetype_to_id, info->archetype);
     archetype_map_remove(map_id_to_archetype, id);
 }
@@ -208,12 +228,23 @@ archetype_id ecs_archetype_add_component(archetype_index *const index_mut_ref, a
     if (!found || from_arch_info == NULL)
         return INVALID_ID;
 
+    // transitions already taken resolve without building and hashing the target component list
+    archetype_id cached_archetype_id = INVALID_ID;
+    if (archetype_navigation_get(&from_arch_info->on_add, component, &cached_archetype_id))
+        return cached_archetype_id;
+
     ecs_archetype new_archetype = ecs_archetype_copy(&from_arch_info->archetype);
     ecs_archetype_add(&new_archetype, component);
     archetype_id new_archetype_id = ecs_register_archetype(index_mut_ref, new_archetype);
 
+    // the component was already there, caching the edge would override the way back of the archetype
+    if (new_archetype_id == origin_arch_id)
+        return new_archetype_id;
+
+    // registering may grow the map, the origin info is fetched again
     archetype_info *new_arch_info = NULL;
     archetype_map_get_ref((archetype_map *)map_id_to_archetype, new_archetype_id, &new_arch_info);
+    archetype_map_get_ref((archetype_map *)map_id_to_archetype, origin_arch_id, &from_arch_info);
 
     // make navigation
     archetype_navigation_add(&new_arch_info->on_remove, component, origin_arch_id);
@@ -243,18 +274,28 @@ archetype_id ecs_archetype_remove_component(archetype_index *const index_mut_ref
     if (!found || from_arch_info == NULL)
         return INVALID_ID;
 
+    // transitions already taken resolve without building and hashing the target component list
+    archetype_id cached_archetype_id = INVALID_ID;
+    if (archetype_navigation_get(&from_arch_info->on_remove, component, &cached_archetype_id))
+        return cached_archetype_id;
+
     ecs_archetype new_archetype = ecs_archetype_copy(&from_arch_info->archetype);
     ecs_archetype_remove(&new_archetype, component);
     archetype_id new_archetype_id = ecs_register_archetype(index_mut_ref, new_archetype);
 
+    if (new_archetype_id == origin_arch_id)
+        return new_archetype_id;
+
+    // registering may grow the map, the origin info is fetched again
     archetype_info *new_arch_info = NULL;
     archetype_map_get_ref((archetype_map *)map_id_to_archetype, new_archetype_id, &new_arch_info);
+    archetype_map_get_ref((archetype_map *)map_id_to_archetype, origin_arch_id, &from_arch_info);
 
     // make navigation
     archetype_navigation_add(&new_arch_info->on_add, component, origin_arch_id);
     archetype_navigation_add(&from_arch_info->on_remove, component, new_archetype_id);
 
-    caff_log_trace("[ARCHETYPE INDEX] Component added to archetype %" PRIu64 ": result id is: %" PRIu64 "\n", origin_arch_id, new_archetype_id);
+    caff_log_trace("[ARCHETYPE INDEX] Component removed from archetype %" PRIu64 ": result id is: %" PRIu64 "\n", origin_arch_id, new_archetype_id);
     return new_archetype_id;
 }
 
@@ -314,10 +355,16 @@ static archetype_info archetype_info_create(ecs_archetype from)
 {
     archetype_info info = {
         .archetype = from,
+        .mask = {0},
         .on_add = {0},
         .on_remove = {0},
     };
 
+    for (uint32_t i = 0; i < from.count; i++)
+    {
+        cff_bitset_set(&info.mask, component_id_index(from.components[i]));
+    }
+
     archetype_navigation_init(&info.on_add, 4, archetype_navigation_hash_key_fn, archetype_navigation_cmp_key_fn, archetype_navigation_cmp_data_fn);
     archetype_navigation_init(&info.on_remove, from.count, archetype_navigation_hash_key_fn, archetype_navigation_cmp_key_fn, archetype_navigation_cmp_data_fn);
 
@@ -7,6 +7,7 @@
 
 */
 typedef struct archetype_index archetype_index;
+typedef struct cff_bitset cff_bitset;
 
 archetype_index *ecs_new_archetype_index(uint32_t capacity);
 
@@ -14,6 +15,11 @@ archetype_id ecs_register_archetype(archetype_index *index, ecs_archetype archet
 
 archetype_id ecs_get_archetype_id(const archetype_index *const index_ref, uint32_t count, const component_id *const components);
 
+// archetype ids are below this count, removed ids are not reused
+uint32_t ecs_archetype_get_generated_count(const archetype_index *const index_ref);
+
+const cff_bitset *ecs_archetype_get_mask(const archetype_index *const index_ref, archetype_id archetype);
+
 bool ecs_archetype_has_component(const archetype_index *const index, archetype_id archetype, component_id component);
 
 void ecs_remove_archetype(archetype_index *index, archetype_id id);
@@ -0,0 +1,142 @@
+#include "ecs_command_buffer.h"
+#include "../caffeine_memory.h"
+#include "../ds/caffeine_vector.h"
+
+cff_arr_dcltype(command_list, ecs_command);
+cff_arr_impl(command_list, ecs_command);
+
+cff_arr_dcltype(byte_list, uint8_t);
+cff_arr_impl(byte_list, uint8_t);
+
+struct ecs_command_buffer
+{
+    command_list commands;
+    // payload of set commands, referenced by offset since it grows
+    byte_list data;
+    uint32_t thread_index;
+    uint32_t created_count;
+};
+
+static void ecs_command_buffer_push(ecs_command_buffer *const buffer_mut_ref, ecs_command command);
+
+ecs_command_buffer *ecs_command_buffer_new(uint32_t thread_index)
+{
+    ecs_command_buffer *buffer = (ecs_command_buffer *)CFF_ALLOC(sizeof(ecs_command_buffer), "ECS COMMAND BUFFER");
+
+    if (buffer == NULL)
+        return NULL;
+
+    command_list_init(&(buffer->commands), 64);
+    byte_list_init(&(buffer->data), 1024);
+    buffer->thread_index = thread_index;
+    buffer->created_count = 0;
+
+    return buffer;
+}
+
+void ecs_command_buffer_release(ecs_command_buffer *buffer_owning)
+{
+    if (buffer_owning == NULL)
+        return;
+
+    command_list_release(&(buffer_owning->commands));
+    byte_list_release(&(buffer_owning->data));
+    CFF_RELEASE(buffer_owning);
+}
+
+void ecs_command_buffer_clear(ecs_command_buffer *const buffer_mut_ref)
+{
+    buffer_mut_ref->commands.count = 0;
+    buffer_mut_ref->data.count = 0;
+    buffer_mut_ref->created_count = 0;
+}
+
+entity_id ecs_command_buffer_create_entity(ecs_command_buffer *const buffer_mut_ref, archetype_id archetype)
+{
+    // unique among all buffers until playback, the thread keeps handles of different buffers apart
+    entity_id handle = ECS_DEFERRED_ENTITY | ((entity_id)buffer_mut_ref->thread_index << 32) | buffer_mut_ref->created_count;
+    buffer_mut_ref->created_count++;
+
+    ecs_command_buffer_push(buffer_mut_ref, (ecs_command){.type = ECS_COMMAND_CREATE, .entity = handle, .target = archetype});
+    return handle;
+}
+
+void ecs_command_buffer_destroy_entity(ecs_command_buffer *const buffer_mut_ref, entity_id entity)
+{
+    ecs_command_buffer_push(buffer_mut_ref, (ecs_command){.type = ECS_COMMAND_DESTROY, .entity = entity});
+}
+
+void ecs_command_buffer_add_component(ecs_command_buffer *const buffer_mut_ref, entity_id entity, component_id component)
+{
+    ecs_command_buffer_push(buffer_mut_ref, (ecs_command){.type = ECS_COMMAND_ADD, .entity = entity, .target = component});
+}
+
+void ecs_command_buffer_remove_component(ecs_command_buffer *const buffer_mut_ref, entity_id entity, component_id component)
+{
+    ecs_command_buffer_push(buffer_mut_ref, (ecs_command){.type = ECS_COMMAND_REMOVE, .entity = entity, .target = component});
+}
+
+void ecs_command_buffer_set_component(ecs_command_buffer *const buffer_mut_ref, entity_id entity, component_id component, const void *const data, size_t size)
+{
+    byte_list *bytes = &(buffer_mut_ref->data);
+    uint32_t offset = bytes->count;
+
+    // keep every payload aligned for any component type
+    offset = (offset + 15) & ~(uint32_t)15;
+
+    if (offset + size > bytes->capacity)
+    {
+        uint32_t capacity = bytes->capacity;
+        while (offset + size > capacity)
+            capacity *= 2;
+        byte_list_resize(bytes, capacity);
+    }
+
+    CFF_COPY(data, bytes->buffer + offset, size);
+    bytes->count = offset + (uint32_t)size;
+
+    ecs_command_buffer_push(buffer_mut_ref, (ecs_command){
+                                                .type = ECS_COMMAND_SET,
+                                                .entity = entity,
+                                                .target = component,
+                                                .data_offset = offset,
+                                                .data_size = (uint32_t)size,
+                                            });
+}
+
+void ecs_command_buffer_set_entity_enabled(ecs_command_buffer *const buffer_mut_ref, entity_id entity, bool enabled)
+{
+    ecs_command_type type = enabled ? ECS_COMMAND_ENABLE : ECS_COMMAND_DISABLE;
+    ecs_command_buffer_push(buffer_mut_ref, (ecs_command){.type = type, .entity = entity, .target = INVALID_ID});
+}
+
+void ecs_command_buffer_set_component_enabled(ecs_command_buffer *const buffer_mut_ref, entity_id entity, component_id component, bool enabled)
+{
+    ecs_command_type type = enabled ? ECS_COMMAND_ENABLE : ECS_COMMAND_DISABLE;
+    ecs_command_buffer_push(buffer_mut_ref, (ecs_command){.type = type, .entity = entity, .target = component});
+}
+
+void ecs_command_buffer_set_parent(ecs_command_buffer *const buffer_mut_ref, entity_id entity, entity_id parent)
+{
+    ecs_command_buffer_push(buffer_mut_ref, (ecs_command){.type = ECS_COMMAND_PARENT, .entity = entity, .target = parent});
+}
+
+uint32_t ecs_command_buffer_count(const ecs_command_buffer *const buffer_ref)
+{
+    return buffer_ref->commands.count;
+}
+
+const ecs_command *ecs_command_buffer_get(const ecs_command_buffer *const buffer_ref, uint32_t index)
+{
+    return command_list_get_ref(&(buffer_ref->commands), index);
+}
+
+const void *ecs_command_buffer_get_data(const ecs_command_buffer *const buffer_ref, const ecs_command *const command)
+{
+    return buffer_ref->data.buffer + command->data_offset;
+}
+
+static void ecs_command_buffer_push(ecs_command_buffer *const buffer_mut_ref, ecs_command command)
+{
+    command_list_add(&(buffer_mut_ref->commands), command);
+}
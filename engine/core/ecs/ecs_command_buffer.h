@@ -0,0 +1,54 @@
+#pragma once
+
+#include "ecs_types.h"
+
+// entities created through a command buffer get this handle until the buffer is played back
+#define ECS_DEFERRED_ENTITY ((entity_id)1 << 63)
+
+typedef enum
+{
+    ECS_COMMAND_CREATE,
+    ECS_COMMAND_DESTROY,
+    ECS_COMMAND_ADD,
+    ECS_COMMAND_REMOVE,
+    ECS_COMMAND_SET,
+    ECS_COMMAND_ENABLE,
+    ECS_COMMAND_DISABLE,
+    ECS_COMMAND_PARENT,
+} ecs_command_type;
+
+typedef struct
+{
+    ecs_command_type type;
+    entity_id entity;
+    // component for add, remove and set, archetype for create, component or INVALID_ID for the entity itself on enable and disable,
+    // parent entity or INVALID_ID for a root on parent
+    uint64_t target;
+    uint32_t data_offset;
+    uint32_t data_size;
+} ecs_command;
+
+typedef struct ecs_command_buffer ecs_command_buffer;
+
+ecs_command_buffer *ecs_command_buffer_new(uint32_t thread_index);
+void ecs_command_buffer_release(ecs_command_buffer *buffer_owning);
+void ecs_command_buffer_clear(ecs_command_buffer *const buffer_mut_ref);
+
+CAFF_API entity_id ecs_command_buffer_create_entity(ecs_command_buffer *const buffer_mut_ref, archetype_id archetype);
+CAFF_API void ecs_command_buffer_destroy_entity(ecs_command_buffer *const buffer_mut_ref, entity_id entity);
+CAFF_API void ecs_command_buffer_add_component(ecs_command_buffer *const buffer_mut_ref, entity_id entity, component_id component);
+CAFF_API void ecs_command_buffer_remove_component(ecs_command_buffer *const buffer_mut_ref, entity_id entity, component_id component);
+CAFF_API void ecs_command_buffer_set_component(ecs_command_buffer *const buffer_mut_ref, entity_id entity, component_id component, const void *const data, size_t size);
+CAFF_API void ecs_command_buffer_set_entity_enabled(ecs_command_buffer *const buffer_mut_ref, entity_id entity, bool enabled);
+CAFF_API void ecs_command_buffer_set_component_enabled(ecs_command_buffer *const buffer_mut_ref, entity_id entity, component_id component, bool enabled);
+// the (ChildOf, parent) pair is asked for on playback, the parent can be a handle of an entity created by a buffer
+CAFF_API void ecs_command_buffer_set_parent(ecs_command_buffer *const buffer_mut_ref, entity_id entity, entity_id parent);
+
+uint32_t ecs_command_buffer_count(const ecs_command_buffer *const buffer_ref);
+const ecs_command *ecs_command_buffer_get(const ecs_command_buffer *const buffer_ref, uint32_t index);
+const void *ecs_command_buffer_get_data(const ecs_command_buffer *const buffer_ref, const ecs_command *const command);
+
+static inline bool ecs_entity_is_deferred(entity_id entity)
+{
+    return (entity & ECS_DEFERRED_ENTITY) != 0;
+}
@@ -11,6 +11,8 @@ typedef struct
     const char *name;
     size_t size;
     size_t align;
+    ecs_type_info hooks;
+    bool has_hooks;
 } component_info;
 
 struct component_index
@@ -51,7 +53,7 @@ component_index *ecs_new_component_index(uint32_t capacity)
     return instance_owning;
 }
 
-component_id ecs_register_component(component_index *const index_mut_ref, const char *const name_ref, component_type type, size_t size, size_t align)
+component_id ecs_register_component(component_index *const index_mut_ref, const char *const name_ref, component_type type, size_t size, size_t align, const ecs_type_info *const hooks)
 {
     name_index *name_table = &(index_mut_ref->name_table);
     if (name_table == NULL)
@@ -97,6 +99,8 @@ component_id ecs_register_component(component_index *const index_mut_ref, const
         .name = name_ref,
         .size = size,
         .align = align,
+        .hooks = hooks != NULL ? *hooks : (ecs_type_info){0},
+        .has_hooks = hooks != NULL && (hooks->ctor || hooks->dtor || hooks->copy || hooks->move),
     };
 
     index_mut_ref->data_owning[id_meta.index] = info;
@@ -173,6 +177,18 @@ size_t ecs_get_component_align(const component_index *const index_ref, component
     return index_ref->data_owning[index].align;
 }
 
+const ecs_type_info *ecs_get_component_hooks(const component_index *const index_ref, component_id id)
+{
+    if (id == INVALID_ID)
+        return NULL;
+
+    uint32_t index = component_id_index(id);
+    if (index >= index_ref->count || !index_ref->data_owning[index].has_hooks)
+        return NULL;
+
+    return &(index_ref->data_owning[index].hooks);
+}
+
 const char *const ecs_get_component_name(const component_index *const index_ref, component_id id)
 {
     if (id == INVALID_ID)
@@ -10,10 +10,12 @@
 typedef struct component_index component_index;
 
 component_index *ecs_new_component_index(uint32_t capacity);
-component_id ecs_register_component(component_index *const index_mut_ref, const char *name, component_type type, size_t size, size_t align);
+component_id ecs_register_component(component_index *const index_mut_ref, const char *name, component_type type, size_t size, size_t align, const ecs_type_info *const hooks);
 component_id ecs_get_component_id(const component_index *const index_ref, const char *name);
 size_t ecs_get_component_size(const component_index *const index_ref, component_id id);
 size_t ecs_get_component_align(const component_index *const index_ref, component_id id);
+// NULL for components registered without hooks
+const ecs_type_info *ecs_get_component_hooks(const component_index *const index_ref, component_id id);
 const char *const ecs_get_component_name(const component_index *const index_ref, component_id id);
 void ecs_remove_component(component_index *const index_mut_ref, component_id id);
 void ecs_release_component_index(const component_index *const index_owning);
\ No newline at end of file
@@ -2,6 +2,7 @@
 
 #include "../caffeine_memory.h"
 #include "../caffeine_logging.h"
+#include "ecs_command_buffer.h"
 
 struct entity_index
 {
@@ -9,7 +10,8 @@ struct entity_index
     uint32_t count;
     entity_record *data;
 
-    entity_id *trash;
+    // slot indices ready to be reused
+    uint32_t *trash;
     uint32_t trash_count;
     uint32_t trash_capacity;
 };
@@ -37,7 +39,7 @@ entity_index *ecs_entity_index_new(uint32_t capacity)
         return NULL;
     }
 
-    index->trash = (entity_id *)CFF_ALLOC(sizeof(entity_id) * (capacity / 2), "ENTITY INDEX TRASH");
+    index->trash = (uint32_t *)CFF_ALLOC(sizeof(uint32_t) * (capacity / 2), "ENTITY INDEX TRASH");
     index->trash_count = 0;
     index->trash_capacity = capacity / 2;
 
@@ -71,10 +73,12 @@ entity_id ecs_entity_index_new_entity(entity_index *const index_mut_ref)
 {
     if (index_mut_ref->trash_count > 0)
     {
-        entity_id old_id = index_mut_ref->trash[index_mut_ref->trash_count - 1];
+        uint32_t old_index = index_mut_ref->trash[index_mut_ref->trash_count - 1];
         index_mut_ref->trash_count--;
-        caff_log_trace("[ENTITY INDEX] Recycled an old id: %" PRIu64 "\n", old_id);
-        return old_id;
+
+        entity_id id = ecs_entity_make(old_index, index_mut_ref->data[old_index].generation);
+        caff_log_trace("[ENTITY INDEX] Recycled an old id: %" PRIu64 "\n", id);
+        return id;
     }
 
     if (index_mut_ref->count == index_mut_ref->capacity)
@@ -82,33 +86,123 @@ entity_id ecs_entity_index_new_entity(entity_index *const index_mut_ref)
         index_mut_ref->data = CFF_ARR_RESIZE(index_mut_ref->data, index_mut_ref->capacity * 2);
         index_mut_ref->capacity *= 2;
     }
-    entity_id id = (entity_id)index_mut_ref->count;
+    uint32_t index = index_mut_ref->count;
+    index_mut_ref->data[index] = (entity_record){.row = 0, .generation = 0, .archetype = INVALID_ID, .storage = NULL};
     index_mut_ref->count++;
 
+    entity_id id = ecs_entity_make(index, 0);
     caff_log_trace("[ENTITY INDEX] New entity id generated: %" PRIu64 "\n", id);
     return id;
 }
 
+void ecs_entity_index_new_entities(entity_index *const index_mut_ref, uint32_t count, entity_id *const out_ids)
+{
+    uint32_t recycled = count < index_mut_ref->trash_count ? count : index_mut_ref->trash_count;
+
+    for (uint32_t i = 0; i < recycled; i++)
+    {
+        index_mut_ref->trash_count--;
+        uint32_t old_index = index_mut_ref->trash[index_mut_ref->trash_count];
+        out_ids[i] = ecs_entity_make(old_index, index_mut_ref->data[old_index].generation);
+    }
+
+    // the remaining ids are a contiguous block past the last one handed out
+    uint32_t fresh = count - recycled;
+    uint32_t required = index_mut_ref->count + fresh;
+
+    if (required > index_mut_ref->capacity)
+    {
+        uint32_t new_capacity = index_mut_ref->capacity;
+        while (new_capacity < required)
+            new_capacity *= 2;
+
+        index_mut_ref->data = CFF_ARR_RESIZE(index_mut_ref->data, new_capacity);
+        index_mut_ref->capacity = new_capacity;
+    }
+
+    for (uint32_t i = 0; i < fresh; i++)
+    {
+        uint32_t index = index_mut_ref->count + i;
+        index_mut_ref->data[index] = (entity_record){.row = 0, .generation = 0, .archetype = INVALID_ID, .storage = NULL};
+        out_ids[recycled + i] = ecs_entity_make(index, 0);
+    }
+    index_mut_ref->count = required;
+
+    caff_log_trace("[ENTITY INDEX] %u entity ids generated, %u recycled\n", count, recycled);
+}
+
+void ecs_entity_index_set_entities(entity_index *const index_mut_ref, const entity_id *const ids, uint32_t count, archetype_id archetype, int first_row, ecs_storage *const storage_owning)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t index = ecs_entity_index_of(ids[i]);
+        index_mut_ref->data[index] = (entity_record){
+            .row = first_row + (int)i,
+            .generation = ecs_entity_generation_of(ids[i]),
+            .archetype = archetype,
+            .storage = storage_owning,
+        };
+    }
+}
+
+void ecs_entity_index_remove_entities(entity_index *const index_mut_ref, const entity_id *const ids, uint32_t count)
+{
+    uint32_t required = index_mut_ref->trash_count + count;
+
+    if (required > index_mut_ref->trash_capacity)
+    {
+        uint32_t new_capacity = index_mut_ref->trash_capacity;
+        while (new_capacity < required)
+            new_capacity *= 2;
+
+        index_mut_ref->trash = CFF_ARR_RESIZE(index_mut_ref->trash, new_capacity);
+        index_mut_ref->trash_capacity = new_capacity;
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (!ecs_entity_index_is_alive(index_mut_ref, ids[i]))
+            continue;
+
+        uint32_t index = ecs_entity_index_of(ids[i]);
+        index_mut_ref->data[index] = (entity_record){
+            .row = 0,
+            .generation = (ecs_entity_generation_of(ids[i]) + 1) & ECS_ENTITY_GENERATION_MASK,
+            .archetype = INVALID_ID,
+            .storage = NULL,
+        };
+        index_mut_ref->trash[index_mut_ref->trash_count] = index;
+        index_mut_ref->trash_count++;
+    }
+
+    caff_log_trace("[ENTITY INDEX] %u entity ids removed\n", count);
+}
+
 void ecs_entity_index_set_entity(entity_index *const index_mut_ref, entity_id id, archetype_id archetype, int row, ecs_storage *const storage_owning)
 {
-    if (id >= index_mut_ref->capacity)
+    uint32_t index = ecs_entity_index_of(id);
+
+    if (index >= index_mut_ref->count)
     {
-        caff_log_error("[ENTITY INDEX] Failed to set entity %" PRIu64 " with archetype %" PRIu64 ": id is invalid\n");
+        caff_log_error("[ENTITY INDEX] Failed to set entity %" PRIu64 " with archetype %" PRIu64 ": id is invalid\n", id, archetype);
+        return;
     }
 
-    index_mut_ref->data[id] = (entity_record){
+    index_mut_ref->data[index] = (entity_record){
         .row = row,
+        .generation = ecs_entity_generation_of(id),
         .archetype = archetype,
         .storage = storage_owning,
     };
-    caff_log_trace("[ENTITY INDEX] Setted entity %" PRIu64 " with archetype %" PRIu64 "\n");
+    caff_log_trace("[ENTITY INDEX] Setted entity %" PRIu64 " with archetype %" PRIu64 "\n", id, archetype);
 }
 
 void ecs_entity_index_remove_entity(entity_index *const index_mut_ref, entity_id id)
 {
-    if (id >= index_mut_ref->capacity)
+    if (!ecs_entity_index_is_alive(index_mut_ref, id))
     {
-        caff_log_error("[ENTITY INDEX] Failed to remove entity %" PRIu64 ": id is invalid\n");
+        caff_log_error("[ENTITY INDEX] Failed to remove entity %" PRIu64 ": id is invalid\n", id);
+        return;
     }
 
     if (index_mut_ref->trash_count == index_mut_ref->trash_capacity)
@@ -117,19 +211,38 @@ void ecs_entity_index_remove_entity(entity_index *const index_mut_ref, entity_id
         index_mut_ref->trash_capacity *= 2;
     }
 
-    index_mut_ref->data[id] = (entity_record){.row = 0, .storage = 0};
-    index_mut_ref->trash[index_mut_ref->trash_count] = id;
+    uint32_t index = ecs_entity_index_of(id);
+
+    // the next id handed out for this slot has a new generation, so this one stops being alive
+    index_mut_ref->data[index] = (entity_record){
+        .row = 0,
+        .generation = (ecs_entity_generation_of(id) + 1) & ECS_ENTITY_GENERATION_MASK,
+        .archetype = INVALID_ID,
+        .storage = NULL,
+    };
+    index_mut_ref->trash[index_mut_ref->trash_count] = index;
     index_mut_ref->trash_count++;
 
-    caff_log_trace("[ENTITY INDEX] Entity id %" PRIu64 " removed\n");
+    caff_log_trace("[ENTITY INDEX] Entity id %" PRIu64 " removed\n", id);
 }
 
 entity_record ecs_entity_index_get_entity(const entity_index *const index_ref, entity_id id)
 {
-    if (id >= index_ref->capacity)
+    if (!ecs_entity_index_is_alive(index_ref, id))
     {
-        caff_log_error("[ENTITY INDEX] Failed to get entity %" PRIu64 ": id is invalid\n");
-        return (entity_record){0};
+        caff_log_error("[ENTITY INDEX] Failed to get entity %" PRIu64 ": id is invalid\n", id);
+        return (entity_record){.archetype = INVALID_ID};
     }
-    return index_ref->data[id];
-}
\ No newline at end of file
+    return index_ref->data[ecs_entity_index_of(id)];
+}
+
+bool ecs_entity_index_is_alive(const entity_index *const index_ref, entity_id id)
+{
+    uint32_t index = ecs_entity_index_of(id);
+
+    if (index >= index_ref->count || (id & ECS_DEFERRED_ENTITY) != 0)
+        return false;
+
+    const entity_record *record = index_ref->data + index;
+    return record->archetype != INVALID_ID && record->generation == ecs_entity_generation_of(id);
+}
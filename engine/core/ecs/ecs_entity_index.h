@@ -7,6 +7,8 @@ typedef struct ecs_storage ecs_storage;
 typedef struct
 {
     int row;
+    // bumped every time the slot is freed, ids of older generations are dead
+    uint32_t generation;
     archetype_id archetype;
     ecs_storage *storage;
 } entity_record;
@@ -17,7 +19,11 @@ entity_index *ecs_entity_index_new(uint32_t capacity);
 void ecs_entity_index_release(const entity_index *const index_ref);
 
 entity_id ecs_entity_index_new_entity(entity_index *index);
+void ecs_entity_index_new_entities(entity_index *const index_mut_ref, uint32_t count, entity_id *const out_ids);
 
 void ecs_entity_index_set_entity(entity_index *const index_mut_ref, entity_id id, archetype_id archetype, int row, ecs_storage *const storage_owning);
 entity_record ecs_entity_index_get_entity(const entity_index *const index_ref, entity_id id);
-void ecs_entity_index_remove_entity(entity_index *index, entity_id id);
\ No newline at end of file
+bool ecs_entity_index_is_alive(const entity_index *const index_ref, entity_id id);
+void ecs_entity_index_set_entities(entity_index *const index_mut_ref, const entity_id *const ids, uint32_t count, archetype_id archetype, int first_row, ecs_storage *const storage_owning);
+void ecs_entity_index_remove_entity(entity_index *index, entity_id id);
+void ecs_entity_index_remove_entities(entity_index *const index_mut_ref, const entity_id *const ids, uint32_t count);
\ No newline at end of file
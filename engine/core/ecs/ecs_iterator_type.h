@@ -0,0 +1,27 @@
+#pragma once
+
+#include "ecs_types.h"
+
+struct ecs_iterator
+{
+    const struct ecs_storage *storage;
+    uint32_t chunk;
+    // first row of the chunk handed to the system, non zero when a parallel system splits the chunk
+    uint32_t offset;
+    void **columns;
+    uint32_t column_count;
+    // resources declared by the query, resolved when the run starts
+    void **resources;
+    uint32_t resource_count;
+    const struct sparse_index *sparse;
+    // relation and target of the pair components in the storage
+    const struct pair_index *pairs;
+    // values of the shared components in the storage
+    const struct shared_index *shared;
+    // rows handed out by the current chunk or range
+    uint32_t count;
+    // cached query iteration state, position in the matched archetypes of the runner in source
+    uint32_t cursor;
+    void *source;
+    bool (*next)(struct ecs_iterator *it);
+};
@@ -0,0 +1,280 @@
+#include <stdlib.h>
+#include "ecs_observer_index.h"
+#include "ecs_query.h"
+#include "ecs_archetype_index.h"
+#include "../caffeine_memory.h"
+#include "../ds/caffeine_vector.h"
+
+typedef struct
+{
+    ecs_observer_event event;
+    component_id component;
+    // entities of the archetypes matching the query are observed
+    ecs_query *query;
+    ecs_observer observer;
+    void *context;
+} observer_info;
+
+typedef struct
+{
+    uint32_t observer;
+    // emission order, kept inside each observer batch
+    uint32_t sequence;
+    component_id component;
+    entity_id entity;
+} observer_event;
+
+cff_arr_dcltype(observer_list, observer_info);
+cff_arr_impl(observer_list, observer_info);
+
+cff_arr_dcltype(event_list, observer_event);
+cff_arr_impl(event_list, observer_event);
+
+cff_arr_dcltype(batch_list, entity_id);
+cff_arr_impl(batch_list, entity_id);
+
+struct observer_index
+{
+    observer_list observers;
+    uint32_t observer_count;
+    event_list events;
+    // events being delivered, observers may queue new ones meanwhile
+    event_list delivering;
+    batch_list batch;
+    const archetype_index *archetypes;
+    bool dispatching;
+};
+
+static bool observer_matches(const observer_index *index, const observer_info *info, archetype_id archetype);
+static bool observer_watches(const observer_info *info, component_id component);
+static void observer_queue(observer_index *index, uint32_t observer, component_id component, const entity_id *entities, uint32_t count);
+static int observer_cmp_events(const void *a, const void *b);
+
+observer_index *ecs_observer_index_new(const archetype_index *const archetypes, uint32_t capacity)
+{
+    observer_index *index = (observer_index *)CFF_ALLOC(sizeof(observer_index), "OBSERVER INDEX");
+    if (index == NULL)
+        return NULL;
+
+    observer_list_init(&(index->observers), capacity);
+    event_list_init(&(index->events), capacity);
+    event_list_init(&(index->delivering), capacity);
+    batch_list_init(&(index->batch), capacity);
+    index->observer_count = 0;
+    index->archetypes = archetypes;
+    index->dispatching = false;
+
+    return index;
+}
+
+void ecs_observer_index_release(observer_index *index_owning)
+{
+    for (uint32_t i = 0; i < index_owning->observers.count; i++)
+    {
+        observer_info *info = observer_list_get_ref(&(index_owning->observers), i);
+        if (info->query != NULL)
+            ecs_query_release(info->query);
+    }
+
+    observer_list_release(&(index_owning->observers));
+    event_list_release(&(index_owning->events));
+    event_list_release(&(index_owning->delivering));
+    batch_list_release(&(index_owning->batch));
+    CFF_RELEASE(index_owning);
+}
+
+uint32_t ecs_observer_index_add(observer_index *const index_mut_ref, ecs_observer_event event, component_id component, ecs_query *query_owning, ecs_observer observer, void *context)
+{
+    if (query_owning == NULL)
+    {
+        ecs_query_builder *builder = ecs_query_builder_new();
+        ecs_query_builder_with_component_access(builder, component, ECS_ACCESS_READ);
+        query_owning = ecs_query_builder_build(builder);
+        ecs_query_builder_release(builder);
+    }
+
+    observer_info info = {
+        .event = event,
+        .component = component,
+        .query = query_owning,
+        .observer = observer,
+        .context = context,
+    };
+
+    // ids are positions, removed observers leave their slot behind
+    uint32_t id = 0;
+    observer_list_add_i(&(index_mut_ref->observers), info, &id);
+    index_mut_ref->observer_count++;
+
+    return id;
+}
+
+void ecs_observer_index_remove(observer_index *const index_mut_ref, uint32_t id)
+{
+    if (id >= index_mut_ref->observers.count)
+        return;
+
+    observer_info *info = observer_list_get_ref(&(index_mut_ref->observers), id);
+    if (info->observer == NULL)
+        return;
+
+    // events already queued for it are dropped on dispatch
+    ecs_query_release(info->query);
+    info->query = NULL;
+    info->observer = NULL;
+    index_mut_ref->observer_count--;
+}
+
+bool ecs_observer_index_is_empty(const observer_index *const index_ref)
+{
+    return index_ref->observer_count == 0;
+}
+
+void ecs_observer_index_emit_transition(observer_index *const index_mut_ref, archetype_id from, archetype_id to, const entity_id *const entities, uint32_t count)
+{
+    if (index_mut_ref->observer_count == 0 || count == 0 || from == to)
+        return;
+
+    for (uint32_t i = 0; i < index_mut_ref->observers.count; i++)
+    {
+        const observer_info *info = observer_list_get_ref(&(index_mut_ref->observers), i);
+        if (info->observer == NULL || info->event == ECS_ON_SET)
+            continue;
+
+        bool matched_before = observer_matches(index_mut_ref, info, from);
+        bool matches_now = observer_matches(index_mut_ref, info, to);
+
+        if (info->event == ECS_ON_ADD && !matched_before && matches_now)
+            observer_queue(index_mut_ref, i, info->component, entities, count);
+        else if (info->event == ECS_ON_REMOVE && matched_before && !matches_now)
+            observer_queue(index_mut_ref, i, info->component, entities, count);
+    }
+}
+
+void ecs_observer_index_emit_component(observer_index *const index_mut_ref, ecs_observer_event event, component_id component, const entity_id *const entities, uint32_t count)
+{
+    if (index_mut_ref->observer_count == 0 || count == 0)
+        return;
+
+    for (uint32_t i = 0; i < index_mut_ref->observers.count; i++)
+    {
+        const observer_info *info = observer_list_get_ref(&(index_mut_ref->observers), i);
+        if (info->observer != NULL && info->event == event && info->component == component)
+            observer_queue(index_mut_ref, i, component, entities, count);
+    }
+}
+
+void ecs_observer_index_emit_set(observer_index *const index_mut_ref, archetype_id archetype, component_id component, const entity_id *const entities, uint32_t count)
+{
+    if (index_mut_ref->observer_count == 0 || count == 0)
+        return;
+
+    for (uint32_t i = 0; i < index_mut_ref->observers.count; i++)
+    {
+        const observer_info *info = observer_list_get_ref(&(index_mut_ref->observers), i);
+        if (info->observer == NULL || info->event != ECS_ON_SET)
+            continue;
+
+        if (observer_watches(info, component) && observer_matches(index_mut_ref, info, archetype))
+            observer_queue(index_mut_ref, i, component, entities, count);
+    }
+}
+
+void ecs_observer_index_dispatch(observer_index *const index_mut_ref, ecs_world *world)
+{
+    // an observer flushing the world queues its events for the loop below
+    if (index_mut_ref->dispatching)
+        return;
+
+    index_mut_ref->dispatching = true;
+
+    while (index_mut_ref->events.count > 0)
+    {
+        event_list events = index_mut_ref->events;
+        index_mut_ref->events = index_mut_ref->delivering;
+        index_mut_ref->events.count = 0;
+        index_mut_ref->delivering = events;
+
+        qsort(events.buffer, events.count, sizeof(observer_event), observer_cmp_events);
+
+        uint32_t first = 0;
+        while (first < events.count)
+        {
+            const observer_event *event = events.buffer + first;
+            uint32_t last = first;
+
+            index_mut_ref->batch.count = 0;
+            while (last < events.count && events.buffer[last].observer == event->observer && events.buffer[last].component == event->component)
+            {
+                batch_list_add(&(index_mut_ref->batch), events.buffer[last].entity);
+                last++;
+            }
+
+            // read again, an earlier observer of the batch may have removed it
+            const observer_info *info = observer_list_get_ref(&(index_mut_ref->observers), event->observer);
+            if (info->observer != NULL)
+                info->observer(world, index_mut_ref->batch.buffer, index_mut_ref->batch.count, event->component, info->context);
+
+            first = last;
+        }
+
+        index_mut_ref->delivering.count = 0;
+    }
+
+    index_mut_ref->dispatching = false;
+}
+
+static bool observer_matches(const observer_index *index, const observer_info *info, archetype_id archetype)
+{
+    // observers of sparse components and row tags only get the events emitted for the component
+    if (archetype == INVALID_ID || (info->component != INVALID_ID && (component_id_is_sparse(info->component) || component_id_is_row_tag(info->component))))
+        return false;
+
+    const cff_bitset *mask = ecs_archetype_get_mask(index->archetypes, archetype);
+    return mask != NULL && ecs_query_matches(info->query, mask);
+}
+
+static bool observer_watches(const observer_info *info, component_id component)
+{
+    if (info->component == component)
+        return true;
+
+    const component_id *terms = ecs_query_get_terms(info->query);
+    uint32_t term_count = ecs_query_get_terms_count(info->query);
+
+    for (uint32_t t = 0; t < term_count; t++)
+    {
+        if (terms[t] == component)
+            return true;
+    }
+
+    return false;
+}
+
+static void observer_queue(observer_index *index, uint32_t observer, component_id component, const entity_id *entities, uint32_t count)
+{
+    for (uint32_t i = 0; i < count; i++)
+    {
+        observer_event event = {
+            .observer = observer,
+            .sequence = index->events.count,
+            .component = component,
+            .entity = entities[i],
+        };
+        event_list_add(&(index->events), event);
+    }
+}
+
+static int observer_cmp_events(const void *a, const void *b)
+{
+    const observer_event *event_a = (const observer_event *)a;
+    const observer_event *event_b = (const observer_event *)b;
+
+    if (event_a->observer != event_b->observer)
+        return event_a->observer < event_b->observer ? -1 : 1;
+    if (event_a->component != event_b->component)
+        return event_a->component < event_b->component ? -1 : 1;
+    if (event_a->sequence != event_b->sequence)
+        return event_a->sequence < event_b->sequence ? -1 : 1;
+    return 0;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "ecs_types.h"
+
+typedef struct observer_index observer_index;
+typedef struct archetype_index archetype_index;
+
+observer_index *ecs_observer_index_new(const archetype_index *const archetypes, uint32_t capacity);
+void ecs_observer_index_release(observer_index *index_owning);
+
+// query_owning may be NULL for component observers, the index builds one with the component
+uint32_t ecs_observer_index_add(observer_index *const index_mut_ref, ecs_observer_event event, component_id component, ecs_query *query_owning, ecs_observer observer, void *context);
+void ecs_observer_index_remove(observer_index *const index_mut_ref, uint32_t id);
+bool ecs_observer_index_is_empty(const observer_index *const index_ref);
+
+// INVALID_ID as from or to for entities being created or destroyed
+void ecs_observer_index_emit_transition(observer_index *const index_mut_ref, archetype_id from, archetype_id to, const entity_id *const entities, uint32_t count);
+// events of components living outside of the archetypes, only observers of the component get them
+void ecs_observer_index_emit_component(observer_index *const index_mut_ref, ecs_observer_event event, component_id component, const entity_id *const entities, uint32_t count);
+void ecs_observer_index_emit_set(observer_index *const index_mut_ref, archetype_id archetype, component_id component, const entity_id *const entities, uint32_t count);
+// delivers the queued events grouped per observer, events queued by the observers themselves are delivered in the same call
+void ecs_observer_index_dispatch(observer_index *const index_mut_ref, ecs_world *world);
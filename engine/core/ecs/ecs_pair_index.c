@@ -0,0 +1,204 @@
+#include "ecs_pair_index.h"
+#include "../caffeine_memory.h"
+#include "../ds/caffeine_vector.h"
+#include "../ds/caffeine_sparseset.h"
+
+typedef struct
+{
+    entity_id target;
+    component_id pair;
+} pair_target;
+
+cff_sparse_dcltype(target_set, pair_target);
+
+typedef struct
+{
+    component_id relation;
+    // pairs of the relation keyed by the index of their target
+    target_set targets;
+} relation_info;
+
+typedef struct
+{
+    component_id pair;
+    component_id relation;
+    entity_id target;
+    // the component index and the storage name tables point to it
+    char *name;
+} pair_info;
+
+cff_arr_dcltype(relation_list, relation_info);
+cff_arr_impl(relation_list, relation_info);
+
+cff_arr_dcltype(pair_list, pair_info);
+cff_arr_impl(pair_list, pair_info);
+
+struct pair_index
+{
+    relation_list relations;
+    pair_list pairs;
+    // position of each pair in pairs by component index, CFF_SPARSE_EMPTY for the other components
+    uint32_t *lookup;
+    uint32_t lookup_capacity;
+};
+
+static relation_info *pair_index_find_relation(const pair_index *index, component_id relation);
+static const pair_info *pair_index_find(const pair_index *index, component_id pair);
+static uint32_t pair_target_key(pair_target value);
+
+pair_index *ecs_pair_index_new(uint32_t capacity)
+{
+    pair_index *index = (pair_index *)CFF_ALLOC(sizeof(pair_index), "PAIR INDEX");
+    if (index == NULL)
+        return NULL;
+
+    capacity = capacity ? capacity : 1;
+    relation_list_init(&(index->relations), 4);
+    pair_list_init(&(index->pairs), capacity);
+    index->lookup = (uint32_t *)CFF_ALLOC(sizeof(uint32_t) * capacity, "PAIR INDEX LOOKUP");
+    index->lookup_capacity = capacity;
+
+    for (uint32_t i = 0; i < capacity; i++)
+        index->lookup[i] = CFF_SPARSE_EMPTY;
+
+    return index;
+}
+
+void ecs_pair_index_release(pair_index *index_owning)
+{
+    for (uint32_t i = 0; i < index_owning->relations.count; i++)
+        cff_sparse_release(&(relation_list_get_ref(&(index_owning->relations), i)->targets));
+
+    for (uint32_t i = 0; i < index_owning->pairs.count; i++)
+        CFF_RELEASE(pair_list_get_ref(&(index_owning->pairs), i)->name);
+
+    relation_list_release(&(index_owning->relations));
+    pair_list_release(&(index_owning->pairs));
+    CFF_RELEASE(index_owning->lookup);
+    CFF_RELEASE(index_owning);
+}
+
+component_id ecs_pair_index_get(const pair_index *const index_ref, component_id relation, entity_id target)
+{
+    const relation_info *info = pair_index_find_relation(index_ref, relation);
+    if (info == NULL)
+        return INVALID_ID;
+
+    uint32_t position = cff_sparse_index_of(&(info->targets), ecs_entity_index_of(target));
+    if (position == CFF_SPARSE_EMPTY || cff_sparse_get(&(info->targets), position).target != target)
+        return INVALID_ID;
+
+    return cff_sparse_get(&(info->targets), position).pair;
+}
+
+void ecs_pair_index_add(pair_index *const index_mut_ref, component_id pair, component_id relation, entity_id target, char *name_owning)
+{
+    uint32_t slot = component_id_index(pair);
+    if (slot >= index_mut_ref->lookup_capacity)
+    {
+        uint32_t capacity = index_mut_ref->lookup_capacity;
+        while (capacity <= slot)
+            capacity *= 2;
+
+        uint32_t *lookup = CFF_ARR_RESIZE(index_mut_ref->lookup, capacity);
+        if (lookup == NULL)
+        {
+            CFF_RELEASE(name_owning);
+            return;
+        }
+
+        for (uint32_t i = index_mut_ref->lookup_capacity; i < capacity; i++)
+            lookup[i] = CFF_SPARSE_EMPTY;
+
+        index_mut_ref->lookup = lookup;
+        index_mut_ref->lookup_capacity = capacity;
+    }
+
+    relation_info *info = pair_index_find_relation(index_mut_ref, relation);
+    if (info == NULL)
+    {
+        relation_info new_info = {.relation = relation};
+        cff_sparse_init(&(new_info.targets), 16);
+        relation_list_add(&(index_mut_ref->relations), new_info);
+        info = relation_list_get_ref(&(index_mut_ref->relations), index_mut_ref->relations.count - 1);
+    }
+
+    // a slot still held by a destroyed generation of the target is dropped first
+    uint32_t key = ecs_entity_index_of(target);
+    if (cff_sparse_contains(&(info->targets), key))
+        cff_sparse_remove(&(info->targets), key, pair_target_key);
+
+    uint32_t position = 0;
+    cff_sparse_add(&(info->targets), key, ((pair_target){.target = target, .pair = pair}), position);
+
+    pair_info entry = {.pair = pair, .relation = relation, .target = target, .name = name_owning};
+    pair_list_add_i(&(index_mut_ref->pairs), entry, &position);
+    index_mut_ref->lookup[slot] = position;
+}
+
+void ecs_pair_index_remove(pair_index *const index_mut_ref, component_id pair)
+{
+    const pair_info *entry = pair_index_find(index_mut_ref, pair);
+    if (entry == NULL)
+        return;
+
+    relation_info *info = pair_index_find_relation(index_mut_ref, entry->relation);
+    uint32_t key = ecs_entity_index_of(entry->target);
+    uint32_t position = cff_sparse_index_of(&(info->targets), key);
+
+    if (position != CFF_SPARSE_EMPTY && cff_sparse_get(&(info->targets), position).pair == pair)
+        cff_sparse_remove(&(info->targets), key, pair_target_key);
+}
+
+component_id ecs_pair_index_relation(const pair_index *const index_ref, component_id pair)
+{
+    const pair_info *entry = pair_index_find(index_ref, pair);
+    return entry != NULL ? entry->relation : INVALID_ID;
+}
+
+entity_id ecs_pair_index_target(const pair_index *const index_ref, component_id pair)
+{
+    const pair_info *entry = pair_index_find(index_ref, pair);
+    return entry != NULL ? entry->target : INVALID_ID;
+}
+
+uint32_t ecs_pair_index_relation_count(const pair_index *const index_ref)
+{
+    return index_ref->relations.count;
+}
+
+component_id ecs_pair_index_get_relation(const pair_index *const index_ref, uint32_t position)
+{
+    if (position >= index_ref->relations.count)
+        return INVALID_ID;
+    return index_ref->relations.buffer[position].relation;
+}
+
+static relation_info *pair_index_find_relation(const pair_index *index, component_id relation)
+{
+    // relations are few, most worlds only have ChildOf
+    for (uint32_t i = 0; i < index->relations.count; i++)
+    {
+        if (index->relations.buffer[i].relation == relation)
+            return index->relations.buffer + i;
+    }
+    return NULL;
+}
+
+static const pair_info *pair_index_find(const pair_index *index, component_id pair)
+{
+    if (pair == INVALID_ID || !component_id_is_pair(pair))
+        return NULL;
+
+    uint32_t slot = component_id_index(pair);
+    if (slot >= index->lookup_capacity || index->lookup[slot] == CFF_SPARSE_EMPTY)
+        return NULL;
+
+    const pair_info *entry = index->pairs.buffer + index->lookup[slot];
+    return entry->pair == pair ? entry : NULL;
+}
+
+static uint32_t pair_target_key(pair_target value)
+{
+    return ecs_entity_index_of(value.target);
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "ecs_types.h"
+
+typedef struct pair_index pair_index;
+
+pair_index *ecs_pair_index_new(uint32_t capacity);
+void ecs_pair_index_release(pair_index *index_owning);
+
+// pair component of relation and target, INVALID_ID while none was added
+component_id ecs_pair_index_get(const pair_index *const index_ref, component_id relation, entity_id target);
+// records the component registered for relation and target, the index keeps name_owning alive until it is released
+void ecs_pair_index_add(pair_index *const index_mut_ref, component_id pair, component_id relation, entity_id target, char *name_owning);
+// forgets the pair of a destroyed target, the component keeps its relation and target
+void ecs_pair_index_remove(pair_index *const index_mut_ref, component_id pair);
+
+component_id ecs_pair_index_relation(const pair_index *const index_ref, component_id pair);
+entity_id ecs_pair_index_target(const pair_index *const index_ref, component_id pair);
+
+// relations with at least one pair added, in the order they got their first one
+uint32_t ecs_pair_index_relation_count(const pair_index *const index_ref);
+component_id ecs_pair_index_get_relation(const pair_index *const index_ref, uint32_t position);
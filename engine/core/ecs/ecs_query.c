@@ -1,23 +1,75 @@
 #include "ecs_query.h"
 #include "../caffeine_memory.h"
 #include "../ds/caffeine_vector.h"
+#include "../ds/caffeine_bitset.h"
 #include "ecs_storage.h"
+#include "ecs_sparse_index.h"
+#include "ecs_pair_index.h"
+#include "ecs_shared_index.h"
+#include "ecs_iterator_type.h"
 
 struct ecs_query
 {
     const component_id *requiriments;
     uint32_t requiriments_count;
+    const component_id *terms;
+    uint32_t terms_count;
+    const ecs_term_access *access;
+    // requiriments as a component index bitset, matched against the archetype masks
+    cff_bitset mask;
+    cff_bitset without;
+    // the archetype must have at least one component of each group
+    cff_bitset *any_of;
+    uint32_t any_of_count;
+    // only rows written since the last run of the query pass, in every one of these components
+    const component_id *changed;
+    uint32_t changed_count;
+    const component_id *resources;
+    const ecs_term_access *resources_access;
+    uint32_t resources_count;
+    // sparse components take no part in archetype matching, rows are filtered by their membership
+    const component_id *sparse;
+    uint32_t sparse_count;
+    const component_id *sparse_without;
+    uint32_t sparse_without_count;
+    // row tags neither, rows are filtered by the tag bits of their storage
+    const component_id *row_tags;
+    uint32_t row_tags_count;
+    const component_id *row_tags_without;
+    uint32_t row_tags_without_count;
+    ecs_query_flags flags;
 };
 
+cff_arr_dcltype(term_list, component_id);
+cff_arr_impl(term_list, component_id);
+
+cff_arr_dcltype(access_list, ecs_term_access);
+cff_arr_impl(access_list, ecs_term_access);
+
+cff_arr_dcltype(group_list, uint32_t);
+cff_arr_impl(group_list, uint32_t);
+
+static bool ecs_query_builder_add_term(ecs_query_builder *const builder_mut_ref, component_id component, ecs_term_access access);
+
 struct ecs_query_builder
 {
-    component_id *buffer;
-    uint32_t count;
-    uint32_t capacity;
+    term_list requiriments;
+    term_list terms;
+    access_list access;
+    term_list without;
+    // any_of groups flattened, any_of_sizes holds the lenght of each group
+    term_list any_of;
+    group_list any_of_sizes;
+    term_list changed;
+    term_list resources;
+    access_list resources_access;
+    term_list sparse;
+    term_list sparse_without;
+    term_list row_tags;
+    term_list row_tags_without;
+    ecs_query_flags flags;
 };
 
-cff_arr_impl(ecs_query_builder, component_id);
-
 ecs_query_builder *ecs_query_builder_new()
 {
     uint32_t capacity = 4;
@@ -29,60 +81,463 @@ ecs_query_builder *ecs_query_builder_new()
         return NULL;
     }
 
-    ecs_query_builder_init(builder, capacity);
+    term_list_init(&(builder->requiriments), capacity);
+    term_list_init(&(builder->terms), capacity);
+    access_list_init(&(builder->access), capacity);
+    term_list_init(&(builder->without), capacity);
+    term_list_init(&(builder->any_of), capacity);
+    group_list_init(&(builder->any_of_sizes), capacity);
+    term_list_init(&(builder->changed), capacity);
+    term_list_init(&(builder->resources), capacity);
+    access_list_init(&(builder->resources_access), capacity);
+    term_list_init(&(builder->sparse), capacity);
+    term_list_init(&(builder->sparse_without), capacity);
+    term_list_init(&(builder->row_tags), capacity);
+    term_list_init(&(builder->row_tags_without), capacity);
+    builder->flags = ECS_QUERY_DEFAULT;
 
     return builder;
 }
 
 void ecs_query_builder_with_component(ecs_query_builder *const builder_mut_ref, component_id component)
 {
-    cff_arr_ordered_add(builder_mut_ref, component);
+    ecs_query_builder_with_component_access(builder_mut_ref, component, ECS_ACCESS_READ_WRITE);
+}
+
+void ecs_query_builder_with_component_access(ecs_query_builder *const builder_mut_ref, component_id component, ecs_term_access access)
+{
+    if (!ecs_query_builder_add_term(builder_mut_ref, component, access))
+        return;
+
+    if (component_id_is_sparse(component))
+    {
+        term_list_add(&(builder_mut_ref->sparse), component);
+        return;
+    }
+
+    if (component_id_is_row_tag(component))
+    {
+        term_list_add(&(builder_mut_ref->row_tags), component);
+        return;
+    }
+
+    // requiriments are kept sorted to match archetypes, terms keep the order the user declared them
+    cff_arr_ordered_add(&(builder_mut_ref->requiriments), component);
+}
+
+void ecs_query_builder_optional(ecs_query_builder *const builder_mut_ref, component_id component, ecs_term_access access)
+{
+    ecs_query_builder_add_term(builder_mut_ref, component, access);
+}
+
+void ecs_query_builder_without(ecs_query_builder *const builder_mut_ref, component_id component)
+{
+    if (component_id_is_sparse(component))
+        term_list_add(&(builder_mut_ref->sparse_without), component);
+    else if (component_id_is_row_tag(component))
+        term_list_add(&(builder_mut_ref->row_tags_without), component);
+    else
+        term_list_add(&(builder_mut_ref->without), component);
+}
+
+void ecs_query_builder_any_of(ecs_query_builder *const builder_mut_ref, const component_id *const components, uint32_t count)
+{
+    if (count == 0)
+        return;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        term_list_add(&(builder_mut_ref->any_of), components[i]);
+    }
+    group_list_add(&(builder_mut_ref->any_of_sizes), count);
+}
+
+void ecs_query_builder_changed(ecs_query_builder *const builder_mut_ref, component_id component)
+{
+    // sparse components keep no change ticks, the filter only requires them
+    if (component_id_is_sparse(component))
+    {
+        for (uint32_t i = 0; i < builder_mut_ref->sparse.count; i++)
+        {
+            if (builder_mut_ref->sparse.buffer[i] == component)
+                return;
+        }
+        term_list_add(&(builder_mut_ref->sparse), component);
+        return;
+    }
+
+    // neither do row tags
+    if (component_id_is_row_tag(component))
+    {
+        for (uint32_t i = 0; i < builder_mut_ref->row_tags.count; i++)
+        {
+            if (builder_mut_ref->row_tags.buffer[i] == component)
+                return;
+        }
+        term_list_add(&(builder_mut_ref->row_tags), component);
+        return;
+    }
+
+    for (uint32_t i = 0; i < builder_mut_ref->changed.count; i++)
+    {
+        if (builder_mut_ref->changed.buffer[i] == component)
+            return;
+    }
+    term_list_add(&(builder_mut_ref->changed), component);
+
+    // a changed filter implies the component, it needs no column
+    for (uint32_t i = 0; i < builder_mut_ref->requiriments.count; i++)
+    {
+        if (builder_mut_ref->requiriments.buffer[i] == component)
+            return;
+    }
+    cff_arr_ordered_add(&(builder_mut_ref->requiriments), component);
+}
+
+static bool ecs_query_builder_add_term(ecs_query_builder *const builder_mut_ref, component_id component, ecs_term_access access)
+{
+    for (uint32_t i = 0; i < builder_mut_ref->terms.count; i++)
+    {
+        if (builder_mut_ref->terms.buffer[i] != component)
+            continue;
+
+        // a component declared twice keeps the widest access
+        if (access == ECS_ACCESS_READ_WRITE)
+            builder_mut_ref->access.buffer[i] = ECS_ACCESS_READ_WRITE;
+
+        // an optional term declared again as required becomes required
+        for (uint32_t j = 0; j < builder_mut_ref->requiriments.count; j++)
+        {
+            if (builder_mut_ref->requiriments.buffer[j] == component)
+                return false;
+        }
+        for (uint32_t j = 0; j < builder_mut_ref->sparse.count; j++)
+        {
+            if (builder_mut_ref->sparse.buffer[j] == component)
+                return false;
+        }
+        for (uint32_t j = 0; j < builder_mut_ref->row_tags.count; j++)
+        {
+            if (builder_mut_ref->row_tags.buffer[j] == component)
+                return false;
+        }
+        return true;
+    }
+
+    term_list_add(&(builder_mut_ref->terms), component);
+    access_list_add(&(builder_mut_ref->access), access);
+    return true;
+}
+
+void ecs_query_builder_resource(ecs_query_builder *const builder_mut_ref, component_id resource, ecs_term_access access)
+{
+    for (uint32_t i = 0; i < builder_mut_ref->resources.count; i++)
+    {
+        if (builder_mut_ref->resources.buffer[i] != resource)
+            continue;
+
+        if (access == ECS_ACCESS_READ_WRITE)
+            builder_mut_ref->resources_access.buffer[i] = ECS_ACCESS_READ_WRITE;
+        return;
+    }
+
+    term_list_add(&(builder_mut_ref->resources), resource);
+    access_list_add(&(builder_mut_ref->resources_access), access);
+}
+
+void ecs_query_builder_with_flags(ecs_query_builder *const builder_mut_ref, ecs_query_flags flags)
+{
+    builder_mut_ref->flags |= flags;
 }
 
 ecs_query *ecs_query_builder_build(const ecs_query_builder *const builder_ref)
 {
     component_id *comps = NULL;
-    CFF_ARR_COPY(builder_ref->buffer, comps, builder_ref->count);
+    CFF_ARR_COPY(builder_ref->requiriments.buffer, comps, builder_ref->requiriments.count);
 
     if (comps == NULL)
         return NULL;
 
+    component_id *terms = NULL;
+    CFF_ARR_COPY(builder_ref->terms.buffer, terms, builder_ref->terms.count);
+
+    if (terms == NULL)
+    {
+        CFF_RELEASE(comps);
+        return NULL;
+    }
+
+    ecs_term_access *access = NULL;
+    CFF_ARR_COPY(builder_ref->access.buffer, access, builder_ref->access.count);
+
+    if (access == NULL)
+    {
+        CFF_RELEASE(terms);
+        CFF_RELEASE(comps);
+        return NULL;
+    }
+
+    component_id *changed = NULL;
+    if (builder_ref->changed.count > 0)
+        CFF_ARR_COPY(builder_ref->changed.buffer, changed, builder_ref->changed.count);
+
+    component_id *resources = NULL;
+    ecs_term_access *resources_access = NULL;
+    if (builder_ref->resources.count > 0)
+    {
+        CFF_ARR_COPY(builder_ref->resources.buffer, resources, builder_ref->resources.count);
+        CFF_ARR_COPY(builder_ref->resources_access.buffer, resources_access, builder_ref->resources_access.count);
+    }
+
+    component_id *sparse = NULL;
+    if (builder_ref->sparse.count > 0)
+        CFF_ARR_COPY(builder_ref->sparse.buffer, sparse, builder_ref->sparse.count);
+
+    component_id *sparse_without = NULL;
+    if (builder_ref->sparse_without.count > 0)
+        CFF_ARR_COPY(builder_ref->sparse_without.buffer, sparse_without, builder_ref->sparse_without.count);
+
+    component_id *row_tags = NULL;
+    if (builder_ref->row_tags.count > 0)
+        CFF_ARR_COPY(builder_ref->row_tags.buffer, row_tags, builder_ref->row_tags.count);
+
+    component_id *row_tags_without = NULL;
+    if (builder_ref->row_tags_without.count > 0)
+        CFF_ARR_COPY(builder_ref->row_tags_without.buffer, row_tags_without, builder_ref->row_tags_without.count);
+
     ecs_query *query = (ecs_query *)CFF_ALLOC(sizeof(ecs_query), "QUERY");
 
     if (query == NULL)
     {
+        if (row_tags != NULL)
+            CFF_RELEASE(row_tags);
+        if (row_tags_without != NULL)
+            CFF_RELEASE(row_tags_without);
+        if (sparse != NULL)
+            CFF_RELEASE(sparse);
+        if (sparse_without != NULL)
+            CFF_RELEASE(sparse_without);
+        if (resources != NULL)
+            CFF_RELEASE(resources);
+        if (resources_access != NULL)
+            CFF_RELEASE(resources_access);
+        if (changed != NULL)
+            CFF_RELEASE(changed);
+        CFF_RELEASE(access);
+        CFF_RELEASE(terms);
         CFF_RELEASE(comps);
         return NULL;
     }
 
     query->requiriments = comps;
-    query->requiriments_count = builder_ref->count;
+    query->requiriments_count = builder_ref->requiriments.count;
+    query->terms = terms;
+    query->terms_count = builder_ref->terms.count;
+    query->access = access;
+    query->changed = changed;
+    query->changed_count = changed != NULL ? builder_ref->changed.count : 0;
+    query->resources = resources;
+    query->resources_access = resources_access;
+    query->resources_count = resources != NULL && resources_access != NULL ? builder_ref->resources.count : 0;
+    query->sparse = sparse;
+    query->sparse_count = sparse != NULL ? builder_ref->sparse.count : 0;
+    query->sparse_without = sparse_without;
+    query->sparse_without_count = sparse_without != NULL ? builder_ref->sparse_without.count : 0;
+    query->row_tags = row_tags;
+    query->row_tags_count = row_tags != NULL ? builder_ref->row_tags.count : 0;
+    query->row_tags_without = row_tags_without;
+    query->row_tags_without_count = row_tags_without != NULL ? builder_ref->row_tags_without.count : 0;
+    query->flags = builder_ref->flags;
+
+    cff_bitset_init(&(query->mask));
+    for (uint32_t i = 0; i < query->requiriments_count; i++)
+    {
+        cff_bitset_set(&(query->mask), component_id_index(comps[i]));
+    }
+
+    cff_bitset_init(&(query->without));
+    for (uint32_t i = 0; i < builder_ref->without.count; i++)
+    {
+        cff_bitset_set(&(query->without), component_id_index(builder_ref->without.buffer[i]));
+    }
+
+    query->any_of = NULL;
+    query->any_of_count = builder_ref->any_of_sizes.count;
+    if (query->any_of_count > 0)
+    {
+        query->any_of = (cff_bitset *)CFF_ALLOC(sizeof(cff_bitset) * query->any_of_count, "QUERY ANY OF");
+
+        uint32_t first = 0;
+        for (uint32_t g = 0; g < query->any_of_count; g++)
+        {
+            cff_bitset_init(query->any_of + g);
+
+            uint32_t size = builder_ref->any_of_sizes.buffer[g];
+            for (uint32_t i = first; i < first + size; i++)
+            {
+                cff_bitset_set(query->any_of + g, component_id_index(builder_ref->any_of.buffer[i]));
+            }
+            first += size;
+        }
+    }
 
     return query;
 }
 
-ecs_query *ecs_query_new_from_components(int count, const component_id *const components_ref)
+void ecs_query_builder_release(ecs_query_builder *builder_owning)
 {
-    ecs_query *query = (ecs_query *)CFF_ALLOC(sizeof(ecs_query), "QUERY");
-    query->requiriments = components_ref;
-    query->requiriments_count = count;
-    return query;
+    if (builder_owning == NULL)
+        return;
+
+    term_list_release(&(builder_owning->requiriments));
+    term_list_release(&(builder_owning->terms));
+    access_list_release(&(builder_owning->access));
+    term_list_release(&(builder_owning->without));
+    term_list_release(&(builder_owning->any_of));
+    group_list_release(&(builder_owning->any_of_sizes));
+    term_list_release(&(builder_owning->changed));
+    term_list_release(&(builder_owning->resources));
+    access_list_release(&(builder_owning->resources_access));
+    term_list_release(&(builder_owning->sparse));
+    term_list_release(&(builder_owning->sparse_without));
+    term_list_release(&(builder_owning->row_tags));
+    term_list_release(&(builder_owning->row_tags_without));
+    CFF_RELEASE(builder_owning);
 }
 
 void ecs_query_release(const ecs_query *const query_owning)
 {
+    ecs_query *query = (ecs_query *)query_owning;
+
+    cff_bitset_release(&(query->mask));
+    cff_bitset_release(&(query->without));
+    for (uint32_t g = 0; g < query->any_of_count; g++)
+    {
+        cff_bitset_release(query->any_of + g);
+    }
+    if (query->any_of != NULL)
+        CFF_RELEASE(query->any_of);
+    if (query->changed != NULL)
+        CFF_RELEASE(query->changed);
+    if (query->resources != NULL)
+        CFF_RELEASE(query->resources);
+    if (query->resources_access != NULL)
+        CFF_RELEASE(query->resources_access);
+    if (query->sparse != NULL)
+        CFF_RELEASE(query->sparse);
+    if (query->sparse_without != NULL)
+        CFF_RELEASE(query->sparse_without);
+    if (query->row_tags != NULL)
+        CFF_RELEASE(query->row_tags);
+    if (query->row_tags_without != NULL)
+        CFF_RELEASE(query->row_tags_without);
+
+    CFF_RELEASE(query_owning->access);
+    CFF_RELEASE(query_owning->terms);
     CFF_RELEASE(query_owning->requiriments);
     CFF_RELEASE(query_owning);
 }
 
 void *ecs_iterator_get_component_data(query_it it, component_id component)
 {
-    return ecs_storage_get_component_list(it, component);
+    int column = ecs_storage_get_column_index(it->storage, component);
+    void *data = ecs_storage_get_chunk_column(it->storage, it->chunk, column);
+    if (data == NULL)
+        return NULL;
+    return (void *)((uintptr_t)data + it->offset * ecs_storage_get_column_size(it->storage, column));
+}
+
+void *ecs_iterator_get_column(query_it it, uint32_t term)
+{
+    if (term >= it->column_count)
+        return NULL;
+    return it->columns[term];
 }
 
 entity_id *ecs_iterator_get_ids(query_it it)
 {
-    return ecs_storage_get_enetities_ids(it);
+    entity_id *ids = ecs_storage_get_chunk_ids(it->storage, it->chunk);
+    if (ids == NULL)
+        return NULL;
+    return ids + it->offset;
+}
+
+bool ecs_iterator_is_enabled(query_it it, uint32_t row)
+{
+    return ecs_storage_is_enabled(it->storage, ecs_storage_chunk_first_row(it->storage, it->chunk) + it->offset + row);
+}
+
+bool ecs_iterator_is_component_enabled(query_it it, component_id component, uint32_t row)
+{
+    return ecs_storage_is_component_enabled(it->storage, ecs_storage_chunk_first_row(it->storage, it->chunk) + it->offset + row, component);
+}
+
+uint32_t ecs_iterator_count(query_it it)
+{
+    return it->count;
+}
+
+void *ecs_iterator_get_sparse(query_it it, component_id component, uint32_t row)
+{
+    entity_id *ids = ecs_iterator_get_ids(it);
+    if (ids == NULL || row >= it->count)
+        return NULL;
+    return ecs_sparse_index_get(it->sparse, component, ids[row]);
+}
+
+bool ecs_iterator_has_row_tag(query_it it, component_id tag, uint32_t row)
+{
+    return ecs_storage_has_row_tag(it->storage, ecs_storage_chunk_first_row(it->storage, it->chunk) + it->offset + row, tag);
+}
+
+entity_id ecs_iterator_get_target(query_it it, component_id relation)
+{
+    if (it->pairs == NULL)
+        return INVALID_ID;
+
+    const component_id *components = NULL;
+    uint32_t count = ecs_storage_get_components(it->storage, &components);
+
+    // every row of a storage has the same pairs
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (component_id_is_pair(components[i]) && ecs_pair_index_relation(it->pairs, components[i]) == relation)
+            return ecs_pair_index_target(it->pairs, components[i]);
+    }
+
+    return INVALID_ID;
+}
+
+const void *ecs_iterator_get_shared(query_it it, component_id component)
+{
+    if (it->shared == NULL)
+        return NULL;
+
+    const component_id *components = NULL;
+    uint32_t count = ecs_storage_get_components(it->storage, &components);
+
+    // storages are split by value, the storage holds the tag of a single one
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (component_id_is_shared(components[i]) && ecs_shared_index_component(it->shared, components[i]) == component)
+            return ecs_shared_index_get(it->shared, components[i]);
+    }
+
+    return NULL;
+}
+
+void *ecs_iterator_get_resource(query_it it, uint32_t resource)
+{
+    if (resource >= it->resource_count)
+        return NULL;
+    return it->resources[resource];
+}
+
+bool ecs_iterator_next(ecs_iterator *const it_mut_ref)
+{
+    if (it_mut_ref == NULL || it_mut_ref->next == NULL)
+        return false;
+    return it_mut_ref->next(it_mut_ref);
 }
 
 const component_id *ecs_query_get_components(const ecs_query *const query_ref)
@@ -95,9 +550,121 @@ uint32_t ecs_query_get_count(const ecs_query *const query_ref)
     return query_ref->requiriments_count;
 }
 
+const component_id *ecs_query_get_terms(const ecs_query *const query_ref)
+{
+    return query_ref->terms;
+}
+
+uint32_t ecs_query_get_terms_count(const ecs_query *const query_ref)
+{
+    return query_ref->terms_count;
+}
+
+const ecs_term_access *ecs_query_get_terms_access(const ecs_query *const query_ref)
+{
+    return query_ref->access;
+}
+
+const cff_bitset *ecs_query_get_mask(const ecs_query *const query_ref)
+{
+    return &(query_ref->mask);
+}
+
+bool ecs_query_matches(const ecs_query *const query_ref, const cff_bitset *const archetype_mask)
+{
+    if (!cff_bitset_contains(archetype_mask, &(query_ref->mask)))
+        return false;
+
+    if (cff_bitset_intersects(archetype_mask, &(query_ref->without)))
+        return false;
+
+    for (uint32_t g = 0; g < query_ref->any_of_count; g++)
+    {
+        if (!cff_bitset_intersects(archetype_mask, query_ref->any_of + g))
+            return false;
+    }
+
+    return true;
+}
+
+bool ecs_query_requires(const ecs_query *const query_ref, component_id component)
+{
+    return cff_bitset_test(&(query_ref->mask), component_id_index(component));
+}
+
+const component_id *ecs_query_get_changed(const ecs_query *const query_ref)
+{
+    return query_ref->changed;
+}
+
+uint32_t ecs_query_get_changed_count(const ecs_query *const query_ref)
+{
+    return query_ref->changed_count;
+}
+
+const component_id *ecs_query_get_resources(const ecs_query *const query_ref)
+{
+    return query_ref->resources;
+}
+
+const ecs_term_access *ecs_query_get_resources_access(const ecs_query *const query_ref)
+{
+    return query_ref->resources_access;
+}
+
+uint32_t ecs_query_get_resources_count(const ecs_query *const query_ref)
+{
+    return query_ref->resources_count;
+}
+
+const component_id *ecs_query_get_sparse(const ecs_query *const query_ref)
+{
+    return query_ref->sparse;
+}
+
+uint32_t ecs_query_get_sparse_count(const ecs_query *const query_ref)
+{
+    return query_ref->sparse_count;
+}
+
+const component_id *ecs_query_get_sparse_without(const ecs_query *const query_ref)
+{
+    return query_ref->sparse_without;
+}
+
+uint32_t ecs_query_get_sparse_without_count(const ecs_query *const query_ref)
+{
+    return query_ref->sparse_without_count;
+}
+
+const component_id *ecs_query_get_row_tags(const ecs_query *const query_ref)
+{
+    return query_ref->row_tags;
+}
+
+uint32_t ecs_query_get_row_tags_count(const ecs_query *const query_ref)
+{
+    return query_ref->row_tags_count;
+}
+
+const component_id *ecs_query_get_row_tags_without(const ecs_query *const query_ref)
+{
+    return query_ref->row_tags_without;
+}
+
+uint32_t ecs_query_get_row_tags_without_count(const ecs_query *const query_ref)
+{
+    return query_ref->row_tags_without_count;
+}
+
+ecs_query_flags ecs_query_get_flags(const ecs_query *const query_ref)
+{
+    return query_ref->flags;
+}
+
 void *ecs_iterator_get_component_data_by_name(query_it it, const char *const name)
 {
-    component_id id = ecs_storage_get_component_id(it, name);
+    component_id id = ecs_storage_get_component_id(it->storage, name);
     if (id == INVALID_ID || component_id_is_tag(id))
         return NULL;
     return ecs_iterator_get_component_data(it, id);
@@ -4,16 +4,72 @@
 #include "ecs_types.h"
 
 typedef struct ecs_query_builder ecs_query_builder;
+typedef struct cff_bitset cff_bitset;
 
 CAFF_API ecs_query_builder *ecs_query_builder_new();
 CAFF_API void ecs_query_builder_with_component(ecs_query_builder *const builder_mut_ref, component_id component);
+CAFF_API void ecs_query_builder_with_component_access(ecs_query_builder *const builder_mut_ref, component_id component, ecs_term_access access);
+// optional terms get a NULL column on archetypes without the component
+CAFF_API void ecs_query_builder_optional(ecs_query_builder *const builder_mut_ref, component_id component, ecs_term_access access);
+CAFF_API void ecs_query_builder_without(ecs_query_builder *const builder_mut_ref, component_id component);
+// matches archetypes with at least one of the components, can be called once per group, sparse components and row tags never match
+CAFF_API void ecs_query_builder_any_of(ecs_query_builder *const builder_mut_ref, const component_id *const components, uint32_t count);
+// rows pass only when the component was set, written through a mutable term or added since the query last ran
+CAFF_API void ecs_query_builder_changed(ecs_query_builder *const builder_mut_ref, component_id component);
+// world resource used by the system, it takes no part in matching, the scheduler orders systems writing it
+CAFF_API void ecs_query_builder_resource(ecs_query_builder *const builder_mut_ref, component_id resource, ecs_term_access access);
+CAFF_API void ecs_query_builder_with_flags(ecs_query_builder *const builder_mut_ref, ecs_query_flags flags);
 CAFF_API ecs_query *ecs_query_builder_build(const ecs_query_builder *const builder_ref);
 CAFF_API void ecs_query_builder_release(ecs_query_builder *builder_owning);
 
 const component_id *ecs_query_get_components(const ecs_query *const query_ref);
 uint32_t ecs_query_get_count(const ecs_query *const query_ref);
+const component_id *ecs_query_get_terms(const ecs_query *const query_ref);
+uint32_t ecs_query_get_terms_count(const ecs_query *const query_ref);
+const ecs_term_access *ecs_query_get_terms_access(const ecs_query *const query_ref);
+const cff_bitset *ecs_query_get_mask(const ecs_query *const query_ref);
+bool ecs_query_matches(const ecs_query *const query_ref, const cff_bitset *const archetype_mask);
+// true when the component is one of the required terms
+bool ecs_query_requires(const ecs_query *const query_ref, component_id component);
+const component_id *ecs_query_get_changed(const ecs_query *const query_ref);
+uint32_t ecs_query_get_changed_count(const ecs_query *const query_ref);
+const component_id *ecs_query_get_resources(const ecs_query *const query_ref);
+const ecs_term_access *ecs_query_get_resources_access(const ecs_query *const query_ref);
+uint32_t ecs_query_get_resources_count(const ecs_query *const query_ref);
+// required and excluded sparse components, archetype matching ignores them
+const component_id *ecs_query_get_sparse(const ecs_query *const query_ref);
+uint32_t ecs_query_get_sparse_count(const ecs_query *const query_ref);
+const component_id *ecs_query_get_sparse_without(const ecs_query *const query_ref);
+uint32_t ecs_query_get_sparse_without_count(const ecs_query *const query_ref);
+// required and excluded row tags, archetype matching ignores them too
+const component_id *ecs_query_get_row_tags(const ecs_query *const query_ref);
+uint32_t ecs_query_get_row_tags_count(const ecs_query *const query_ref);
+const component_id *ecs_query_get_row_tags_without(const ecs_query *const query_ref);
+uint32_t ecs_query_get_row_tags_without_count(const ecs_query *const query_ref);
+ecs_query_flags ecs_query_get_flags(const ecs_query *const query_ref);
 void ecs_query_release(const ecs_query *const query_owning);
 
 CAFF_API void *ecs_iterator_get_component_data(query_it it, component_id component);
 CAFF_API void *ecs_iterator_get_component_data_by_name(query_it it, const char *const name);
-CAFF_API entity_id *ecs_iterator_get_ids(query_it it);
\ No newline at end of file
+CAFF_API void *ecs_iterator_get_column(query_it it, uint32_t term);
+CAFF_API entity_id *ecs_iterator_get_ids(query_it it);
+CAFF_API uint32_t ecs_iterator_count(query_it it);
+// resource is the position the resource was given to ecs_query_builder_resource, NULL while it is not set
+CAFF_API void *ecs_iterator_get_resource(query_it it, uint32_t resource);
+// rows of disabled entities and components only reach queries built with ECS_QUERY_INCLUDE_DISABLED or ECS_QUERY_SIMD_ALIGNED
+CAFF_API bool ecs_iterator_is_enabled(query_it it, uint32_t row);
+CAFF_API bool ecs_iterator_is_component_enabled(query_it it, component_id component, uint32_t row);
+// moves a cached query iterator to the next non empty chunk, false once every match was visited
+CAFF_API bool ecs_iterator_next(ecs_iterator *const it_mut_ref);
+
+// value of a sparse component for a row of the iterator, sparse terms have no column
+CAFF_API void *ecs_iterator_get_sparse(query_it it, component_id component, uint32_t row);
+// row tag bit of a row of the iterator, queries built with ECS_QUERY_SIMD_ALIGNED get every row and check their row tags with it
+CAFF_API bool ecs_iterator_has_row_tag(query_it it, component_id tag, uint32_t row);
+// target of the relation pair shared by every row of the iterator, INVALID_ID when the storage has none
+CAFF_API entity_id ecs_iterator_get_target(query_it it, component_id relation);
+// value of a shared component for every row of the iterator, NULL when the storage has none
+CAFF_API const void *ecs_iterator_get_shared(query_it it, component_id component);
+
+// term is the position the component was given to ecs_query_builder_with_component
+#define ecs_iterator_column(IT, TYPE, TERM) ((TYPE *)ecs_iterator_get_column((IT), (TERM)))
\ No newline at end of file
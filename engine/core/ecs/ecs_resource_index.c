@@ -0,0 +1,150 @@
+#include "ecs_resource_index.h"
+#include "../caffeine_memory.h"
+
+typedef struct
+{
+    component_id component;
+    // owned by the index, each resource has its own allocation so its address never changes
+    void *data;
+    size_t size;
+    ecs_type_info hooks;
+} resource_info;
+
+struct resource_index
+{
+    // indexed by component index, component is INVALID_ID on empty slots
+    resource_info *resources;
+    uint32_t capacity;
+};
+
+static resource_info *resource_index_find(const resource_index *index, component_id component);
+static void resource_index_destroy(resource_info *info);
+
+resource_index *ecs_resource_index_new(uint32_t capacity)
+{
+    resource_index *index = (resource_index *)CFF_ALLOC(sizeof(resource_index), "RESOURCE INDEX");
+    if (index == NULL)
+        return NULL;
+
+    capacity = capacity ? capacity : 1;
+    index->resources = (resource_info *)CFF_ALLOC(sizeof(resource_info) * capacity, "RESOURCE INDEX RESOURCES");
+    if (index->resources == NULL)
+    {
+        CFF_RELEASE(index);
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < capacity; i++)
+        index->resources[i] = (resource_info){.component = INVALID_ID};
+    index->capacity = capacity;
+
+    return index;
+}
+
+void ecs_resource_index_release(resource_index *index_owning)
+{
+    for (uint32_t i = 0; i < index_owning->capacity; i++)
+    {
+        if (index_owning->resources[i].component != INVALID_ID)
+            resource_index_destroy(index_owning->resources + i);
+    }
+
+    CFF_RELEASE(index_owning->resources);
+    CFF_RELEASE(index_owning);
+}
+
+void *ecs_resource_index_set(resource_index *const index_mut_ref, component_id component, size_t size, size_t align, const ecs_type_info *const hooks, const void *data)
+{
+    if (component == INVALID_ID || size == 0)
+        return NULL;
+
+    uint32_t slot = component_id_index(component);
+    if (slot >= index_mut_ref->capacity)
+    {
+        uint32_t capacity = index_mut_ref->capacity;
+        while (capacity <= slot)
+            capacity *= 2;
+
+        resource_info *resources = CFF_ARR_RESIZE(index_mut_ref->resources, capacity);
+        if (resources == NULL)
+            return NULL;
+
+        for (uint32_t i = index_mut_ref->capacity; i < capacity; i++)
+            resources[i] = (resource_info){.component = INVALID_ID};
+
+        index_mut_ref->resources = resources;
+        index_mut_ref->capacity = capacity;
+    }
+
+    resource_info *info = index_mut_ref->resources + slot;
+
+    // a recycled component id gets a fresh resource
+    if (info->component != INVALID_ID && info->component != component)
+        resource_index_destroy(info);
+
+    if (info->component == INVALID_ID)
+    {
+        void *storage = CFF_ALIGNED_ALLOC(size, align ? align : 1, "RESOURCE");
+        if (storage == NULL)
+            return NULL;
+
+        *info = (resource_info){
+            .component = component,
+            .data = storage,
+            .size = size,
+            .hooks = hooks != NULL ? *hooks : (ecs_type_info){0},
+        };
+
+        if (info->hooks.ctor != NULL)
+            info->hooks.ctor(storage, 1);
+        else
+            CFF_ZERO(storage, size);
+    }
+
+    if (data != NULL)
+    {
+        if (info->hooks.dtor != NULL)
+            info->hooks.dtor(info->data, 1);
+
+        if (info->hooks.copy != NULL)
+            info->hooks.copy(info->data, data, 1);
+        else
+            CFF_COPY(data, info->data, size);
+    }
+
+    return info->data;
+}
+
+void *ecs_resource_index_get(const resource_index *const index_ref, component_id component)
+{
+    resource_info *info = resource_index_find(index_ref, component);
+    return info != NULL ? info->data : NULL;
+}
+
+void ecs_resource_index_remove(resource_index *const index_mut_ref, component_id component)
+{
+    resource_info *info = resource_index_find(index_mut_ref, component);
+    if (info != NULL)
+        resource_index_destroy(info);
+}
+
+static resource_info *resource_index_find(const resource_index *index, component_id component)
+{
+    if (component == INVALID_ID)
+        return NULL;
+
+    uint32_t slot = component_id_index(component);
+    if (slot >= index->capacity || index->resources[slot].component != component)
+        return NULL;
+
+    return index->resources + slot;
+}
+
+static void resource_index_destroy(resource_info *info)
+{
+    if (info->hooks.dtor != NULL)
+        info->hooks.dtor(info->data, 1);
+
+    CFF_ALIGNED_RELEASE(info->data);
+    *info = (resource_info){.component = INVALID_ID};
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "ecs_types.h"
+
+typedef struct resource_index resource_index;
+
+resource_index *ecs_resource_index_new(uint32_t capacity);
+void ecs_resource_index_release(resource_index *index_owning);
+
+// copies data into the resource of component, creating it on the first call, returns its storage
+void *ecs_resource_index_set(resource_index *const index_mut_ref, component_id component, size_t size, size_t align, const ecs_type_info *const hooks, const void *data);
+// NULL while the resource was never set, the pointer stays valid until the resource is removed
+void *ecs_resource_index_get(const resource_index *const index_ref, component_id component);
+void ecs_resource_index_remove(resource_index *const index_mut_ref, component_id component);
@@ -0,0 +1,185 @@
+#include "ecs_shared_index.h"
+#include "../caffeine_memory.h"
+#include "../ds/caffeine_vector.h"
+#include "../ds/caffeine_sparseset.h"
+
+typedef struct
+{
+    component_id value;
+    component_id component;
+    // compared before the bytes when looking a value up
+    uint64_t hash;
+    // bytes the value was asked for with, the copy hook may give data other bytes
+    void *key;
+    // owned by the index, NULL for shared components without data
+    void *data;
+    size_t size;
+    ecs_type_info hooks;
+    // the component index and the storage name tables point to it
+    char *name;
+} shared_value;
+
+cff_arr_dcltype(shared_value_list, shared_value);
+cff_arr_impl(shared_value_list, shared_value);
+
+struct shared_index
+{
+    shared_value_list values;
+    // position of each value in values by component index, CFF_SPARSE_EMPTY for the other components
+    uint32_t *lookup;
+    uint32_t lookup_capacity;
+};
+
+static const shared_value *shared_index_find_value(const shared_index *index, component_id value);
+static uint64_t shared_index_hash(const void *data, size_t size);
+
+shared_index *ecs_shared_index_new(uint32_t capacity)
+{
+    shared_index *index = (shared_index *)CFF_ALLOC(sizeof(shared_index), "SHARED INDEX");
+    if (index == NULL)
+        return NULL;
+
+    capacity = capacity ? capacity : 1;
+    shared_value_list_init(&(index->values), capacity);
+    index->lookup = (uint32_t *)CFF_ALLOC(sizeof(uint32_t) * capacity, "SHARED INDEX LOOKUP");
+    index->lookup_capacity = capacity;
+
+    for (uint32_t i = 0; i < capacity; i++)
+        index->lookup[i] = CFF_SPARSE_EMPTY;
+
+    return index;
+}
+
+void ecs_shared_index_release(shared_index *index_owning)
+{
+    for (uint32_t i = 0; i < index_owning->values.count; i++)
+    {
+        shared_value *value = shared_value_list_get_ref(&(index_owning->values), i);
+
+        if (value->data != NULL)
+        {
+            if (value->hooks.dtor != NULL)
+                value->hooks.dtor(value->data, 1);
+            CFF_ALIGNED_RELEASE(value->data);
+            CFF_RELEASE(value->key);
+        }
+        CFF_RELEASE(value->name);
+    }
+
+    shared_value_list_release(&(index_owning->values));
+    CFF_RELEASE(index_owning->lookup);
+    CFF_RELEASE(index_owning);
+}
+
+component_id ecs_shared_index_find(const shared_index *const index_ref, component_id component, const void *data, size_t size)
+{
+    uint64_t hash = shared_index_hash(data, size);
+
+    for (uint32_t i = 0; i < index_ref->values.count; i++)
+    {
+        const shared_value *value = index_ref->values.buffer + i;
+        if (value->component != component || value->hash != hash)
+            continue;
+
+        if (size == 0 || CFF_CMP(value->key, data, size))
+            return value->value;
+    }
+
+    return INVALID_ID;
+}
+
+void ecs_shared_index_add(shared_index *const index_mut_ref, component_id component, component_id value, const void *data, size_t size, size_t align, const ecs_type_info *const hooks, char *name_owning)
+{
+    uint32_t slot = component_id_index(value);
+    if (slot >= index_mut_ref->lookup_capacity)
+    {
+        uint32_t capacity = index_mut_ref->lookup_capacity;
+        while (capacity <= slot)
+            capacity *= 2;
+
+        uint32_t *lookup = CFF_ARR_RESIZE(index_mut_ref->lookup, capacity);
+        if (lookup == NULL)
+        {
+            CFF_RELEASE(name_owning);
+            return;
+        }
+
+        for (uint32_t i = index_mut_ref->lookup_capacity; i < capacity; i++)
+            lookup[i] = CFF_SPARSE_EMPTY;
+
+        index_mut_ref->lookup = lookup;
+        index_mut_ref->lookup_capacity = capacity;
+    }
+
+    shared_value entry = {
+        .value = value,
+        .component = component,
+        .hash = shared_index_hash(data, size),
+        .key = NULL,
+        .data = NULL,
+        .size = size,
+        .hooks = hooks != NULL ? *hooks : (ecs_type_info){0},
+        .name = name_owning,
+    };
+
+    if (size > 0)
+    {
+        entry.key = CFF_ALLOC(size, "SHARED VALUE KEY");
+        CFF_COPY(data, entry.key, size);
+
+        entry.data = CFF_ALIGNED_ALLOC(size, align ? align : 1, "SHARED VALUE");
+        if (entry.hooks.copy != NULL)
+            entry.hooks.copy(entry.data, data, 1);
+        else
+            CFF_COPY(data, entry.data, size);
+    }
+
+    uint32_t position = 0;
+    shared_value_list_add_i(&(index_mut_ref->values), entry, &position);
+    index_mut_ref->lookup[slot] = position;
+}
+
+uint32_t ecs_shared_index_count(const shared_index *const index_ref)
+{
+    return index_ref->values.count;
+}
+
+component_id ecs_shared_index_component(const shared_index *const index_ref, component_id value)
+{
+    const shared_value *entry = shared_index_find_value(index_ref, value);
+    return entry != NULL ? entry->component : INVALID_ID;
+}
+
+const void *ecs_shared_index_get(const shared_index *const index_ref, component_id value)
+{
+    const shared_value *entry = shared_index_find_value(index_ref, value);
+    return entry != NULL ? entry->data : NULL;
+}
+
+static const shared_value *shared_index_find_value(const shared_index *index, component_id value)
+{
+    if (value == INVALID_ID || !component_id_is_shared(value))
+        return NULL;
+
+    uint32_t slot = component_id_index(value);
+    if (slot >= index->lookup_capacity || index->lookup[slot] == CFF_SPARSE_EMPTY)
+        return NULL;
+
+    const shared_value *entry = index->values.buffer + index->lookup[slot];
+    return entry->value == value ? entry : NULL;
+}
+
+static uint64_t shared_index_hash(const void *data, size_t size)
+{
+    // fnv-1a, values are small and looked up only when entities are given one
+    const uint8_t *bytes = (const uint8_t *)data;
+    uint64_t hash = 14695981039346656037ull;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+
+    return hash;
+}
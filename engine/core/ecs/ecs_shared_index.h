@@ -0,0 +1,19 @@
+#pragma once
+
+#include "ecs_types.h"
+
+typedef struct shared_index shared_index;
+
+shared_index *ecs_shared_index_new(uint32_t capacity);
+void ecs_shared_index_release(shared_index *index_owning);
+
+// value component holding data for the shared component, values are compared byte by byte, INVALID_ID while data was never added
+component_id ecs_shared_index_find(const shared_index *const index_ref, component_id component, const void *data, size_t size);
+// stores a copy of data as the value, the index keeps name_owning alive until it is released
+void ecs_shared_index_add(shared_index *const index_mut_ref, component_id component, component_id value, const void *data, size_t size, size_t align, const ecs_type_info *const hooks, char *name_owning);
+uint32_t ecs_shared_index_count(const shared_index *const index_ref);
+
+// shared component of a value, INVALID_ID for components that are not values
+component_id ecs_shared_index_component(const shared_index *const index_ref, component_id value);
+// values are stored once and never move until the index is released
+const void *ecs_shared_index_get(const shared_index *const index_ref, component_id value);
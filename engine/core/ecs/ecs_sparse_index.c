@@ -0,0 +1,272 @@
+#include "ecs_sparse_index.h"
+#include "../caffeine_memory.h"
+#include "../ds/caffeine_vector.h"
+#include "../ds/caffeine_sparseset.h"
+
+cff_sparse_dcltype(entity_set, entity_id);
+
+typedef struct
+{
+    component_id component;
+    entity_set entities;
+    // values in the order of entities.dense
+    uint8_t *data;
+    uint32_t data_capacity;
+    size_t size;
+    size_t align;
+    ecs_type_info hooks;
+} sparse_set;
+
+cff_arr_dcltype(sparse_list, sparse_set);
+cff_arr_impl(sparse_list, sparse_set);
+
+struct sparse_index
+{
+    sparse_list sets;
+    // position of each sparse component in sets by component index, CFF_SPARSE_EMPTY for the others
+    uint32_t *lookup;
+    uint32_t lookup_capacity;
+};
+
+static sparse_set *sparse_index_find(const sparse_index *index, component_id component);
+static bool sparse_set_reserve(sparse_set *set, uint32_t capacity);
+static void *sparse_set_value(const sparse_set *set, uint32_t position);
+
+sparse_index *ecs_sparse_index_new(uint32_t capacity)
+{
+    sparse_index *index = (sparse_index *)CFF_ALLOC(sizeof(sparse_index), "SPARSE INDEX");
+    if (index == NULL)
+        return NULL;
+
+    capacity = capacity ? capacity : 1;
+    sparse_list_init(&(index->sets), capacity);
+    index->lookup = (uint32_t *)CFF_ALLOC(sizeof(uint32_t) * capacity, "SPARSE INDEX LOOKUP");
+    index->lookup_capacity = capacity;
+
+    for (uint32_t i = 0; i < capacity; i++)
+        index->lookup[i] = CFF_SPARSE_EMPTY;
+
+    return index;
+}
+
+void ecs_sparse_index_release(sparse_index *index_owning)
+{
+    for (uint32_t i = 0; i < index_owning->sets.count; i++)
+    {
+        sparse_set *set = sparse_list_get_ref(&(index_owning->sets), i);
+
+        if (set->hooks.dtor != NULL && set->entities.count > 0)
+            set->hooks.dtor(set->data, set->entities.count);
+
+        if (set->data != NULL)
+            CFF_ALIGNED_RELEASE(set->data);
+        cff_sparse_release(&(set->entities));
+    }
+
+    sparse_list_release(&(index_owning->sets));
+    CFF_RELEASE(index_owning->lookup);
+    CFF_RELEASE(index_owning);
+}
+
+void ecs_sparse_index_add_component(sparse_index *const index_mut_ref, component_id component, size_t size, size_t align, const ecs_type_info *const hooks)
+{
+    if (component == INVALID_ID || sparse_index_find(index_mut_ref, component) != NULL)
+        return;
+
+    uint32_t slot = component_id_index(component);
+    if (slot >= index_mut_ref->lookup_capacity)
+    {
+        uint32_t capacity = index_mut_ref->lookup_capacity;
+        while (capacity <= slot)
+            capacity *= 2;
+
+        uint32_t *lookup = CFF_ARR_RESIZE(index_mut_ref->lookup, capacity);
+        if (lookup == NULL)
+            return;
+
+        for (uint32_t i = index_mut_ref->lookup_capacity; i < capacity; i++)
+            lookup[i] = CFF_SPARSE_EMPTY;
+
+        index_mut_ref->lookup = lookup;
+        index_mut_ref->lookup_capacity = capacity;
+    }
+
+    sparse_set set = {
+        .component = component,
+        .data = NULL,
+        .data_capacity = 0,
+        .size = size,
+        .align = align ? align : 1,
+        .hooks = hooks != NULL ? *hooks : (ecs_type_info){0},
+    };
+    cff_sparse_init(&(set.entities), 16);
+
+    uint32_t position = 0;
+    sparse_list_add_i(&(index_mut_ref->sets), set, &position);
+    index_mut_ref->lookup[slot] = position;
+}
+
+uint32_t ecs_sparse_index_component_count(const sparse_index *const index_ref)
+{
+    return index_ref->sets.count;
+}
+
+component_id ecs_sparse_index_get_component(const sparse_index *const index_ref, uint32_t position)
+{
+    if (position >= index_ref->sets.count)
+        return INVALID_ID;
+    return index_ref->sets.buffer[position].component;
+}
+
+void *ecs_sparse_index_emplace(sparse_index *const index_mut_ref, component_id component, entity_id entity, bool *added_out)
+{
+    if (added_out != NULL)
+        *added_out = false;
+
+    sparse_set *set = sparse_index_find(index_mut_ref, component);
+    if (set == NULL)
+        return NULL;
+
+    uint32_t key = ecs_entity_index_of(entity);
+    uint32_t position = cff_sparse_index_of(&(set->entities), key);
+
+    if (position != CFF_SPARSE_EMPTY && cff_sparse_get(&(set->entities), position) == entity)
+        return sparse_set_value(set, position);
+
+    // a slot still held by a destroyed generation of the entity is dropped first
+    if (position != CFF_SPARSE_EMPTY)
+        ecs_sparse_index_remove(index_mut_ref, component, cff_sparse_get(&(set->entities), position));
+
+    if (!sparse_set_reserve(set, set->entities.count + 1))
+        return NULL;
+
+    cff_sparse_add(&(set->entities), key, entity, position);
+
+    void *value = sparse_set_value(set, position);
+    if (set->hooks.ctor != NULL)
+        set->hooks.ctor(value, 1);
+    else if (set->size > 0)
+        CFF_ZERO(value, set->size);
+
+    if (added_out != NULL)
+        *added_out = true;
+
+    return value;
+}
+
+bool ecs_sparse_index_remove(sparse_index *const index_mut_ref, component_id component, entity_id entity)
+{
+    sparse_set *set = sparse_index_find(index_mut_ref, component);
+    if (set == NULL)
+        return false;
+
+    uint32_t key = ecs_entity_index_of(entity);
+    uint32_t position = cff_sparse_index_of(&(set->entities), key);
+
+    if (position == CFF_SPARSE_EMPTY || cff_sparse_get(&(set->entities), position) != entity)
+        return false;
+
+    uint32_t last = set->entities.count - 1;
+
+    if (set->size > 0)
+    {
+        void *value = sparse_set_value(set, position);
+        if (set->hooks.dtor != NULL)
+            set->hooks.dtor(value, 1);
+
+        // the values follow the swap the set does on its dense side
+        if (position != last && set->hooks.move != NULL)
+            set->hooks.move(value, sparse_set_value(set, last), 1);
+        else if (position != last)
+            CFF_COPY(sparse_set_value(set, last), value, set->size);
+    }
+
+    cff_sparse_remove(&(set->entities), key, ecs_entity_index_of);
+    return true;
+}
+
+bool ecs_sparse_index_has(const sparse_index *const index_ref, component_id component, entity_id entity)
+{
+    const sparse_set *set = sparse_index_find(index_ref, component);
+    if (set == NULL)
+        return false;
+
+    uint32_t position = cff_sparse_index_of(&(set->entities), ecs_entity_index_of(entity));
+    return position != CFF_SPARSE_EMPTY && cff_sparse_get(&(set->entities), position) == entity;
+}
+
+void *ecs_sparse_index_get(const sparse_index *const index_ref, component_id component, entity_id entity)
+{
+    const sparse_set *set = sparse_index_find(index_ref, component);
+    if (set == NULL || set->size == 0)
+        return NULL;
+
+    uint32_t position = cff_sparse_index_of(&(set->entities), ecs_entity_index_of(entity));
+    if (position == CFF_SPARSE_EMPTY || cff_sparse_get(&(set->entities), position) != entity)
+        return NULL;
+
+    return sparse_set_value(set, position);
+}
+
+void ecs_sparse_index_set(sparse_index *const index_mut_ref, component_id component, entity_id entity, const void *data)
+{
+    const sparse_set *set = sparse_index_find(index_mut_ref, component);
+    void *value = ecs_sparse_index_get(index_mut_ref, component, entity);
+    if (value == NULL || data == NULL)
+        return;
+
+    if (set->hooks.dtor != NULL)
+        set->hooks.dtor(value, 1);
+
+    if (set->hooks.copy != NULL)
+        set->hooks.copy(value, data, 1);
+    else
+        CFF_COPY(data, value, set->size);
+}
+
+static sparse_set *sparse_index_find(const sparse_index *index, component_id component)
+{
+    if (component == INVALID_ID)
+        return NULL;
+
+    uint32_t slot = component_id_index(component);
+    if (slot >= index->lookup_capacity || index->lookup[slot] == CFF_SPARSE_EMPTY)
+        return NULL;
+
+    sparse_set *set = index->sets.buffer + index->lookup[slot];
+    return set->component == component ? set : NULL;
+}
+
+static bool sparse_set_reserve(sparse_set *set, uint32_t capacity)
+{
+    if (set->size == 0 || capacity <= set->data_capacity)
+        return true;
+
+    uint32_t data_capacity = set->data_capacity ? set->data_capacity * 2 : 16;
+    while (data_capacity < capacity)
+        data_capacity *= 2;
+
+    uint8_t *data = (uint8_t *)CFF_ALIGNED_ALLOC(set->size * data_capacity, set->align, "SPARSE SET DATA");
+    if (data == NULL)
+        return false;
+
+    if (set->data != NULL)
+    {
+        if (set->hooks.move != NULL)
+            set->hooks.move(data, set->data, set->entities.count);
+        else
+            CFF_COPY(set->data, data, set->size * set->entities.count);
+        CFF_ALIGNED_RELEASE(set->data);
+    }
+
+    set->data = data;
+    set->data_capacity = data_capacity;
+    return true;
+}
+
+static void *sparse_set_value(const sparse_set *set, uint32_t position)
+{
+    if (set->size == 0)
+        return NULL;
+    return set->data + set->size * position;
+}
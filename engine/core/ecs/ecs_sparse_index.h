@@ -0,0 +1,21 @@
+#pragma once
+
+#include "ecs_types.h"
+
+typedef struct sparse_index sparse_index;
+
+sparse_index *ecs_sparse_index_new(uint32_t capacity);
+void ecs_sparse_index_release(sparse_index *index_owning);
+
+// creates the set of a sparse component, entities are keyed by their index
+void ecs_sparse_index_add_component(sparse_index *const index_mut_ref, component_id component, size_t size, size_t align, const ecs_type_info *const hooks);
+uint32_t ecs_sparse_index_component_count(const sparse_index *const index_ref);
+component_id ecs_sparse_index_get_component(const sparse_index *const index_ref, uint32_t position);
+
+// adds the component to the entity constructing it, added_out is false when the entity already had it
+void *ecs_sparse_index_emplace(sparse_index *const index_mut_ref, component_id component, entity_id entity, bool *added_out);
+bool ecs_sparse_index_remove(sparse_index *const index_mut_ref, component_id component, entity_id entity);
+bool ecs_sparse_index_has(const sparse_index *const index_ref, component_id component, entity_id entity);
+void *ecs_sparse_index_get(const sparse_index *const index_ref, component_id component, entity_id entity);
+// replaces the value of an entity that has the component, with the copy hook when there is one
+void ecs_sparse_index_set(sparse_index *const index_mut_ref, component_id component, entity_id entity, const void *data);
@@ -3,43 +3,99 @@
 
 #include "ecs_storage_type.h"
 
+cff_arr_impl(storage_edge_list, ecs_storage_edge);
+cff_arr_impl(row_tag_list, ecs_row_tag);
+
 static int _storage_get_component_index(const ecs_storage *const storage, component_id id);
 static void _storage_resize(ecs_storage *const storage, uint32_t capacity);
+static size_t _storage_slab_layout(const ecs_storage *const storage, uint32_t capacity, size_t *offsets_out);
+static void _storage_pack(ecs_storage *const storage, uint32_t capacity);
+static void _storage_setup_chunks(ecs_storage *const storage);
+static void _storage_add_chunk(ecs_storage *const storage);
+static void *_storage_get_data(const ecs_storage *const storage, uint32_t column, uint32_t row);
+static entity_id *_storage_get_entity_ref(const ecs_storage *const storage, uint32_t row);
+static size_t _storage_align_up(size_t value, size_t align);
+static size_t _storage_column_align(const ecs_storage *const storage, uint32_t column);
+static void _storage_set_disabled(ecs_storage *const storage, cff_bitset *set, uint32_t row, bool disabled);
+static void _storage_swap_disabled(ecs_storage *const storage, uint32_t row, uint32_t last_row);
+static uint64_t _storage_disabled_word(const ecs_storage *const storage, const int32_t *slots, uint32_t slot_count, uint32_t word);
+static void _storage_set_slot_disabled(ecs_storage *const storage, int slot, uint32_t row, bool disabled);
+static const int32_t *_storage_get_edge(ecs_storage *const from, const ecs_storage *const to);
+static void _storage_copy_disabled(const ecs_storage *const from, ecs_storage *const to, const int32_t *slots, uint32_t from_row, uint32_t to_row);
+static ecs_row_tag *_storage_find_row_tag(const ecs_storage *const storage, component_id tag);
+static bool _storage_set_row_tag_bit(ecs_storage *const storage, ecs_row_tag *row_tag, uint32_t row, bool set);
+static void _storage_swap_row_tags(ecs_storage *const storage, uint32_t row, uint32_t last_row);
+static void _storage_copy_row_tags(const ecs_storage *const from, ecs_storage *const to, uint32_t from_row, uint32_t to_row);
+static uint64_t _storage_tagged_word(const ecs_storage *const storage, const component_id *with, uint32_t with_count, const component_id *without, uint32_t without_count, uint32_t word);
+static uint32_t _storage_tick(const ecs_storage *const storage);
+static uint32_t _storage_chunk_of(const ecs_storage *const storage, uint32_t row);
+static void _storage_stamp_rows(ecs_storage *const storage, uint32_t row, uint32_t count);
+static bool _storage_row_changed(const ecs_storage *const storage, const int32_t *slots, uint32_t slot_count, uint32_t since, uint32_t row);
+static uint32_t _storage_push_entity(ecs_storage *const storage, entity_id entity);
+static entity_id _storage_remove_row(ecs_storage *const storage, int row, bool destroy);
+static uint32_t _storage_contiguous_rows(const ecs_storage *const storage, uint32_t row, uint32_t count);
+static void _storage_column_ctor(ecs_storage *const storage, uint32_t column, uint32_t row, uint32_t count);
+static void _storage_column_dtor(ecs_storage *const storage, uint32_t column, uint32_t row, uint32_t count);
+static void _storage_construct(ecs_storage *const storage, uint32_t row, uint32_t count);
+static void _storage_construct_missing(ecs_storage *const to, const int32_t *slots, uint32_t slot_count, uint32_t row, uint32_t count);
+static void _storage_relocate(const ecs_storage *const from, uint32_t column, uint32_t from_row, ecs_storage *const to, uint32_t to_column, uint32_t to_row);
 
-ecs_storage ecs_storage_new(const component_id *const components_owning, const size_t *const component_sizes_owning, const char **const names_owning, uint32_t components_count)
+ecs_storage ecs_storage_new(archetype_id archetype, const component_id *const components_owning, const size_t *const component_sizes_owning, const size_t *const component_aligns_owning, const char **const names_owning, uint32_t components_count, ecs_storage_layout layout)
 {
 
     ecs_storage storage = (ecs_storage){
+        .archetype = archetype,
         .component_sizes = (const size_t *)component_sizes_owning,
+        .component_aligns = (const size_t *)component_aligns_owning,
         .components = (const component_id *)components_owning,
+        .layout = layout,
+        .alignment = ECS_SIMD_ALIGNMENT,
     };
 
     storage.component_count = components_count;
 
-    storage.entity_capacity = 4;
-    storage.entities = (entity_id *)CFF_ALLOC(sizeof(entity_id) * storage.entity_capacity, "STORAGE");
-    storage.entity_data = (void **)CFF_ALLOC(sizeof(void *) * components_count, "STORAGE COMPONENTS");
+    for (uint32_t i = 0; i < components_count; i++)
+    {
+        size_t column_align = _storage_column_align(&storage, i);
+        if (column_align > storage.alignment)
+            storage.alignment = column_align;
+    }
 
     name_index *ni = &(storage.component_name_table);
     ecs_name_index_init(ni);
 
+    for (size_t i = 0; i < components_count; i++)
+    {
+        ecs_name_index_add(ni, names_owning[i], components_owning[i]);
+    }
+
+    CFF_RELEASE(names_owning);
+
+    if (layout == ECS_STORAGE_CHUNKED)
+    {
+        _storage_setup_chunks(&storage);
+        return storage;
+    }
+
+    storage.entity_capacity = 4;
+    storage.entities = (entity_id *)CFF_ALLOC(sizeof(entity_id) * storage.entity_capacity, "STORAGE");
+    storage.entity_data = (void **)CFF_ALLOC(sizeof(void *) * components_count, "STORAGE COMPONENTS");
+
     for (size_t i = 0; i < components_count; i++)
     {
         size_t component_size = component_sizes_owning[i];
         if (component_size > 0)
         {
-            void *buffer = CFF_ALLOC((uint64_t)(component_size * storage.entity_capacity), "STORAGE COMPONENTS ARRAY");
+            size_t buffer_size = _storage_align_up(component_size * storage.entity_capacity, ECS_SIMD_ALIGNMENT);
+            void *buffer = CFF_ALIGNED_ALLOC((uint64_t)buffer_size, _storage_column_align(&storage, i), "STORAGE COMPONENTS ARRAY");
             storage.entity_data[i] = buffer;
         }
         else
         {
             storage.entity_data[i] = NULL;
         }
-        ecs_name_index_add(ni, names_owning[i], components_owning[i]);
     }
 
-    CFF_RELEASE(names_owning);
-
     storage.entity_count = 0;
     return storage;
 }
@@ -49,67 +105,279 @@ void ecs_storage_release(const ecs_storage *const storage_owning)
     if (storage_owning == NULL)
         return;
 
+    ecs_storage *storage_mut_ref = (ecs_storage *)storage_owning;
+
+    // live rows are destroyed before their memory goes away
+    if (storage_mut_ref->hooks != NULL)
+    {
+        for (uint32_t i = 0; i < storage_mut_ref->component_count; i++)
+            _storage_column_dtor(storage_mut_ref, i, 0, storage_mut_ref->entity_count);
+        CFF_RELEASE(storage_mut_ref->hooks);
+    }
+
     const name_index *ni = &(storage_owning->component_name_table);
     ecs_name_index_release(ni);
 
-    for (size_t i = 0; i < storage_owning->component_count; i++)
+    if (storage_owning->layout == ECS_STORAGE_CHUNKED)
+    {
+        for (size_t i = 0; i < storage_owning->chunk_count; i++)
+        {
+            CFF_ALIGNED_RELEASE(storage_owning->chunks[i]);
+        }
+
+        CFF_RELEASE(storage_owning->chunks);
+        CFF_RELEASE(storage_owning->chunk_offsets);
+    }
+    else if (storage_owning->slab != NULL)
+    {
+        CFF_ALIGNED_RELEASE(storage_owning->slab);
+        CFF_RELEASE(storage_owning->entity_data);
+    }
+    else
+    {
+        for (size_t i = 0; i < storage_owning->component_count; i++)
+        {
+            void *buffer = storage_owning->entity_data[i];
+            if (buffer != NULL)
+            {
+                CFF_ALIGNED_RELEASE(buffer);
+            }
+        }
+
+        CFF_RELEASE(storage_owning->entity_data);
+        CFF_RELEASE(storage_owning->entities);
+    }
+
+    for (uint32_t i = 0; i < storage_mut_ref->edges.count; i++)
+    {
+        CFF_RELEASE(storage_mut_ref->edges.buffer[i].slots);
+    }
+    if (storage_mut_ref->edges.buffer != NULL)
+        storage_edge_list_release(&(storage_mut_ref->edges));
+
+    if (storage_mut_ref->changes != NULL)
+    {
+        for (uint32_t i = 0; i < storage_mut_ref->component_count; i++)
+        {
+            if (storage_mut_ref->changes[i].rows != NULL)
+            {
+                CFF_RELEASE(storage_mut_ref->changes[i].rows);
+                CFF_RELEASE(storage_mut_ref->changes[i].chunks);
+            }
+        }
+        CFF_RELEASE(storage_mut_ref->changes);
+    }
+
+    for (uint32_t i = 0; i < storage_mut_ref->row_tags.count; i++)
     {
-        void *buffer = storage_owning->entity_data[i];
-        if (buffer != NULL)
+        cff_bitset_release(&(storage_mut_ref->row_tags.buffer[i].rows));
+    }
+    if (storage_mut_ref->row_tags.buffer != NULL)
+        row_tag_list_release(&(storage_mut_ref->row_tags));
+
+    cff_bitset_release(&(storage_mut_ref->disabled_rows));
+    if (storage_mut_ref->disabled_components != NULL)
+    {
+        for (uint32_t i = 0; i < storage_mut_ref->component_count; i++)
         {
-            CFF_RELEASE(buffer);
+            cff_bitset_release(storage_mut_ref->disabled_components + i);
         }
+        CFF_RELEASE(storage_mut_ref->disabled_components);
     }
 
-    CFF_RELEASE(storage_owning->entity_data);
-    CFF_RELEASE(storage_owning->entities);
     CFF_RELEASE(storage_owning->component_sizes);
+    CFF_RELEASE(storage_owning->component_aligns);
     CFF_RELEASE(storage_owning->components);
 }
 
+void ecs_storage_set_hooks(ecs_storage *const storage_mut_ref, int slot, const ecs_type_info *const hooks)
+{
+    if (slot < 0 || (uint32_t)slot >= storage_mut_ref->component_count || hooks == NULL)
+        return;
+
+    if (storage_mut_ref->hooks == NULL)
+    {
+        size_t size = sizeof(ecs_type_info) * storage_mut_ref->component_count;
+        storage_mut_ref->hooks = (ecs_type_info *)CFF_ALLOC(size, "STORAGE HOOKS");
+        CFF_ZERO(storage_mut_ref->hooks, size);
+    }
+
+    storage_mut_ref->hooks[slot] = *hooks;
+}
+
 int ecs_storage_add_entity(ecs_storage *const storage_mut_ref, entity_id entity)
+{
+    uint32_t row = _storage_push_entity(storage_mut_ref, entity);
+
+    if (storage_mut_ref->hooks != NULL)
+        _storage_construct(storage_mut_ref, row, 1);
+
+    return row;
+}
+
+static uint32_t _storage_push_entity(ecs_storage *const storage_mut_ref, entity_id entity)
 {
     if (storage_mut_ref->entity_count == storage_mut_ref->entity_capacity)
-        _storage_resize(storage_mut_ref, storage_mut_ref->entity_capacity * 2);
+    {
+        if (storage_mut_ref->layout == ECS_STORAGE_CHUNKED)
+            _storage_add_chunk(storage_mut_ref);
+        else
+            _storage_resize(storage_mut_ref, storage_mut_ref->entity_capacity * 2);
+    }
 
     uint32_t row = storage_mut_ref->entity_count;
 
-    storage_mut_ref->entities[row] = entity;
+    *_storage_get_entity_ref(storage_mut_ref, row) = entity;
 
     storage_mut_ref->entity_count++;
 
+    // a row added to the storage is a change for the queries watching it
+    if (storage_mut_ref->changes != NULL)
+        _storage_stamp_rows(storage_mut_ref, row, 1);
+
     return row;
 }
 
+int ecs_storage_add_entities(ecs_storage *const storage_mut_ref, const entity_id *const entities, uint32_t count)
+{
+    uint32_t first_row = storage_mut_ref->entity_count;
+
+    ecs_storage_reserve(storage_mut_ref, first_row + count);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        *_storage_get_entity_ref(storage_mut_ref, first_row + i) = entities[i];
+    }
+
+    storage_mut_ref->entity_count += count;
+
+    if (storage_mut_ref->changes != NULL)
+        _storage_stamp_rows(storage_mut_ref, first_row, count);
+
+    if (storage_mut_ref->hooks != NULL)
+        _storage_construct(storage_mut_ref, first_row, count);
+
+    return (int)first_row;
+}
+
+void ecs_storage_reserve(ecs_storage *const storage_mut_ref, uint32_t capacity)
+{
+    if (capacity <= storage_mut_ref->entity_capacity)
+        return;
+
+    if (storage_mut_ref->layout == ECS_STORAGE_CHUNKED)
+    {
+        while (storage_mut_ref->entity_capacity < capacity)
+            _storage_add_chunk(storage_mut_ref);
+        return;
+    }
+
+    uint32_t new_capacity = storage_mut_ref->entity_capacity;
+    while (new_capacity < capacity)
+        new_capacity *= 2;
+
+    _storage_resize(storage_mut_ref, new_capacity);
+}
+
+bool ecs_storage_compact(ecs_storage *const storage_mut_ref)
+{
+    if (storage_mut_ref->layout == ECS_STORAGE_CHUNKED)
+    {
+        // rows are kept packed by the swap removal, the chunks past the last row are empty
+        uint32_t used = (storage_mut_ref->entity_count + storage_mut_ref->chunk_capacity - 1) / storage_mut_ref->chunk_capacity;
+        if (used == storage_mut_ref->chunk_count)
+            return false;
+
+        for (uint32_t i = used; i < storage_mut_ref->chunk_count; i++)
+            CFF_ALIGNED_RELEASE(storage_mut_ref->chunks[i]);
+
+        storage_mut_ref->chunk_count = used;
+        storage_mut_ref->entity_capacity = used * storage_mut_ref->chunk_capacity;
+        return true;
+    }
+
+    // keep half of the new capacity free, a storage shrunk to its rows would grow again on the next add
+    uint32_t capacity = 4;
+    while (capacity < storage_mut_ref->entity_count * 2)
+        capacity *= 2;
+    if (capacity > storage_mut_ref->entity_capacity)
+        capacity = storage_mut_ref->entity_capacity;
+
+    if (_storage_slab_layout(storage_mut_ref, capacity, NULL) <= ECS_CHUNK_SIZE)
+    {
+        if (storage_mut_ref->slab != NULL && capacity >= storage_mut_ref->entity_capacity)
+            return false;
+
+        _storage_pack(storage_mut_ref, capacity);
+        return true;
+    }
+
+    if (capacity * 2 > storage_mut_ref->entity_capacity)
+        return false;
+
+    _storage_resize(storage_mut_ref, capacity);
+    return true;
+}
+
 entity_id ecs_storage_remove_entity(ecs_storage *const storage_mut_ref, int row)
+{
+    return _storage_remove_row(storage_mut_ref, row, true);
+}
+
+static entity_id _storage_remove_row(ecs_storage *const storage_mut_ref, int row, bool destroy)
 {
     if (storage_mut_ref->entity_count == 0)
         return INVALID_ID;
 
+    // rows moved to another storage were relocated, only dropped rows are destroyed
+    if (destroy && storage_mut_ref->hooks != NULL)
+    {
+        for (uint32_t i = 0; i < storage_mut_ref->component_count; i++)
+            _storage_column_dtor(storage_mut_ref, i, row, 1);
+    }
+
     int last_entity = storage_mut_ref->entity_count - 1;
 
+    // rows past the end must read as enabled when they are reused
+    if (storage_mut_ref->disabled_count > 0)
+        _storage_swap_disabled(storage_mut_ref, row, last_entity);
+
+    if (storage_mut_ref->row_tag_count > 0)
+        _storage_swap_row_tags(storage_mut_ref, row, last_entity);
+
     if (last_entity == row)
     {
         storage_mut_ref->entity_count--;
         return INVALID_ID;
     }
 
-    storage_mut_ref->entities[row] = storage_mut_ref->entities[last_entity];
-    storage_mut_ref->entities[last_entity] = INVALID_ID;
+    entity_id *last_entity_ref = _storage_get_entity_ref(storage_mut_ref, last_entity);
+    entity_id moved_entity = *last_entity_ref;
+    *_storage_get_entity_ref(storage_mut_ref, row) = moved_entity;
+    *last_entity_ref = INVALID_ID;
 
     for (size_t i = 0; i < storage_mut_ref->component_count; i++)
     {
-        size_t component_size = storage_mut_ref->component_sizes[i];
-        if (component_size > 0)
-        {
-            void *from = (void *)((uintptr_t)storage_mut_ref->entity_data[i] + (uintptr_t)(component_size * last_entity));
-            void *to = (void *)((uintptr_t)storage_mut_ref->entity_data[i] + (uintptr_t)(component_size * row));
-            CFF_COPY(from, to, component_size);
-        }
+        if (storage_mut_ref->component_sizes[i] > 0)
+            _storage_relocate(storage_mut_ref, i, last_entity, storage_mut_ref, i, row);
+    }
+
+    for (uint32_t i = 0; i < storage_mut_ref->component_count && storage_mut_ref->changes != NULL; i++)
+    {
+        ecs_change_ticks *ticks = storage_mut_ref->changes + i;
+        if (ticks->rows == NULL)
+            continue;
+
+        // the moved row keeps its tick, the chunk it lands in must not lose it
+        uint32_t tick = (uint32_t)last_entity < ticks->row_capacity ? ticks->rows[last_entity] : 0;
+        if (tick > 0)
+            ecs_storage_mark_changed(storage_mut_ref, i, row, 1, tick);
+        else if ((uint32_t)row < ticks->row_capacity)
+            ticks->rows[row] = 0;
     }
 
     storage_mut_ref->entity_count--;
-    return storage_mut_ref->entities[row];
+    return moved_entity;
 }
 
 void ecs_storage_set_component(ecs_storage *const storage_mut_ref, int row, component_id component, const void *const data)
@@ -122,9 +390,69 @@ void ecs_storage_set_component(ecs_storage *const storage_mut_ref, int row, comp
     if (component_index != -1)
     {
         size_t component_size = storage_mut_ref->component_sizes[component_index];
-        void *to = (void *)((uintptr_t)storage_mut_ref->entity_data[component_index] + (uintptr_t)(component_size * row));
-        CFF_COPY(data, to, component_size);
+        void *to = _storage_get_data(storage_mut_ref, component_index, row);
+        const ecs_type_info *hooks = storage_mut_ref->hooks != NULL ? storage_mut_ref->hooks + component_index : NULL;
+
+        // the previous value is released, the new one is a copy of data
+        if (hooks != NULL && hooks->dtor != NULL)
+            hooks->dtor(to, 1);
+
+        if (hooks != NULL && hooks->copy != NULL)
+            hooks->copy(to, data, 1);
+        else
+            CFF_COPY(data, to, component_size);
+
+        if (storage_mut_ref->changes != NULL)
+            ecs_storage_mark_changed(storage_mut_ref, component_index, row, 1, _storage_tick(storage_mut_ref));
+    }
+}
+
+void ecs_storage_fill_component(ecs_storage *const storage_mut_ref, int first_row, uint32_t count, component_id component, const void *const data)
+{
+    int component_index = ecs_storage_get_column_index(storage_mut_ref, component);
+    if (component_index == -1 || count == 0)
+        return;
+
+    size_t component_size = storage_mut_ref->component_sizes[component_index];
+    const ecs_type_info *hooks = storage_mut_ref->hooks != NULL ? storage_mut_ref->hooks + component_index : NULL;
+    uint32_t row = (uint32_t)first_row;
+    uint32_t end = row + count;
+
+    _storage_column_dtor(storage_mut_ref, component_index, row, count);
+
+    while (row < end)
+    {
+        // rows are contiguous up to the end of the chunk
+        uint32_t segment = end - row;
+        if (storage_mut_ref->layout == ECS_STORAGE_CHUNKED)
+        {
+            uint32_t chunk_left = storage_mut_ref->chunk_capacity - (row % storage_mut_ref->chunk_capacity);
+            segment = segment < chunk_left ? segment : chunk_left;
+        }
+
+        uint8_t *to = (uint8_t *)_storage_get_data(storage_mut_ref, component_index, row);
+        if (hooks != NULL && hooks->copy != NULL)
+            hooks->copy(to, data, 1);
+        else
+            CFF_COPY(data, to, component_size);
+
+        // double the filled prefix on each copy instead of copying the value row by row
+        uint32_t filled = 1;
+        while (filled < segment)
+        {
+            uint32_t copy = filled < segment - filled ? filled : segment - filled;
+            if (hooks != NULL && hooks->copy != NULL)
+                hooks->copy(to + filled * component_size, to, copy);
+            else
+                CFF_COPY(to, to + filled * component_size, copy * component_size);
+            filled += copy;
+        }
+
+        row += segment;
     }
+
+    if (storage_mut_ref->changes != NULL)
+        ecs_storage_mark_changed(storage_mut_ref, component_index, first_row, count, _storage_tick(storage_mut_ref));
 }
 
 void *ecs_storage_get_component(const ecs_storage *const storage_ref, int row, component_id component)
@@ -136,25 +464,90 @@ void *ecs_storage_get_component(const ecs_storage *const storage_ref, int row, c
     int component_index = _storage_get_component_index(storage_ref, component);
     if (component_index != -1)
     {
-        size_t component_size = storage_ref->component_sizes[component_index];
-        void *data = (void *)((uintptr_t)storage_ref->entity_data[component_index] + (uintptr_t)(component_size * row));
-        return data;
+        return _storage_get_data(storage_ref, component_index, row);
     }
     return NULL;
 }
 
-void *ecs_storage_get_component_list(const ecs_storage *const storage_ref, component_id component)
+int ecs_storage_get_column_index(const ecs_storage *const storage_ref, component_id component)
 {
     if (component_id_is_tag(component))
+    {
+        return -1;
+    }
+    return _storage_get_component_index(storage_ref, component);
+}
+
+uint32_t ecs_storage_chunk_count(const ecs_storage *const storage_ref)
+{
+    if (storage_ref == NULL || storage_ref->entity_count == 0)
+        return 0;
+
+    if (storage_ref->layout == ECS_STORAGE_CHUNKED)
+        return (storage_ref->entity_count + storage_ref->chunk_capacity - 1) / storage_ref->chunk_capacity;
+
+    // a linear storage is a single chunk holding every row
+    return 1;
+}
+
+uint32_t ecs_storage_chunk_rows(const ecs_storage *const storage_ref, uint32_t chunk)
+{
+    if (storage_ref->layout != ECS_STORAGE_CHUNKED)
+        return storage_ref->entity_count;
+
+    uint32_t first_row = chunk * storage_ref->chunk_capacity;
+    if (first_row >= storage_ref->entity_count)
+        return 0;
+
+    uint32_t rows = storage_ref->entity_count - first_row;
+    return rows > storage_ref->chunk_capacity ? storage_ref->chunk_capacity : rows;
+}
+
+uint32_t ecs_storage_chunk_first_row(const ecs_storage *const storage_ref, uint32_t chunk)
+{
+    if (storage_ref->layout != ECS_STORAGE_CHUNKED)
+        return 0;
+    return chunk * storage_ref->chunk_capacity;
+}
+
+void *ecs_storage_get_chunk_column(const ecs_storage *const storage_ref, uint32_t chunk, int column)
+{
+    if (column < 0 || storage_ref->component_sizes[column] == 0)
     {
         return NULL;
     }
-    int component_index = _storage_get_component_index(storage_ref, component);
-    if (component_index != -1)
+
+    if (storage_ref->layout == ECS_STORAGE_CHUNKED)
     {
-        return storage_ref->entity_data[component_index];
+        return (void *)((uintptr_t)storage_ref->chunks[chunk] + (uintptr_t)storage_ref->chunk_offsets[column]);
     }
-    return NULL;
+
+    return storage_ref->entity_data[column];
+}
+
+size_t ecs_storage_get_column_size(const ecs_storage *const storage_ref, int column)
+{
+    if (column < 0)
+    {
+        return 0;
+    }
+
+    return storage_ref->component_sizes[column];
+}
+
+entity_id *ecs_storage_get_chunk_ids(const ecs_storage *const storage_ref, uint32_t chunk)
+{
+    if (storage_ref == NULL)
+    {
+        return NULL;
+    }
+
+    if (storage_ref->layout == ECS_STORAGE_CHUNKED)
+    {
+        return (entity_id *)storage_ref->chunks[chunk];
+    }
+
+    return storage_ref->entities;
 }
 
 component_id ecs_storage_get_component_id(const ecs_storage *const storage_ref, const char *const name)
@@ -165,74 +558,910 @@ component_id ecs_storage_get_component_id(const ecs_storage *const storage_ref,
     return id;
 }
 
-entity_id *ecs_storage_get_enetities_ids(const ecs_storage *const storage_ref)
+uint32_t ecs_storage_count(const ecs_storage *const storage_ref)
 {
     if (storage_ref != NULL)
-    {
-        return storage_ref->entities;
-    }
-    return NULL;
+        return storage_ref->entity_count;
+    return 0;
 }
 
-uint32_t ecs_storage_count(const ecs_storage *const storage_ref)
+size_t ecs_storage_get_alignment(const ecs_storage *const storage_ref)
 {
     if (storage_ref != NULL)
-        return storage_ref->entity_count;
+        return storage_ref->alignment;
     return 0;
 }
 
-int ecs_storage_move_entity(ecs_storage *const from_storage_ref, ecs_storage *const to_storage_mut_ref, entity_id id, int entity_row)
+uint32_t ecs_storage_get_components(const ecs_storage *const storage_ref, const component_id **components_out)
 {
-    int new_entity_row = ecs_storage_add_entity(to_storage_mut_ref, id);
-    uint32_t component_count = from_storage_ref->component_count;
-    const component_id *components = from_storage_ref->components;
+    if (storage_ref == NULL)
+        return 0;
 
-    if (component_count > to_storage_mut_ref->component_count)
-    {
-        component_count = to_storage_mut_ref->component_count;
-        components = to_storage_mut_ref->components;
-    }
+    *components_out = storage_ref->components;
+    return storage_ref->component_count;
+}
 
-    for (size_t i = 0; i < component_count; i++)
+int ecs_storage_move_entity(ecs_storage *const from_storage_ref, ecs_storage *const to_storage_mut_ref, entity_id id, int entity_row, entity_id *const moved_entity_out)
+{
+    const int32_t *slots = _storage_get_edge(from_storage_ref, to_storage_mut_ref);
+    int new_entity_row = (int)_storage_push_entity(to_storage_mut_ref, id);
+
+    for (uint32_t i = 0; i < from_storage_ref->component_count; i++)
     {
-        if (component_id_is_tag(components[i]))
+        if (from_storage_ref->component_sizes[i] == 0)
             continue;
 
-        void *component_data = ecs_storage_get_component(from_storage_ref, entity_row, components[i]);
-
-        if (component_data != NULL)
-        {
-            ecs_storage_set_component(to_storage_mut_ref, new_entity_row, components[i], component_data);
-        }
+        // components left behind are destroyed, the others change storage as they are
+        if (slots[i] < 0)
+            _storage_column_dtor(from_storage_ref, i, entity_row, 1);
+        else
+            _storage_relocate(from_storage_ref, i, entity_row, to_storage_mut_ref, slots[i], new_entity_row);
     }
 
-    ecs_storage_remove_entity(from_storage_ref, entity_row);
+    if (to_storage_mut_ref->hooks != NULL)
+        _storage_construct_missing(to_storage_mut_ref, slots, from_storage_ref->component_count, new_entity_row, 1);
+
+    // the entity keeps its enabled state for the components both storages have
+    if (from_storage_ref->disabled_count > 0)
+        _storage_copy_disabled(from_storage_ref, to_storage_mut_ref, slots, entity_row, new_entity_row);
+
+    // row tags are not part of the archetype, the entity takes every one of them along
+    if (from_storage_ref->row_tag_count > 0)
+        _storage_copy_row_tags(from_storage_ref, to_storage_mut_ref, entity_row, new_entity_row);
+
+    entity_id moved_entity = _storage_remove_row(from_storage_ref, entity_row, false);
+    if (moved_entity_out != NULL)
+        *moved_entity_out = moved_entity;
     return new_entity_row;
 }
 
-// OPTIMIZE
-static int _storage_get_component_index(const ecs_storage *const storage_ref, component_id id)
+int ecs_storage_move_entities(ecs_storage *const from_storage_ref, ecs_storage *const to_storage_mut_ref, const int *const rows, uint32_t count, entity_id *const moved_entities_out)
 {
-    for (size_t i = 0; i < storage_ref->component_count; i++)
+    const int32_t *slots = _storage_get_edge(from_storage_ref, to_storage_mut_ref);
+    uint32_t first_row = to_storage_mut_ref->entity_count;
+
+    ecs_storage_reserve(to_storage_mut_ref, first_row + count);
+
+    for (uint32_t r = 0; r < count; r++)
     {
-        if (storage_ref->components[i] == id)
-            return i;
+        *_storage_get_entity_ref(to_storage_mut_ref, first_row + r) = *_storage_get_entity_ref(from_storage_ref, rows[r]);
     }
-    return -1;
+    to_storage_mut_ref->entity_count += count;
+
+    if (to_storage_mut_ref->changes != NULL)
+        _storage_stamp_rows(to_storage_mut_ref, first_row, count);
+
+    // column by column, every destination column is filled front to back
+    for (uint32_t i = 0; i < from_storage_ref->component_count; i++)
+    {
+        size_t component_size = from_storage_ref->component_sizes[i];
+        if (component_size == 0)
+            continue;
+
+        for (uint32_t r = 0; r < count && slots[i] < 0; r++)
+            _storage_column_dtor(from_storage_ref, i, rows[r], 1);
+
+        for (uint32_t r = 0; r < count && slots[i] >= 0; r++)
+            _storage_relocate(from_storage_ref, i, rows[r], to_storage_mut_ref, slots[i], first_row + r);
+    }
+
+    // the destination rows are contiguous, new components are constructed a range at a time
+    if (to_storage_mut_ref->hooks != NULL)
+        _storage_construct_missing(to_storage_mut_ref, slots, from_storage_ref->component_count, first_row, count);
+
+    if (from_storage_ref->disabled_count > 0)
+    {
+        for (uint32_t r = 0; r < count; r++)
+            _storage_copy_disabled(from_storage_ref, to_storage_mut_ref, slots, rows[r], first_row + r);
+    }
+
+    if (from_storage_ref->row_tag_count > 0)
+    {
+        for (uint32_t r = 0; r < count; r++)
+            _storage_copy_row_tags(from_storage_ref, to_storage_mut_ref, rows[r], first_row + r);
+    }
+
+    // rows come from the highest, the row filling each hole is never one still waiting to move
+    for (uint32_t r = 0; r < count; r++)
+    {
+        entity_id moved_entity = _storage_remove_row(from_storage_ref, rows[r], false);
+        if (moved_entities_out != NULL)
+            moved_entities_out[r] = moved_entity;
+    }
+
+    return (int)first_row;
 }
 
-static void _storage_resize(ecs_storage *const storage_mut_ref, uint32_t capacity)
+void ecs_storage_remove_edge(ecs_storage *const storage_mut_ref, archetype_id to)
 {
-    storage_mut_ref->entities = CFF_ARR_RESIZE(storage_mut_ref->entities, capacity);
-    for (size_t i = 0; i < storage_mut_ref->component_count; i++)
+    storage_edge_list *edges = &(storage_mut_ref->edges);
+
+    for (uint32_t i = 0; i < edges->count; i++)
     {
-        size_t component_size = storage_mut_ref->component_sizes[i];
-        if (component_size > 0)
-        {
-            void *ptr = storage_mut_ref->entity_data[i];
-            storage_mut_ref->entity_data[i] = CFF_REALLOC(ptr, component_size * capacity);
-        }
+        if (edges->buffer[i].to != to)
+            continue;
+
+        CFF_RELEASE(edges->buffer[i].slots);
+        edges->buffer[i] = edges->buffer[edges->count - 1];
+        edges->count--;
+        return;
     }
+}
 
-    storage_mut_ref->entity_capacity = capacity;
+entity_id ecs_storage_get_entity(const ecs_storage *const storage_ref, int row)
+{
+    if (row < 0 || (uint32_t)row >= storage_ref->entity_count)
+        return INVALID_ID;
+    return *_storage_get_entity_ref(storage_ref, row);
+}
+
+int ecs_storage_get_component_slot(const ecs_storage *const storage_ref, component_id component)
+{
+    return _storage_get_component_index(storage_ref, component);
+}
+
+void ecs_storage_set_enabled(ecs_storage *const storage_mut_ref, int row, bool enabled)
+{
+    _storage_set_disabled(storage_mut_ref, &(storage_mut_ref->disabled_rows), (uint32_t)row, !enabled);
+}
+
+bool ecs_storage_is_enabled(const ecs_storage *const storage_ref, int row)
+{
+    return !cff_bitset_test(&(storage_ref->disabled_rows), (uint32_t)row);
+}
+
+void ecs_storage_set_component_enabled(ecs_storage *const storage_mut_ref, int row, component_id component, bool enabled)
+{
+    int slot = _storage_get_component_index(storage_mut_ref, component);
+    if (slot == -1)
+        return;
+
+    _storage_set_slot_disabled(storage_mut_ref, slot, (uint32_t)row, !enabled);
+}
+
+bool ecs_storage_is_component_enabled(const ecs_storage *const storage_ref, int row, component_id component)
+{
+    int slot = _storage_get_component_index(storage_ref, component);
+    if (slot == -1 || storage_ref->disabled_components == NULL)
+        return slot != -1;
+
+    return !cff_bitset_test(storage_ref->disabled_components + slot, (uint32_t)row);
+}
+
+bool ecs_storage_has_disabled(const ecs_storage *const storage_ref)
+{
+    return storage_ref->disabled_count > 0;
+}
+
+uint32_t ecs_storage_next_enabled_run(const ecs_storage *const storage_ref, uint32_t chunk, const int32_t *slots, uint32_t slot_count, uint32_t row, uint32_t end, uint32_t *first_out)
+{
+    // rows are relative to the chunk, the masks use storage rows
+    uint32_t base = ecs_storage_chunk_first_row(storage_ref, chunk);
+    row += base;
+    end += base;
+
+    // whole words without disabled rows are skipped at once
+    while (row < end)
+    {
+        uint64_t enabled = ~_storage_disabled_word(storage_ref, slots, slot_count, row / 64) >> (row % 64);
+        if (enabled != 0)
+        {
+            row += (uint32_t)__builtin_ctzll(enabled);
+            break;
+        }
+        row = (row / 64 + 1) * 64;
+    }
+
+    if (row >= end)
+        return 0;
+
+    uint32_t first = row;
+
+    while (row < end)
+    {
+        uint64_t disabled = _storage_disabled_word(storage_ref, slots, slot_count, row / 64) >> (row % 64);
+        if (disabled != 0)
+        {
+            row += (uint32_t)__builtin_ctzll(disabled);
+            break;
+        }
+        row = (row / 64 + 1) * 64;
+    }
+
+    *first_out = first - base;
+    return (row < end ? row : end) - first;
+}
+
+bool ecs_storage_set_row_tag(ecs_storage *const storage_mut_ref, int row, component_id tag, bool set)
+{
+    if (row < 0 || (uint32_t)row >= storage_mut_ref->entity_count)
+        return false;
+
+    ecs_row_tag *row_tag = _storage_find_row_tag(storage_mut_ref, tag);
+    if (row_tag == NULL)
+    {
+        if (!set)
+            return false;
+
+        if (storage_mut_ref->row_tags.buffer == NULL)
+            row_tag_list_init(&(storage_mut_ref->row_tags), 4);
+
+        ecs_row_tag entry = {.tag = tag, .count = 0};
+        cff_bitset_init(&(entry.rows));
+        row_tag_list_add(&(storage_mut_ref->row_tags), entry);
+        row_tag = row_tag_list_get_ref(&(storage_mut_ref->row_tags), storage_mut_ref->row_tags.count - 1);
+    }
+
+    return _storage_set_row_tag_bit(storage_mut_ref, row_tag, (uint32_t)row, set);
+}
+
+bool ecs_storage_has_row_tag(const ecs_storage *const storage_ref, int row, component_id tag)
+{
+    const ecs_row_tag *row_tag = _storage_find_row_tag(storage_ref, tag);
+    return row_tag != NULL && row >= 0 && cff_bitset_test(&(row_tag->rows), (uint32_t)row);
+}
+
+uint32_t ecs_storage_row_tag_count(const ecs_storage *const storage_ref)
+{
+    return storage_ref->row_tags.count;
+}
+
+component_id ecs_storage_get_row_tag(const ecs_storage *const storage_ref, uint32_t index)
+{
+    if (index >= storage_ref->row_tags.count)
+        return INVALID_ID;
+    return storage_ref->row_tags.buffer[index].tag;
+}
+
+uint32_t ecs_storage_next_tagged_run(const ecs_storage *const storage_ref, uint32_t chunk, const component_id *with, uint32_t with_count, const component_id *without, uint32_t without_count, uint32_t row, uint32_t end, uint32_t *first_out)
+{
+    // a required tag no row holds leaves the whole storage out
+    for (uint32_t i = 0; i < with_count; i++)
+    {
+        const ecs_row_tag *row_tag = _storage_find_row_tag(storage_ref, with[i]);
+        if (row_tag == NULL || row_tag->count == 0)
+            return 0;
+    }
+
+    uint32_t base = ecs_storage_chunk_first_row(storage_ref, chunk);
+    row += base;
+    end += base;
+
+    // same word scan as the enabled runs, a whole word of rows is tested at once
+    while (row < end)
+    {
+        uint64_t tagged = _storage_tagged_word(storage_ref, with, with_count, without, without_count, row / 64) >> (row % 64);
+        if (tagged != 0)
+        {
+            row += (uint32_t)__builtin_ctzll(tagged);
+            break;
+        }
+        row = (row / 64 + 1) * 64;
+    }
+
+    if (row >= end)
+        return 0;
+
+    uint32_t first = row;
+
+    while (row < end)
+    {
+        uint64_t untagged = ~_storage_tagged_word(storage_ref, with, with_count, without, without_count, row / 64) >> (row % 64);
+        if (untagged != 0)
+        {
+            row += (uint32_t)__builtin_ctzll(untagged);
+            break;
+        }
+        row = (row / 64 + 1) * 64;
+    }
+
+    *first_out = first - base;
+    return (row < end ? row : end) - first;
+}
+
+void ecs_storage_track_changes(ecs_storage *const storage_mut_ref, int slot)
+{
+    if (slot < 0 || (uint32_t)slot >= storage_mut_ref->component_count)
+        return;
+
+    if (storage_mut_ref->changes == NULL)
+    {
+        size_t size = sizeof(ecs_change_ticks) * storage_mut_ref->component_count;
+        storage_mut_ref->changes = (ecs_change_ticks *)CFF_ALLOC(size, "STORAGE CHANGE TICKS");
+        CFF_ZERO(storage_mut_ref->changes, size);
+    }
+
+    ecs_change_ticks *ticks = storage_mut_ref->changes + slot;
+    if (ticks->rows != NULL)
+        return;
+
+    ticks->row_capacity = storage_mut_ref->entity_capacity ? storage_mut_ref->entity_capacity : 4;
+    ticks->chunk_capacity = _storage_chunk_of(storage_mut_ref, ticks->row_capacity - 1) + 1;
+    ticks->rows = (uint32_t *)CFF_ALLOC(sizeof(uint32_t) * ticks->row_capacity, "STORAGE ROW TICKS");
+    ticks->chunks = (uint32_t *)CFF_ALLOC(sizeof(uint32_t) * ticks->chunk_capacity, "STORAGE CHUNK TICKS");
+    CFF_ZERO(ticks->rows, sizeof(uint32_t) * ticks->row_capacity);
+    CFF_ZERO(ticks->chunks, sizeof(uint32_t) * ticks->chunk_capacity);
+
+    if (storage_mut_ref->entity_count > 0)
+        ecs_storage_mark_changed(storage_mut_ref, slot, 0, storage_mut_ref->entity_count, _storage_tick(storage_mut_ref));
+}
+
+void ecs_storage_mark_changed(ecs_storage *const storage_mut_ref, int slot, uint32_t row, uint32_t count, uint32_t tick)
+{
+    if (storage_mut_ref->changes == NULL || count == 0)
+        return;
+
+    ecs_change_ticks *ticks = storage_mut_ref->changes + slot;
+    if (ticks->rows == NULL)
+        return;
+
+    uint32_t end = row + count;
+
+    if (end > ticks->row_capacity)
+    {
+        uint32_t capacity = ticks->row_capacity;
+        while (capacity < end)
+            capacity *= 2;
+
+        ticks->rows = CFF_ARR_RESIZE(ticks->rows, capacity);
+        CFF_ZERO(ticks->rows + ticks->row_capacity, sizeof(uint32_t) * (capacity - ticks->row_capacity));
+        ticks->row_capacity = capacity;
+    }
+
+    uint32_t last_chunk = _storage_chunk_of(storage_mut_ref, end - 1);
+    if (last_chunk >= ticks->chunk_capacity)
+    {
+        uint32_t capacity = ticks->chunk_capacity;
+        while (capacity <= last_chunk)
+            capacity *= 2;
+
+        ticks->chunks = CFF_ARR_RESIZE(ticks->chunks, capacity);
+        CFF_ZERO(ticks->chunks + ticks->chunk_capacity, sizeof(uint32_t) * (capacity - ticks->chunk_capacity));
+        ticks->chunk_capacity = capacity;
+    }
+
+    for (uint32_t r = row; r < end; r++)
+        ticks->rows[r] = tick;
+
+    // rows moved by a swap-remove may carry an older tick, the chunk keeps the highest one
+    for (uint32_t c = _storage_chunk_of(storage_mut_ref, row); c <= last_chunk; c++)
+    {
+        if (ticks->chunks[c] < tick)
+            ticks->chunks[c] = tick;
+    }
+}
+
+bool ecs_storage_chunk_changed(const ecs_storage *const storage_ref, uint32_t chunk, const int32_t *slots, uint32_t slot_count, uint32_t since)
+{
+    for (uint32_t i = 0; i < slot_count; i++)
+    {
+        if (slots[i] < 0)
+            continue;
+
+        // untracked slots have no history, every row counts as changed
+        if (storage_ref->changes == NULL || storage_ref->changes[slots[i]].rows == NULL)
+            continue;
+
+        const ecs_change_ticks *ticks = storage_ref->changes + slots[i];
+        if (chunk >= ticks->chunk_capacity || ticks->chunks[chunk] <= since)
+            return false;
+    }
+
+    return true;
+}
+
+uint32_t ecs_storage_next_changed_run(const ecs_storage *const storage_ref, uint32_t chunk, const int32_t *slots, uint32_t slot_count, uint32_t since, uint32_t row, uint32_t end, uint32_t *first_out)
+{
+    uint32_t base = ecs_storage_chunk_first_row(storage_ref, chunk);
+    row += base;
+    end += base;
+
+    while (row < end && !_storage_row_changed(storage_ref, slots, slot_count, since, row))
+        row++;
+
+    if (row >= end)
+        return 0;
+
+    uint32_t first = row;
+
+    while (row < end && _storage_row_changed(storage_ref, slots, slot_count, since, row))
+        row++;
+
+    *first_out = first - base;
+    return row - first;
+}
+
+static bool _storage_row_changed(const ecs_storage *const storage_ref, const int32_t *slots, uint32_t slot_count, uint32_t since, uint32_t row)
+{
+    for (uint32_t i = 0; i < slot_count; i++)
+    {
+        if (slots[i] < 0 || storage_ref->changes == NULL)
+            continue;
+
+        const ecs_change_ticks *ticks = storage_ref->changes + slots[i];
+        if (ticks->rows == NULL)
+            continue;
+
+        if (row >= ticks->row_capacity || ticks->rows[row] <= since)
+            return false;
+    }
+
+    return true;
+}
+
+static void _storage_stamp_rows(ecs_storage *const storage_mut_ref, uint32_t row, uint32_t count)
+{
+    uint32_t tick = _storage_tick(storage_mut_ref);
+
+    for (uint32_t i = 0; i < storage_mut_ref->component_count; i++)
+        ecs_storage_mark_changed(storage_mut_ref, i, row, count, tick);
+}
+
+static uint32_t _storage_tick(const ecs_storage *const storage_ref)
+{
+    return storage_ref->change_tick != NULL ? *storage_ref->change_tick : 1;
+}
+
+static uint32_t _storage_chunk_of(const ecs_storage *const storage_ref, uint32_t row)
+{
+    if (storage_ref->layout != ECS_STORAGE_CHUNKED)
+        return 0;
+    return row / storage_ref->chunk_capacity;
+}
+
+static uint32_t _storage_contiguous_rows(const ecs_storage *const storage_ref, uint32_t row, uint32_t count)
+{
+    if (storage_ref->layout != ECS_STORAGE_CHUNKED)
+        return count;
+
+    uint32_t chunk_left = storage_ref->chunk_capacity - (row % storage_ref->chunk_capacity);
+    return count < chunk_left ? count : chunk_left;
+}
+
+static void _storage_column_ctor(ecs_storage *const storage_mut_ref, uint32_t column, uint32_t row, uint32_t count)
+{
+    if (storage_mut_ref->hooks == NULL || storage_mut_ref->hooks[column].ctor == NULL)
+        return;
+
+    // one call per contiguous range of the column
+    while (count > 0)
+    {
+        uint32_t segment = _storage_contiguous_rows(storage_mut_ref, row, count);
+        storage_mut_ref->hooks[column].ctor(_storage_get_data(storage_mut_ref, column, row), segment);
+        row += segment;
+        count -= segment;
+    }
+}
+
+static void _storage_column_dtor(ecs_storage *const storage_mut_ref, uint32_t column, uint32_t row, uint32_t count)
+{
+    if (storage_mut_ref->hooks == NULL || storage_mut_ref->hooks[column].dtor == NULL)
+        return;
+
+    while (count > 0)
+    {
+        uint32_t segment = _storage_contiguous_rows(storage_mut_ref, row, count);
+        storage_mut_ref->hooks[column].dtor(_storage_get_data(storage_mut_ref, column, row), segment);
+        row += segment;
+        count -= segment;
+    }
+}
+
+static void _storage_construct(ecs_storage *const storage_mut_ref, uint32_t row, uint32_t count)
+{
+    for (uint32_t i = 0; i < storage_mut_ref->component_count; i++)
+        _storage_column_ctor(storage_mut_ref, i, row, count);
+}
+
+static void _storage_construct_missing(ecs_storage *const to_storage_mut_ref, const int32_t *slots, uint32_t slot_count, uint32_t row, uint32_t count)
+{
+    for (uint32_t j = 0; j < to_storage_mut_ref->component_count; j++)
+    {
+        bool moved = false;
+        for (uint32_t i = 0; i < slot_count && !moved; i++)
+            moved = slots[i] == (int32_t)j;
+
+        if (!moved)
+            _storage_column_ctor(to_storage_mut_ref, j, row, count);
+    }
+}
+
+static void _storage_relocate(const ecs_storage *const from_storage_ref, uint32_t column, uint32_t from_row, ecs_storage *const to_storage_mut_ref, uint32_t to_column, uint32_t to_row)
+{
+    void *from = _storage_get_data(from_storage_ref, column, from_row);
+    void *to = _storage_get_data(to_storage_mut_ref, to_column, to_row);
+
+    if (from_storage_ref->hooks != NULL && from_storage_ref->hooks[column].move != NULL)
+        from_storage_ref->hooks[column].move(to, from, 1);
+    else
+        CFF_COPY(from, to, from_storage_ref->component_sizes[column]);
+}
+
+static void _storage_set_disabled(ecs_storage *const storage_mut_ref, cff_bitset *set, uint32_t row, bool disabled)
+{
+    if (cff_bitset_test(set, row) == disabled)
+        return;
+
+    if (disabled)
+    {
+        cff_bitset_set(set, row);
+        storage_mut_ref->disabled_count++;
+    }
+    else
+    {
+        cff_bitset_clear(set, row);
+        storage_mut_ref->disabled_count--;
+    }
+}
+
+static void _storage_set_slot_disabled(ecs_storage *const storage_mut_ref, int slot, uint32_t row, bool disabled)
+{
+    if (storage_mut_ref->disabled_components == NULL)
+    {
+        if (!disabled)
+            return;
+
+        uint32_t count = storage_mut_ref->component_count;
+        storage_mut_ref->disabled_components = (cff_bitset *)CFF_ALLOC(sizeof(cff_bitset) * count, "STORAGE DISABLED COMPONENTS");
+        for (uint32_t i = 0; i < count; i++)
+        {
+            cff_bitset_init(storage_mut_ref->disabled_components + i);
+        }
+    }
+
+    _storage_set_disabled(storage_mut_ref, storage_mut_ref->disabled_components + slot, row, disabled);
+}
+
+static void _storage_copy_disabled(const ecs_storage *const from_storage_ref, ecs_storage *const to_storage_mut_ref, const int32_t *slots, uint32_t from_row, uint32_t to_row)
+{
+    if (cff_bitset_test(&(from_storage_ref->disabled_rows), from_row))
+        _storage_set_disabled(to_storage_mut_ref, &(to_storage_mut_ref->disabled_rows), to_row, true);
+
+    if (from_storage_ref->disabled_components == NULL)
+        return;
+
+    for (uint32_t i = 0; i < from_storage_ref->component_count; i++)
+    {
+        if (slots[i] >= 0 && cff_bitset_test(from_storage_ref->disabled_components + i, from_row))
+            _storage_set_slot_disabled(to_storage_mut_ref, slots[i], to_row, true);
+    }
+}
+
+static const int32_t *_storage_get_edge(ecs_storage *const from_storage_ref, const ecs_storage *const to_storage_ref)
+{
+    storage_edge_list *edges = &(from_storage_ref->edges);
+
+    for (uint32_t i = 0; i < edges->count; i++)
+    {
+        if (edges->buffer[i].to == to_storage_ref->archetype)
+            return edges->buffer[i].slots;
+    }
+
+    if (edges->buffer == NULL)
+        storage_edge_list_init(edges, 4);
+
+    uint32_t count = from_storage_ref->component_count;
+    int32_t *slots = (int32_t *)CFF_ALLOC(sizeof(int32_t) * (count ? count : 1), "STORAGE EDGE");
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        slots[i] = _storage_get_component_index(to_storage_ref, from_storage_ref->components[i]);
+    }
+
+    storage_edge_list_add(edges, (ecs_storage_edge){.to = to_storage_ref->archetype, .slots = slots});
+    return slots;
+}
+
+static void _storage_swap_disabled(ecs_storage *const storage_mut_ref, uint32_t row, uint32_t last_row)
+{
+    bool last_disabled = cff_bitset_test(&(storage_mut_ref->disabled_rows), last_row);
+    _storage_set_disabled(storage_mut_ref, &(storage_mut_ref->disabled_rows), row, last_disabled);
+    _storage_set_disabled(storage_mut_ref, &(storage_mut_ref->disabled_rows), last_row, false);
+
+    if (storage_mut_ref->disabled_components == NULL)
+        return;
+
+    for (uint32_t i = 0; i < storage_mut_ref->component_count; i++)
+    {
+        cff_bitset *set = storage_mut_ref->disabled_components + i;
+        last_disabled = cff_bitset_test(set, last_row);
+        _storage_set_disabled(storage_mut_ref, set, row, last_disabled);
+        _storage_set_disabled(storage_mut_ref, set, last_row, false);
+    }
+}
+
+static uint64_t _storage_disabled_word(const ecs_storage *const storage_ref, const int32_t *slots, uint32_t slot_count, uint32_t word)
+{
+    const cff_bitset *rows = &(storage_ref->disabled_rows);
+    uint64_t disabled = word < rows->word_count ? rows->words[word] : 0;
+
+    if (storage_ref->disabled_components == NULL)
+        return disabled;
+
+    for (uint32_t i = 0; i < slot_count; i++)
+    {
+        if (slots[i] < 0)
+            continue;
+
+        const cff_bitset *set = storage_ref->disabled_components + slots[i];
+        if (word < set->word_count)
+            disabled |= set->words[word];
+    }
+
+    return disabled;
+}
+
+static ecs_row_tag *_storage_find_row_tag(const ecs_storage *const storage_ref, component_id tag)
+{
+    for (uint32_t i = 0; i < storage_ref->row_tags.count; i++)
+    {
+        if (storage_ref->row_tags.buffer[i].tag == tag)
+            return storage_ref->row_tags.buffer + i;
+    }
+    return NULL;
+}
+
+static bool _storage_set_row_tag_bit(ecs_storage *const storage_mut_ref, ecs_row_tag *row_tag, uint32_t row, bool set)
+{
+    if (cff_bitset_test(&(row_tag->rows), row) == set)
+        return false;
+
+    if (set)
+    {
+        cff_bitset_set(&(row_tag->rows), row);
+        row_tag->count++;
+        storage_mut_ref->row_tag_count++;
+    }
+    else
+    {
+        cff_bitset_clear(&(row_tag->rows), row);
+        row_tag->count--;
+        storage_mut_ref->row_tag_count--;
+    }
+    return true;
+}
+
+static void _storage_swap_row_tags(ecs_storage *const storage_mut_ref, uint32_t row, uint32_t last_row)
+{
+    for (uint32_t i = 0; i < storage_mut_ref->row_tags.count; i++)
+    {
+        ecs_row_tag *row_tag = storage_mut_ref->row_tags.buffer + i;
+        bool last_set = cff_bitset_test(&(row_tag->rows), last_row);
+        _storage_set_row_tag_bit(storage_mut_ref, row_tag, row, last_set);
+        _storage_set_row_tag_bit(storage_mut_ref, row_tag, last_row, false);
+    }
+}
+
+static void _storage_copy_row_tags(const ecs_storage *const from_storage_ref, ecs_storage *const to_storage_mut_ref, uint32_t from_row, uint32_t to_row)
+{
+    for (uint32_t i = 0; i < from_storage_ref->row_tags.count; i++)
+    {
+        const ecs_row_tag *row_tag = from_storage_ref->row_tags.buffer + i;
+        if (cff_bitset_test(&(row_tag->rows), from_row))
+            ecs_storage_set_row_tag(to_storage_mut_ref, (int)to_row, row_tag->tag, true);
+    }
+}
+
+static uint64_t _storage_tagged_word(const ecs_storage *const storage_ref, const component_id *with, uint32_t with_count, const component_id *without, uint32_t without_count, uint32_t word)
+{
+    uint64_t tagged = ~(uint64_t)0;
+
+    for (uint32_t i = 0; i < with_count; i++)
+    {
+        const cff_bitset *set = &(_storage_find_row_tag(storage_ref, with[i])->rows);
+        tagged &= word < set->word_count ? set->words[word] : 0;
+    }
+
+    for (uint32_t i = 0; i < without_count; i++)
+    {
+        const ecs_row_tag *row_tag = _storage_find_row_tag(storage_ref, without[i]);
+        if (row_tag != NULL && word < row_tag->rows.word_count)
+            tagged &= ~row_tag->rows.words[word];
+    }
+
+    return tagged;
+}
+
+// OPTIMIZE
+static int _storage_get_component_index(const ecs_storage *const storage_ref, component_id id)
+{
+    for (size_t i = 0; i < storage_ref->component_count; i++)
+    {
+        if (storage_ref->components[i] == id)
+            return i;
+    }
+    return -1;
+}
+
+static void _storage_resize(ecs_storage *const storage_mut_ref, uint32_t capacity)
+{
+    // a packed storage gets one buffer per column again
+    void *slab = storage_mut_ref->slab;
+
+    if (slab != NULL)
+    {
+        entity_id *entities = (entity_id *)CFF_ALLOC(sizeof(entity_id) * capacity, "STORAGE");
+        CFF_COPY(storage_mut_ref->entities, entities, sizeof(entity_id) * storage_mut_ref->entity_count);
+        storage_mut_ref->entities = entities;
+    }
+    else
+    {
+        storage_mut_ref->entities = CFF_ARR_RESIZE(storage_mut_ref->entities, capacity);
+    }
+
+    for (size_t i = 0; i < storage_mut_ref->component_count; i++)
+    {
+        size_t component_size = storage_mut_ref->component_sizes[i];
+        if (component_size > 0)
+        {
+            // columns are over aligned, so grow them by hand instead of CFF_REALLOC
+            void *ptr = storage_mut_ref->entity_data[i];
+            size_t buffer_size = _storage_align_up(component_size * capacity, ECS_SIMD_ALIGNMENT);
+            void *buffer = CFF_ALIGNED_ALLOC(buffer_size, _storage_column_align(storage_mut_ref, i), "STORAGE COMPONENTS ARRAY");
+            if (storage_mut_ref->hooks != NULL && storage_mut_ref->hooks[i].move != NULL)
+                storage_mut_ref->hooks[i].move(buffer, ptr, storage_mut_ref->entity_count);
+            else
+                CFF_COPY(ptr, buffer, component_size * storage_mut_ref->entity_count);
+            if (slab == NULL)
+                CFF_ALIGNED_RELEASE(ptr);
+            storage_mut_ref->entity_data[i] = buffer;
+        }
+    }
+
+    if (slab != NULL)
+    {
+        CFF_ALIGNED_RELEASE(slab);
+        storage_mut_ref->slab = NULL;
+    }
+
+    storage_mut_ref->entity_capacity = capacity;
+}
+
+static size_t _storage_slab_layout(const ecs_storage *const storage_ref, uint32_t capacity, size_t *offsets_out)
+{
+    // same layout as a chunk, the ids first and every column on its own aligned line
+    size_t offset = _storage_align_up(sizeof(entity_id) * capacity, ECS_CACHE_LINE_SIZE);
+
+    for (uint32_t i = 0; i < storage_ref->component_count; i++)
+    {
+        offset = _storage_align_up(offset, _storage_column_align(storage_ref, i));
+        if (offsets_out != NULL)
+            offsets_out[i] = offset;
+        offset += _storage_align_up(storage_ref->component_sizes[i] * capacity, ECS_SIMD_ALIGNMENT);
+    }
+
+    return offset;
+}
+
+static void _storage_pack(ecs_storage *const storage_mut_ref, uint32_t capacity)
+{
+    uint32_t component_count = storage_mut_ref->component_count;
+    size_t *offsets = (size_t *)CFF_ALLOC(sizeof(size_t) * (component_count ? component_count : 1), "STORAGE SLAB OFFSETS");
+    size_t size = _storage_slab_layout(storage_mut_ref, capacity, offsets);
+
+    void *slab = CFF_ALIGNED_ALLOC(size, storage_mut_ref->alignment, "STORAGE SLAB");
+    entity_id *entities = (entity_id *)slab;
+    if (storage_mut_ref->entity_count > 0)
+        CFF_COPY(storage_mut_ref->entities, entities, sizeof(entity_id) * storage_mut_ref->entity_count);
+
+    for (uint32_t i = 0; i < component_count; i++)
+    {
+        size_t component_size = storage_mut_ref->component_sizes[i];
+        if (component_size == 0)
+            continue;
+
+        void *ptr = storage_mut_ref->entity_data[i];
+        void *buffer = (void *)((uintptr_t)slab + offsets[i]);
+        if (storage_mut_ref->hooks != NULL && storage_mut_ref->hooks[i].move != NULL)
+            storage_mut_ref->hooks[i].move(buffer, ptr, storage_mut_ref->entity_count);
+        else if (storage_mut_ref->entity_count > 0)
+            CFF_COPY(ptr, buffer, component_size * storage_mut_ref->entity_count);
+        if (storage_mut_ref->slab == NULL)
+            CFF_ALIGNED_RELEASE(ptr);
+        storage_mut_ref->entity_data[i] = buffer;
+    }
+
+    if (storage_mut_ref->slab != NULL)
+        CFF_ALIGNED_RELEASE(storage_mut_ref->slab);
+    else
+        CFF_RELEASE(storage_mut_ref->entities);
+
+    CFF_RELEASE(offsets);
+    storage_mut_ref->entities = entities;
+    storage_mut_ref->slab = slab;
+    storage_mut_ref->entity_capacity = capacity;
+}
+
+static size_t _storage_align_up(size_t value, size_t align)
+{
+    return (value + align - 1) & ~(align - 1);
+}
+
+static size_t _storage_column_align(const ecs_storage *const storage_ref, uint32_t column)
+{
+    size_t align = storage_ref->component_aligns[column];
+    return align > ECS_SIMD_ALIGNMENT ? align : ECS_SIMD_ALIGNMENT;
+}
+
+static void _storage_setup_chunks(ecs_storage *const storage_mut_ref)
+{
+    uint32_t component_count = storage_mut_ref->component_count;
+    size_t row_size = sizeof(entity_id);
+
+    for (size_t i = 0; i < component_count; i++)
+    {
+        row_size += storage_mut_ref->component_sizes[i];
+    }
+
+    // every column starts on its own aligned line, reserve the worst case padding before fitting rows in the chunk
+    size_t padding = ECS_CACHE_LINE_SIZE;
+    for (uint32_t i = 0; i < component_count; i++)
+    {
+        padding += _storage_column_align(storage_mut_ref, i);
+    }
+
+    uint32_t capacity = 1;
+
+    if (ECS_CHUNK_SIZE > padding + row_size)
+    {
+        capacity = (uint32_t)((ECS_CHUNK_SIZE - padding) / row_size);
+    }
+
+    size_t *offsets = (size_t *)CFF_ALLOC(sizeof(size_t) * (component_count ? component_count : 1), "STORAGE CHUNK OFFSETS");
+    size_t offset = _storage_align_up(sizeof(entity_id) * capacity, ECS_CACHE_LINE_SIZE);
+
+    for (uint32_t i = 0; i < component_count; i++)
+    {
+        offset = _storage_align_up(offset, _storage_column_align(storage_mut_ref, i));
+        offsets[i] = offset;
+        offset += _storage_align_up(storage_mut_ref->component_sizes[i] * capacity, ECS_SIMD_ALIGNMENT);
+    }
+
+    storage_mut_ref->chunk_offsets = offsets;
+    storage_mut_ref->chunk_capacity = capacity;
+    storage_mut_ref->chunk_size = offset > ECS_CHUNK_SIZE ? offset : ECS_CHUNK_SIZE;
+
+    storage_mut_ref->chunk_count = 0;
+    storage_mut_ref->chunk_list_capacity = 4;
+    storage_mut_ref->chunks = (void **)CFF_ALLOC(sizeof(void *) * storage_mut_ref->chunk_list_capacity, "STORAGE CHUNKS");
+
+    storage_mut_ref->entity_capacity = 0;
+    storage_mut_ref->entity_count = 0;
+}
+
+static void _storage_add_chunk(ecs_storage *const storage_mut_ref)
+{
+    if (storage_mut_ref->chunk_count == storage_mut_ref->chunk_list_capacity)
+    {
+        storage_mut_ref->chunks = CFF_ARR_RESIZE(storage_mut_ref->chunks, storage_mut_ref->chunk_list_capacity * 2);
+        storage_mut_ref->chunk_list_capacity *= 2;
+    }
+
+    storage_mut_ref->chunks[storage_mut_ref->chunk_count] = CFF_ALIGNED_ALLOC(storage_mut_ref->chunk_size, storage_mut_ref->alignment, "STORAGE CHUNK");
+    storage_mut_ref->chunk_count++;
+    storage_mut_ref->entity_capacity += storage_mut_ref->chunk_capacity;
+}
+
+static void *_storage_get_data(const ecs_storage *const storage_ref, uint32_t column, uint32_t row)
+{
+    size_t component_size = storage_ref->component_sizes[column];
+
+    if (storage_ref->layout == ECS_STORAGE_CHUNKED)
+    {
+        uintptr_t chunk = (uintptr_t)storage_ref->chunks[row / storage_ref->chunk_capacity];
+        return (void *)(chunk + storage_ref->chunk_offsets[column] + (uintptr_t)(component_size * (row % storage_ref->chunk_capacity)));
+    }
+
+    return (void *)((uintptr_t)storage_ref->entity_data[column] + (uintptr_t)(component_size * row));
+}
+
+static entity_id *_storage_get_entity_ref(const ecs_storage *const storage_ref, uint32_t row)
+{
+    if (storage_ref->layout == ECS_STORAGE_CHUNKED)
+    {
+        entity_id *chunk_ids = (entity_id *)storage_ref->chunks[row / storage_ref->chunk_capacity];
+        return chunk_ids + (row % storage_ref->chunk_capacity);
+    }
+
+    return storage_ref->entities + row;
 }
\ No newline at end of file
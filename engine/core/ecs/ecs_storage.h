@@ -4,16 +4,63 @@
 
 typedef struct ecs_storage ecs_storage;
 
+// hooks of the component in slot, rows added afterwards run its constructor
+void ecs_storage_set_hooks(ecs_storage *const storage_mut_ref, int slot, const ecs_type_info *const hooks);
+
 int ecs_storage_add_entity(ecs_storage *const storage, entity_id entity);
+int ecs_storage_add_entities(ecs_storage *const storage, const entity_id *const entities, uint32_t count);
+void ecs_storage_reserve(ecs_storage *const storage, uint32_t capacity);
+// gives back the capacity the rows no longer use, small linear storages are packed in a single block, returns false when nothing changed
+bool ecs_storage_compact(ecs_storage *const storage_mut_ref);
 entity_id ecs_storage_remove_entity(ecs_storage *const storage, int row);
 
 void ecs_storage_set_component(ecs_storage *const storage_mut_ref, int row, component_id component, const void *const data);
+void ecs_storage_fill_component(ecs_storage *const storage_mut_ref, int first_row, uint32_t count, component_id component, const void *const data);
 void *ecs_storage_get_component(const ecs_storage *const storage_ref, int row, component_id component);
 component_id ecs_storage_get_component_id(const ecs_storage *const storage_ref, const char *const name);
 
-void *ecs_storage_get_component_list(const ecs_storage *const storage_ref, component_id component);
-entity_id *ecs_storage_get_enetities_ids(const ecs_storage *const storage_ref);
+int ecs_storage_get_column_index(const ecs_storage *const storage_ref, component_id component);
+
+uint32_t ecs_storage_chunk_count(const ecs_storage *const storage_ref);
+uint32_t ecs_storage_chunk_rows(const ecs_storage *const storage_ref, uint32_t chunk);
+uint32_t ecs_storage_chunk_first_row(const ecs_storage *const storage_ref, uint32_t chunk);
+void *ecs_storage_get_chunk_column(const ecs_storage *const storage_ref, uint32_t chunk, int column);
+size_t ecs_storage_get_column_size(const ecs_storage *const storage_ref, int column);
+entity_id *ecs_storage_get_chunk_ids(const ecs_storage *const storage_ref, uint32_t chunk);
+
+int ecs_storage_move_entity(ecs_storage *const from_storage_ref, ecs_storage *const to_storage_mut_ref, entity_id id, int entity_row, entity_id *const moved_entity_out);
+// rows must be sorted from the highest, moved_entities_out receives the entity that took each row or INVALID_ID, returns the first row in to
+int ecs_storage_move_entities(ecs_storage *const from_storage_ref, ecs_storage *const to_storage_mut_ref, const int *const rows, uint32_t count, entity_id *const moved_entities_out);
+entity_id ecs_storage_get_entity(const ecs_storage *const storage_ref, int row);
+
+// slot of the component in the storage, unlike the column index tags have one
+int ecs_storage_get_component_slot(const ecs_storage *const storage_ref, component_id component);
+
+void ecs_storage_set_enabled(ecs_storage *const storage_mut_ref, int row, bool enabled);
+bool ecs_storage_is_enabled(const ecs_storage *const storage_ref, int row);
+void ecs_storage_set_component_enabled(ecs_storage *const storage_mut_ref, int row, component_id component, bool enabled);
+bool ecs_storage_is_component_enabled(const ecs_storage *const storage_ref, int row, component_id component);
+bool ecs_storage_has_disabled(const ecs_storage *const storage_ref);
+// first run of rows in [row, end) of the chunk where the entity and every given component slot are enabled, returns its lenght
+uint32_t ecs_storage_next_enabled_run(const ecs_storage *const storage_ref, uint32_t chunk, const int32_t *slots, uint32_t slot_count, uint32_t row, uint32_t end, uint32_t *first_out);
+
+// change ticks are only kept for the slots a changed filter tracks, the current rows count as changed
+void ecs_storage_track_changes(ecs_storage *const storage_mut_ref, int slot);
+void ecs_storage_mark_changed(ecs_storage *const storage_mut_ref, int slot, uint32_t row, uint32_t count, uint32_t tick);
+// false when no row of the chunk was written after since in one of the slots
+bool ecs_storage_chunk_changed(const ecs_storage *const storage_ref, uint32_t chunk, const int32_t *slots, uint32_t slot_count, uint32_t since);
+// first run of rows in [row, end) of the chunk written after since in every given slot, returns its lenght
+uint32_t ecs_storage_next_changed_run(const ecs_storage *const storage_ref, uint32_t chunk, const int32_t *slots, uint32_t slot_count, uint32_t since, uint32_t row, uint32_t end, uint32_t *first_out);
 
-int ecs_storage_move_entity(ecs_storage *const from_storage_ref, ecs_storage *const to_storage_mut_ref, entity_id id, int entity_row);
+// row tags are bits of the storage instead of archetype components, returns true when the bit of the row changed
+bool ecs_storage_set_row_tag(ecs_storage *const storage_mut_ref, int row, component_id tag, bool set);
+bool ecs_storage_has_row_tag(const ecs_storage *const storage_ref, int row, component_id tag);
+// row tags the storage has a bitset for, some of them may be set on no row
+uint32_t ecs_storage_row_tag_count(const ecs_storage *const storage_ref);
+component_id ecs_storage_get_row_tag(const ecs_storage *const storage_ref, uint32_t index);
+// first run of rows in [row, end) of the chunk with every tag of with and none of without, returns its lenght
+uint32_t ecs_storage_next_tagged_run(const ecs_storage *const storage_ref, uint32_t chunk, const component_id *with, uint32_t with_count, const component_id *without, uint32_t without_count, uint32_t row, uint32_t end, uint32_t *first_out);
 
-uint32_t ecs_storage_count(const ecs_storage *const storage_ref);
\ No newline at end of file
+uint32_t ecs_storage_count(const ecs_storage *const storage_ref);
+size_t ecs_storage_get_alignment(const ecs_storage *const storage_ref);
+uint32_t ecs_storage_get_components(const ecs_storage *const storage_ref, const component_id **components_out);
\ No newline at end of file
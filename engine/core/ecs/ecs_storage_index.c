@@ -9,10 +9,15 @@ struct storage_index
     uint32_t count;
     uint8_t *used;
     ecs_storage *storages;
+    ecs_storage_layout layout;
+    uint32_t change_tick;
 };
 
-ecs_storage ecs_storage_new(const component_id *const components, const size_t *const component_sizes, const char **const names_owning, uint32_t components_count);
+ecs_storage ecs_storage_new(archetype_id archetype, const component_id *const components, const size_t *const component_sizes, const size_t *const component_aligns, const char **const names_owning, uint32_t components_count, ecs_storage_layout layout);
 void ecs_storage_release(const ecs_storage *const storage);
+void ecs_storage_remove_edge(ecs_storage *const storage, archetype_id to);
+
+static void _storage_index_grow(storage_index *const index, uint32_t capacity);
 
 storage_index *ecs_storage_index_new(uint32_t capacity)
 {
@@ -22,6 +27,9 @@ storage_index *ecs_storage_index_new(uint32_t capacity)
     index->used = (uint8_t *)CFF_ALLOC(sizeof(uint8_t) * capacity, "STORAGE INDEX USED BUFFER");
     index->capacity = capacity;
     index->count = 0;
+    index->layout = ECS_STORAGE_LINEAR;
+    // 0 is reserved for rows never written
+    index->change_tick = 1;
 
     CFF_ZERO(index->storages, sizeof(ecs_storage) * capacity);
     CFF_ZERO(index->used, sizeof(uint8_t) * capacity);
@@ -45,50 +53,81 @@ void ecs_storage_index_release(const storage_index *const index_owning)
     CFF_RELEASE(index_owning);
 }
 
+void ecs_storage_index_set_layout(storage_index *const index_mut_ref, ecs_storage_layout layout)
+{
+    index_mut_ref->layout = layout;
+}
+
 void ecs_storage_index_new_storage(
     storage_index *const index_mut_ref,
     archetype_id arch_id,
     const component_id *const components_owning,
     const size_t *const sizes_owning,
+    const size_t *const aligns_owning,
     const char **const names_owning,
     uint32_t lenght)
 {
-    if (arch_id > index_mut_ref->capacity)
+    if (arch_id >= index_mut_ref->capacity)
     {
         uint32_t new_capacity = index_mut_ref->capacity * 2;
 
-        while (arch_id > new_capacity)
+        while (arch_id >= new_capacity)
         {
             new_capacity *= 2;
         }
 
-        index_mut_ref->storages = CFF_ARR_RESIZE(index_mut_ref->storages, new_capacity);
-        index_mut_ref->used = CFF_ARR_RESIZE(index_mut_ref->used, new_capacity);
-        index_mut_ref->capacity = new_capacity;
+        _storage_index_grow(index_mut_ref, new_capacity);
     }
 
     if (index_mut_ref->count == index_mut_ref->capacity)
     {
-        uint32_t new_capacity = index_mut_ref->capacity * 2;
-        index_mut_ref->storages = CFF_ARR_RESIZE(index_mut_ref->storages, new_capacity);
-        index_mut_ref->used = CFF_ARR_RESIZE(index_mut_ref->used, new_capacity);
-        index_mut_ref->capacity = new_capacity;
+        _storage_index_grow(index_mut_ref, index_mut_ref->capacity * 2);
     }
 
-    index_mut_ref->storages[arch_id] = ecs_storage_new(components_owning, sizes_owning, names_owning, lenght);
+    index_mut_ref->storages[arch_id] = ecs_storage_new(arch_id, components_owning, sizes_owning, aligns_owning, names_owning, lenght, index_mut_ref->layout);
+    index_mut_ref->storages[arch_id].change_tick = &(index_mut_ref->change_tick);
     index_mut_ref->used[arch_id] = 1;
     index_mut_ref->count++;
 }
 
+uint32_t ecs_storage_index_next_tick(storage_index *const index_mut_ref)
+{
+    // writes made after this one are stamped with a newer tick than the one handed out
+    return index_mut_ref->change_tick++;
+}
+
 ecs_storage *ecs_storage_index_get(const storage_index *const index_ref, archetype_id arch_id)
 {
-    if (index_ref->used[arch_id])
+    if (arch_id < index_ref->capacity && index_ref->used[arch_id])
         return (ecs_storage *)(&index_ref->storages[arch_id]);
     return NULL;
 }
+
+uint32_t ecs_storage_index_capacity(const storage_index *const index_ref)
+{
+    return index_ref->capacity;
+}
+
 void ecs_storage_index_remove(storage_index *const index_mut_ref, archetype_id arch_id)
 {
     index_mut_ref->used[arch_id] = 0;
     ecs_storage_release(index_mut_ref->storages + arch_id);
     index_mut_ref->count--;
+
+    // the other storages must not move entities through a pairing built for the removed one
+    for (uint32_t i = 0; i < index_mut_ref->capacity; i++)
+    {
+        if (index_mut_ref->used[i])
+            ecs_storage_remove_edge(index_mut_ref->storages + i, arch_id);
+    }
+}
+
+static void _storage_index_grow(storage_index *const index_mut_ref, uint32_t capacity)
+{
+    index_mut_ref->storages = CFF_ARR_RESIZE(index_mut_ref->storages, capacity);
+    index_mut_ref->used = CFF_ARR_RESIZE(index_mut_ref->used, capacity);
+
+    // slots past the old capacity hold no storage yet
+    CFF_ZERO(index_mut_ref->used + index_mut_ref->capacity, sizeof(uint8_t) * (capacity - index_mut_ref->capacity));
+    index_mut_ref->capacity = capacity;
 }
\ No newline at end of file
@@ -7,7 +7,12 @@ typedef struct ecs_storage ecs_storage;
 
 storage_index *ecs_storage_index_new(uint32_t capacity);
 void ecs_storage_index_release(const storage_index *const index);
+void ecs_storage_index_set_layout(storage_index *const index, ecs_storage_layout layout);
 
-void ecs_storage_index_new_storage(storage_index *const index, archetype_id arch_id, const component_id *const components, const size_t *const sizes, const char **const names_owning, uint32_t lenght);
+void ecs_storage_index_new_storage(storage_index *const index, archetype_id arch_id, const component_id *const components, const size_t *const sizes, const size_t *const aligns, const char **const names_owning, uint32_t lenght);
 ecs_storage *ecs_storage_index_get(const storage_index *const index, archetype_id arch_id);
-void ecs_storage_index_remove(storage_index *const index, archetype_id arch_id);
\ No newline at end of file
+// storages are indexed by archetype id, every id with one is below it
+uint32_t ecs_storage_index_capacity(const storage_index *const index);
+void ecs_storage_index_remove(storage_index *const index, archetype_id arch_id);
+// tick for a system run, rows it writes get it and writes made afterwards a newer one
+uint32_t ecs_storage_index_next_tick(storage_index *const index);
\ No newline at end of file
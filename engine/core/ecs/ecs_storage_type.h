@@ -2,16 +2,89 @@
 
 #include "ecs_types.h"
 #include "ecs_name_index.h"
+#include "../ds/caffeine_bitset.h"
+#include "../ds/caffeine_vector.h"
+
+#define ECS_CACHE_LINE_SIZE 64
+#define ECS_CHUNK_SIZE (16 * 1024)
+
+typedef struct
+{
+    archetype_id to;
+    // destination slot of every source slot, -1 when the destination lacks the component
+    int32_t *slots;
+} ecs_storage_edge;
+
+cff_arr_dcltype(storage_edge_list, ecs_storage_edge);
+
+typedef struct
+{
+    // tick of the last write of every row, 0 for rows never written since tracking started
+    uint32_t *rows;
+    // highest row tick of every chunk, lets change filters skip whole chunks
+    uint32_t *chunks;
+    uint32_t row_capacity;
+    uint32_t chunk_capacity;
+} ecs_change_ticks;
+
+typedef struct
+{
+    component_id tag;
+    // one bit per row holding the tag
+    cff_bitset rows;
+    uint32_t count;
+} ecs_row_tag;
+
+cff_arr_dcltype(row_tag_list, ecs_row_tag);
 
 struct ecs_storage
 {
+    archetype_id archetype;
     const size_t *component_sizes;
+    const size_t *component_aligns;
+    size_t alignment;
     const component_id *components;
     uint32_t component_count;
 
     name_index component_name_table;
     uint32_t entity_count;
     uint32_t entity_capacity;
+
+    ecs_storage_layout layout;
+
+    // one bit per row, set for disabled entities, and one bitset per component slot created on first use
+    cff_bitset disabled_rows;
+    cff_bitset *disabled_components;
+    // bits set across every disabled bitset, iteration skips the masks while it is zero
+    uint32_t disabled_count;
+
+    // one entry per component slot, NULL while no component of the storage has hooks
+    ecs_type_info *hooks;
+
+    // one entry per component slot created on first use, only slots a changed filter asked for keep ticks
+    ecs_change_ticks *changes;
+    // world tick owned by the storage index, stamped on writes made outside of systems
+    const uint32_t *change_tick;
+
+    // row tags set on any row of the storage, the list is created on first use and entries stay once added
+    row_tag_list row_tags;
+    // bits set across every row tag, moves and removals skip the tags while it is zero
+    uint32_t row_tag_count;
+
+    // column pairing towards every storage entities were moved to, built on the first move
+    storage_edge_list edges;
+
+    // ECS_STORAGE_LINEAR: one growable buffer per component
     entity_id *entities;
     void **entity_data;
-};
\ No newline at end of file
+    // block holding the ids and every column of a compacted small storage, NULL while each has its own buffer
+    void *slab;
+
+    // ECS_STORAGE_CHUNKED: fixed size blocks with the entity ids followed by one column per component
+    void **chunks;
+    size_t *chunk_offsets;
+    size_t chunk_size;
+    uint32_t chunk_capacity;
+    uint32_t chunk_count;
+    uint32_t chunk_list_capacity;
+};
@@ -1,88 +1,158 @@
 #include "ecs_system_index.h"
 #include "ecs_query.h"
 #include "../ds/caffeine_vector.h"
-#include "../ds/caffeine_hashmap.h"
+#include "../ds/caffeine_bitset.h"
 #include "ecs_storage_index.h"
 #include "ecs_archetype_index.h"
 #include "ecs_storage.h"
+#include "ecs_resource_index.h"
+#include "ecs_sparse_index.h"
+#include "ecs_pair_index.h"
+#include "ecs_iterator_type.h"
+#include "../caffeine_logging.h"
+#include "../caffeine_jobs.h"
+
+// parallel systems never get ranges smaller than this, keeps job overhead below the work done
+#define PARALLEL_MIN_ROWS 1024
 
 typedef uint32_t query_id;
 typedef struct query_runner query_runner;
 
+typedef struct
+{
+    query_runner *runner;
+    struct ecs_iterator iterator;
+    const int32_t *columns;
+    const int32_t *filters;
+    const int32_t *changed;
+    const int32_t *written;
+    uint32_t lenght;
+    double delta_time;
+} range_job;
+
 cff_arr_dcltype(archetype_list, archetype_id);
 cff_arr_impl(archetype_list, archetype_id);
 
+cff_arr_dcltype(column_table, int32_t);
+cff_arr_impl(column_table, int32_t);
+
+cff_arr_dcltype(range_list, range_job);
+cff_arr_impl(range_list, range_job);
+
+cff_arr_dcltype(pointer_list, void *);
+cff_arr_impl(pointer_list, void *);
+
+cff_arr_dcltype(job_batch, caff_job);
+cff_arr_impl(job_batch, caff_job);
+
 struct query_runner
 {
     archetype_list archetypes;
+    // dense [archetype][term] table with the storage column of each query term, -1 for terms without data
+    column_table columns;
+    // same layout with the storage slot of the required terms, their disabled masks filter the rows, -1 for optional terms
+    column_table filters;
+    // [archetype][changed term] storage slots of the changed filters
+    column_table changed;
+    // [archetype][term] storage slot of every mutable term, -1 for read only terms and tags
+    column_table written;
+    const ecs_query *query;
+    const storage_index *storages;
+    const resource_index *resources;
+    const sparse_index *sparse;
+    const system_index *index;
+    struct ecs_iterator iterator;
     ecs_system system;
+    // runners of the same level have no conflicting access and can run at the same time
+    uint32_t level;
+    bool parallel;
+    // rows written by this run get tick, the changed filters pass rows written after last_tick
+    uint32_t tick;
+    uint32_t last_tick;
+    // depths version the archetypes were ordered with, hierarchy runners sort again when the index has a newer one
+    uint32_t depth_version;
+    // per step scratch of parallel runners, one iterator per row range
+    range_list ranges;
+    pointer_list range_columns;
+    job_batch range_batch;
 };
 
+typedef struct
+{
+    query_runner *runner;
+    const storage_index *storages;
+    double delta_time;
+} system_job;
+
 cff_arr_dcltype(query_list, ecs_query *);
 cff_arr_impl(query_list, ecs_query *);
 
 cff_arr_dcltype(runner_list, query_runner);
 cff_arr_impl(runner_list, query_runner);
 
-cff_hash_dcltype(query_map, ecs_query *, query_id);
-cff_hash_impl(query_map, ecs_query *, query_id);
-
-static uint32_t hash_key_fn(ecs_query **key, uint32_t seed)
-{
-    const component_id *components_ref = ecs_query_get_components(*key);
-    uint32_t count = ecs_query_get_count(*key);
-
-    uint32_t hash_value = seed;
-
-    for (size_t i = 0; i < count; i++)
-    {
-        component_id id = components_ref[i];
-        uint32_t index = component_id_index(id);
-        // Mix the bits of the current integer into the hash value
-        hash_value ^= index;
-        hash_value *= 0x9e3779b1; // A prime number for mixing
-    }
+cff_arr_dcltype(schedule_list, query_id);
+cff_arr_impl(schedule_list, query_id);
 
-    return hash_value;
-}
+cff_arr_dcltype(system_job_list, system_job);
+cff_arr_impl(system_job_list, system_job);
 
-static bool cmp_key_fn(ecs_query **key_a, ecs_query **key_b)
-{
-    uint32_t count_a = ecs_query_get_count(*key_a);
-    uint32_t count_b = ecs_query_get_count(*key_b);
-
-    const component_id *components_ref_a = ecs_query_get_components(*key_a);
-    const component_id *components_ref_b = ecs_query_get_components(*key_b);
-
-    if (count_a != count_b)
-        return false;
-
-    for (size_t i = 0; i < count_a; i++)
-    {
-        if (components_ref_a[i] != components_ref_b[i])
-            return false;
-    }
-    return true;
-}
-
-static bool cmp_data_fn(query_id *value_a, query_id *value_b)
-{
-    return *value_a == *value_b;
-}
+cff_arr_dcltype(cache_list, query_runner *);
+cff_arr_impl(cache_list, query_runner *);
 
 struct system_index
 {
-    query_map query_index;
     query_list queries;
+    // runners without a system, iterated on demand by ecs_world_query_iter
+    cache_list caches;
     runner_list runners;
+    // runner ids ordered by level
+    schedule_list schedule;
+    system_job_list jobs;
+    job_batch batch;
     const storage_index *storage_index;
+    const resource_index *resources;
+    const sparse_index *sparse;
+    const pair_index *pairs;
+    const shared_index *shared;
+    // archetype depths owned by the world, the version changes every time they are set
+    const uint32_t *depths;
+    uint32_t depth_count;
+    uint32_t depth_version;
+    component_id prefab;
 };
 
-static void query_runner_init(query_runner *runner, ecs_system system, archetype_id *archetypes, uint32_t lenght);
+static bool system_index_matches(const system_index *index, const ecs_query *query, const cff_bitset *mask);
+static void query_runner_init(query_runner *runner, const system_index *index, const ecs_query *query, ecs_system system, archetype_id *archetypes, uint32_t lenght);
 static void query_runner_release(query_runner *runner);
-static void query_runner_add_arch(query_runner *runner, archetype_id archetype);
+static void query_runner_add_arch(query_runner *runner, archetype_id archetype, const ecs_storage *storage);
+static void query_runner_run(query_runner *runner, const storage_index *storages, double delta_time);
+static void query_runner_run_parallel(query_runner *runner, const storage_index *storages, double delta_time);
+static void query_runner_run_ranges(query_runner *runner, const storage_index *storages, uint32_t first, uint32_t last, double delta_time);
+static uint32_t query_runner_depth(const query_runner *runner, uint32_t position);
+static void query_runner_sort_by_depth(query_runner *runner);
+static void column_table_swap(column_table *table, uint32_t a, uint32_t b, uint32_t stride);
+static uint32_t query_runner_range_rows(uint32_t rows);
+static void range_job_run(void *data);
+static bool query_runner_filters(const query_runner *runner);
+static void query_runner_bind(struct ecs_iterator *it, const int32_t *columns, uint32_t first, uint32_t lenght);
+static void query_runner_invoke(const query_runner *runner, struct ecs_iterator *it, const int32_t *columns, const int32_t *slots, const int32_t *changed, const int32_t *written, uint32_t lenght, double delta_time);
+static void query_runner_begin(query_runner *runner);
+static bool query_runner_chunk_changed(const query_runner *runner, const ecs_storage *storage, uint32_t chunk, const int32_t *changed);
+static uint32_t query_runner_next_run(const query_runner *runner, const ecs_storage *storage, uint32_t chunk, const int32_t *slots, const int32_t *changed, uint32_t row, uint32_t end, uint32_t *first_out);
+static uint32_t query_runner_next_sparse_run(const query_runner *runner, const ecs_storage *storage, uint32_t chunk, uint32_t row, uint32_t end, uint32_t *first_out);
+static bool query_runner_sparse_matches(const query_runner *runner, entity_id entity);
+static bool query_runner_has_sparse(const query_runner *runner);
+static bool query_runner_has_row_tags(const query_runner *runner);
+static void query_runner_mark_written(const query_runner *runner, const struct ecs_iterator *it, const int32_t *written);
+static bool query_runner_conflicts(const query_runner *runner_a, const query_runner *runner_b);
+static bool query_runner_resources_conflict(const query_runner *runner_a, const query_runner *runner_b);
+static bool query_runner_changed_conflict(const query_runner *reader, const query_runner *writer);
+static void system_index_schedule(system_index *index, query_id id);
+static void system_job_run(void *data);
+static bool query_runner_next(struct ecs_iterator *it);
+static void query_runner_reset(query_runner *runner);
 
-system_index *ecs_system_index_new(const storage_index *storage_index, const uint32_t capacity)
+system_index *ecs_system_index_new(const storage_index *storage_index, const resource_index *resources, const sparse_index *sparse, const pair_index *pairs, const shared_index *shared, const uint32_t capacity)
 {
     if (storage_index == NULL)
         return NULL;
@@ -91,13 +161,27 @@ system_index *ecs_system_index_new(const storage_index *storage_index, const uin
     if (index == NULL)
         return NULL;
 
-    query_map_init(&(index->query_index), capacity, hash_key_fn, cmp_key_fn, cmp_data_fn);
-
     query_list_init(&(index->queries), capacity);
 
+    cache_list_init(&(index->caches), 0);
+
     runner_list_init(&(index->runners), capacity);
 
+    schedule_list_init(&(index->schedule), capacity);
+
+    system_job_list_init(&(index->jobs), capacity);
+
+    job_batch_init(&(index->batch), capacity);
+
     index->storage_index = storage_index;
+    index->resources = resources;
+    index->sparse = sparse;
+    index->pairs = pairs;
+    index->shared = shared;
+    index->depths = NULL;
+    index->depth_count = 0;
+    index->depth_version = 1;
+    index->prefab = INVALID_ID;
 
     return index;
 }
@@ -113,10 +197,18 @@ void ecs_system_index_release(system_index *index)
         }
     }
 
-    query_map_release(&(index->query_index));
-
     query_list_release(&(index->queries));
 
+    for (size_t i = 0; i < index->caches.count; i++)
+    {
+        query_runner *cache = cache_list_get(&(index->caches), i);
+        ecs_query_release(cache->query);
+        query_runner_release(cache);
+        CFF_RELEASE(cache);
+    }
+
+    cache_list_release(&(index->caches));
+
     for (size_t i = 0; i < index->runners.count; i++)
     {
         query_runner *runner = runner_list_get_ref(&(index->runners), i);
@@ -126,100 +218,486 @@ void ecs_system_index_release(system_index *index)
 
     runner_list_release(&(index->runners));
 
+    schedule_list_release(&(index->schedule));
+
+    system_job_list_release(&(index->jobs));
+
+    job_batch_release(&(index->batch));
+
     CFF_RELEASE(index);
 }
 
-void ecs_system_index_add(system_index *index, ecs_query *query, archetype_id *archetypes, uint32_t archetypes_count, ecs_system system)
+void ecs_system_index_add(system_index *index, ecs_query *query, archetype_id *archetypes, uint32_t archetypes_count, ecs_system system, bool parallel)
 {
-
-    if (query_map_exist(&(index->query_index), query) != 0)
-        return;
-
     query_id id = 0;
     query_list_add_i(&(index->queries), query, &id);
 
-    query_map_add(&(index->query_index), query, id);
-
     query_runner runner = {0};
 
-    query_runner_init(&runner, system, archetypes, archetypes_count);
+    query_runner_init(&runner, index, query, system, archetypes, archetypes_count);
+    runner.parallel = parallel;
 
     runner_list_add_at(&(index->runners), runner, id);
+
+    system_index_schedule(index, id);
+}
+
+static void system_index_schedule(system_index *index, query_id id)
+{
+    query_runner *runner = runner_list_get_ref(&(index->runners), id);
+
+    // systems keep the registration order between each other when they conflict
+    runner->level = 0;
+    for (query_id i = 0; i < id; i++)
+    {
+        query_runner *previous = runner_list_get_ref(&(index->runners), i);
+        if (previous->level >= runner->level && query_runner_conflicts(previous, runner))
+            runner->level = previous->level + 1;
+    }
+
+    schedule_list_add(&(index->schedule), id);
+
+    uint32_t position = index->schedule.count - 1;
+    while (position > 0)
+    {
+        query_id previous_id = schedule_list_get(&(index->schedule), position - 1);
+        if (runner_list_get_ref(&(index->runners), previous_id)->level <= runner->level)
+            break;
+        index->schedule.buffer[position] = previous_id;
+        index->schedule.buffer[position - 1] = id;
+        position--;
+    }
+}
+
+void ecs_system_index_add_archetype(system_index *index, archetype_id archetype, const cff_bitset *mask)
+{
+    const ecs_storage *storage = ecs_storage_index_get(index->storage_index, archetype);
+
+    // runner i was built from query i
+    for (uint32_t i = 0; i < index->runners.count; i++)
+    {
+        query_runner *runner = runner_list_get_ref(&(index->runners), i);
+
+        if (system_index_matches(index, runner->query, mask))
+            query_runner_add_arch(runner, archetype, storage);
+    }
+
+    for (uint32_t i = 0; i < index->caches.count; i++)
+    {
+        query_runner *cache = cache_list_get(&(index->caches), i);
+
+        if (system_index_matches(index, cache->query, mask))
+            query_runner_add_arch(cache, archetype, storage);
+    }
 }
 
-static bool a_contains_b(const component_id *a_arr, uint32_t size_a, const component_id *b_arr, uint32_t size_b)
+void ecs_system_index_set_prefab(system_index *index, component_id prefab)
 {
-    uint32_t i = 0, j = 0;
+    index->prefab = prefab;
+}
 
-    while (i < size_a && j < size_b)
+static bool system_index_matches(const system_index *index, const ecs_query *query, const cff_bitset *mask)
+{
+    if (index->prefab != INVALID_ID && cff_bitset_test(mask, component_id_index(index->prefab)) && !ecs_query_requires(query, index->prefab))
+        return false;
+    return ecs_query_matches(query, mask);
+}
+
+void ecs_system_index_set_depths(system_index *index, const uint32_t *depths, uint32_t count)
+{
+    index->depths = depths;
+    index->depth_count = count;
+    index->depth_version++;
+}
+
+ecs_iterator *ecs_system_index_get_cache(system_index *index, const ecs_query *query)
+{
+    for (uint32_t i = 0; i < index->caches.count; i++)
     {
-        if (a_arr[i] == b_arr[j])
+        query_runner *cache = cache_list_get(&(index->caches), i);
+        if (cache->query == query)
         {
-            j++; // Move to the next element in B
+            query_runner_reset(cache);
+            return &(cache->iterator);
         }
-        i++; // Move to the next element in A
     }
 
-    return (j == size_b);
+    return NULL;
+}
+
+ecs_iterator *ecs_system_index_add_cache(system_index *index, ecs_query *query, archetype_id *archetypes, uint32_t archetypes_count)
+{
+    // runners are referenced by the iterators handed out, they must not move when the list grows
+    query_runner *cache = (query_runner *)CFF_ALLOC(sizeof(query_runner), "QUERY CACHE");
+    if (cache == NULL)
+        return NULL;
+
+    *cache = (query_runner){0};
+    query_runner_init(cache, index, query, NULL, archetypes, archetypes_count);
+    cache_list_add(&(index->caches), cache);
+
+    query_runner_reset(cache);
+    return &(cache->iterator);
 }
 
-void ecs_system_index_add_archetype(system_index *index, archetype_id archetype, const component_id *components, uint32_t component_count)
+void ecs_system_step(system_index *index, double delta_time)
 {
-    for (uint32_t i = 0; i < index->queries.count; i++)
+    uint32_t start = 0;
+
+    while (start < index->schedule.count)
     {
-        ecs_query *query = query_list_get(&(index->queries), i);
-        const component_id *query_components = ecs_query_get_components(query);
-        uint32_t query_components_count = ecs_query_get_count(query);
+        uint32_t level = runner_list_get_ref(&(index->runners), schedule_list_get(&(index->schedule), start))->level;
+        uint32_t end = start + 1;
+
+        while (end < index->schedule.count && runner_list_get_ref(&(index->runners), schedule_list_get(&(index->schedule), end))->level == level)
+            end++;
 
-        bool archetype_valid = a_contains_b(components, component_count, query_components, query_components_count);
+        // ticks are taken before the level starts, in schedule order
+        for (uint32_t i = start; i < end; i++)
+            query_runner_begin(runner_list_get_ref(&(index->runners), schedule_list_get(&(index->schedule), i)));
 
-        if (archetype_valid)
+        if (end - start == 1)
+        {
+            query_runner_run(runner_list_get_ref(&(index->runners), schedule_list_get(&(index->schedule), start)), index->storage_index, delta_time);
+        }
+        else
         {
-            query_id q_id;
-            if (query_map_get(&(index->query_index), query, &q_id))
+            index->jobs.count = 0;
+            for (uint32_t i = start; i < end; i++)
             {
-                query_runner *runner = runner_list_get_ref(&(index->runners), q_id);
-                query_runner_add_arch(runner, archetype);
+                system_job job = {
+                    .runner = runner_list_get_ref(&(index->runners), schedule_list_get(&(index->schedule), i)),
+                    .storages = index->storage_index,
+                    .delta_time = delta_time,
+                };
+                system_job_list_add(&(index->jobs), job);
             }
+
+            // jobs is fully built before taking references to its entries
+            index->batch.count = 0;
+            for (uint32_t i = 0; i < index->jobs.count; i++)
+            {
+                caff_job job = {.function = system_job_run, .data = system_job_list_get_ref(&(index->jobs), i)};
+                job_batch_add(&(index->batch), job);
+            }
+
+            caff_job_counter counter = {0};
+            caff_jobs_run(index->batch.buffer, index->batch.count, &counter);
+            caff_jobs_wait(&counter);
         }
+
+        start = end;
     }
 }
 
-void ecs_system_step(system_index *index, double delta_time)
+static void system_job_run(void *data)
 {
-    for (size_t i = 0; i < index->runners.count; i++)
+    system_job *job = (system_job *)data;
+    query_runner_run(job->runner, job->storages, job->delta_time);
+}
+
+static void query_runner_run(query_runner *runner, const storage_index *storages, double delta_time)
+{
+    if (runner->parallel)
     {
-        query_runner *runner = runner_list_get_ref(&(index->runners), i);
-        if (runner == NULL)
+        query_runner_run_parallel(runner, storages, delta_time);
+        return;
+    }
+
+    struct ecs_iterator *it = &(runner->iterator);
+    uint32_t term_count = it->column_count;
+    uint32_t changed_count = ecs_query_get_changed_count(runner->query);
+
+    for (size_t j = 0; j < runner->archetypes.count; j++)
+    {
+        archetype_id arch = archetype_list_get(&(runner->archetypes), j);
+        const ecs_storage *storage = ecs_storage_index_get(storages, arch);
+        const int32_t *columns = column_table_get_ref(&(runner->columns), j * term_count);
+        const int32_t *slots = column_table_get_ref(&(runner->filters), j * term_count);
+        const int32_t *changed = column_table_get_ref(&(runner->changed), j * changed_count);
+        const int32_t *written = column_table_get_ref(&(runner->written), j * term_count);
+        uint32_t chunk_count = ecs_storage_chunk_count(storage);
+
+        it->storage = storage;
+
+        for (uint32_t chunk = 0; chunk < chunk_count; chunk++)
         {
-            continue;
+            uint32_t entity_count = ecs_storage_chunk_rows(storage, chunk);
+            if (entity_count == 0 || !query_runner_chunk_changed(runner, storage, chunk, changed))
+                continue;
+
+            it->chunk = chunk;
+            query_runner_bind(it, columns, 0, entity_count);
+            query_runner_invoke(runner, it, columns, slots, changed, written, entity_count, delta_time);
+        }
+    }
+}
+
+static void query_runner_run_parallel(query_runner *runner, const storage_index *storages, double delta_time)
+{
+    if (!(ecs_query_get_flags(runner->query) & ECS_QUERY_HIERARCHY))
+    {
+        query_runner_run_ranges(runner, storages, 0, runner->archetypes.count, delta_time);
+        return;
+    }
+
+    // parents are done before their children start, only the archetypes of the same depth run at the same time
+    uint32_t first = 0;
+    while (first < runner->archetypes.count)
+    {
+        uint32_t depth = query_runner_depth(runner, first);
+        uint32_t last = first + 1;
+
+        while (last < runner->archetypes.count && query_runner_depth(runner, last) == depth)
+            last++;
+
+        query_runner_run_ranges(runner, storages, first, last, delta_time);
+        first = last;
+    }
+}
+
+static void query_runner_run_ranges(query_runner *runner, const storage_index *storages, uint32_t first, uint32_t last, double delta_time)
+{
+    uint32_t term_count = runner->iterator.column_count;
+    uint32_t changed_count = ecs_query_get_changed_count(runner->query);
+    uint32_t range_count = 0;
+
+    for (size_t j = first; j < last; j++)
+    {
+        const ecs_storage *storage = ecs_storage_index_get(storages, archetype_list_get(&(runner->archetypes), j));
+        const int32_t *changed = column_table_get_ref(&(runner->changed), j * changed_count);
+        uint32_t chunk_count = ecs_storage_chunk_count(storage);
+
+        for (uint32_t chunk = 0; chunk < chunk_count; chunk++)
+        {
+            if (!query_runner_chunk_changed(runner, storage, chunk, changed))
+                continue;
+
+            uint32_t rows = ecs_storage_chunk_rows(storage, chunk);
+            uint32_t range_rows = query_runner_range_rows(rows);
+            range_count += (rows + range_rows - 1) / range_rows;
         }
+    }
+
+    if (range_count == 0)
+        return;
 
-        for (size_t j = 0; j < runner->archetypes.count; j++)
+    // iterators point into range_columns, it must not move while ranges are built
+    if (runner->range_columns.capacity < range_count * term_count)
+        pointer_list_resize(&(runner->range_columns), range_count * term_count);
+    runner->range_columns.count = range_count * term_count;
+
+    runner->ranges.count = 0;
+    runner->range_batch.count = 0;
+
+    for (size_t j = first; j < last; j++)
+    {
+        const ecs_storage *storage = ecs_storage_index_get(storages, archetype_list_get(&(runner->archetypes), j));
+        const int32_t *columns = column_table_get_ref(&(runner->columns), j * term_count);
+        const int32_t *slots = column_table_get_ref(&(runner->filters), j * term_count);
+        const int32_t *changed = column_table_get_ref(&(runner->changed), j * changed_count);
+        const int32_t *written = column_table_get_ref(&(runner->written), j * term_count);
+        uint32_t chunk_count = ecs_storage_chunk_count(storage);
+
+        for (uint32_t chunk = 0; chunk < chunk_count; chunk++)
         {
-            archetype_id arch = archetype_list_get(&(runner->archetypes), j);
-            query_it it = ecs_storage_index_get(index->storage_index, arch);
-            uint32_t entity_count = ecs_storage_count(it);
+            if (!query_runner_chunk_changed(runner, storage, chunk, changed))
+                continue;
+
+            uint32_t rows = ecs_storage_chunk_rows(storage, chunk);
+            uint32_t range_rows = query_runner_range_rows(rows);
 
-            if (entity_count > 0)
+            for (uint32_t offset = 0; offset < rows; offset += range_rows)
             {
-                runner->system(it, entity_count, delta_time);
+                range_job range = {
+                    .runner = runner,
+                    .iterator = {
+                        .storage = storage,
+                        .chunk = chunk,
+                        .offset = offset,
+                        .columns = runner->range_columns.buffer + runner->ranges.count * term_count,
+                        .column_count = term_count,
+                        .resources = runner->iterator.resources,
+                        .resource_count = runner->iterator.resource_count,
+                        .sparse = runner->sparse,
+                        .pairs = runner->iterator.pairs,
+                        .shared = runner->iterator.shared,
+                        .count = rows - offset < range_rows ? rows - offset : range_rows,
+                    },
+                    .columns = columns,
+                    .filters = slots,
+                    .changed = changed,
+                    .written = written,
+                    .lenght = rows - offset < range_rows ? rows - offset : range_rows,
+                    .delta_time = delta_time,
+                };
+
+                for (uint32_t t = 0; t < term_count; t++)
+                {
+                    void *column = ecs_storage_get_chunk_column(storage, chunk, columns[t]);
+                    if (column != NULL)
+                        column = (void *)((uintptr_t)column + offset * ecs_storage_get_column_size(storage, columns[t]));
+                    range.iterator.columns[t] = column;
+                }
+
+                range_list_add(&(runner->ranges), range);
             }
         }
     }
+
+    if (runner->ranges.count == 1)
+    {
+        range_job_run(range_list_get_ref(&(runner->ranges), 0));
+        return;
+    }
+
+    for (uint32_t i = 0; i < runner->ranges.count; i++)
+    {
+        caff_job job = {.function = range_job_run, .data = range_list_get_ref(&(runner->ranges), i)};
+        job_batch_add(&(runner->range_batch), job);
+    }
+
+    caff_job_counter counter = {0};
+    caff_jobs_run(runner->range_batch.buffer, runner->range_batch.count, &counter);
+    caff_jobs_wait(&counter);
+}
+
+static uint32_t query_runner_range_rows(uint32_t rows)
+{
+    // a few ranges per thread so faster threads can pick up the slack
+    uint32_t target = rows / ((caff_jobs_worker_count() + 1) * 4);
+
+    // ranges start on multiples of the simd alignment so split columns stay aligned
+    target = (target + ECS_SIMD_ALIGNMENT - 1) & ~(uint32_t)(ECS_SIMD_ALIGNMENT - 1);
+
+    return target > PARALLEL_MIN_ROWS ? target : PARALLEL_MIN_ROWS;
+}
+
+static void range_job_run(void *data)
+{
+    range_job *range = (range_job *)data;
+    query_runner_invoke(range->runner, &(range->iterator), range->columns, range->filters, range->changed, range->written, range->lenght, range->delta_time);
+}
+
+static bool query_runner_changed_conflict(const query_runner *reader, const query_runner *writer)
+{
+    // changed filters read the ticks the writer stamps, even for components they have no term for
+    const component_id *changed = ecs_query_get_changed(reader->query);
+    uint32_t changed_count = ecs_query_get_changed_count(reader->query);
+
+    const component_id *terms = ecs_query_get_terms(writer->query);
+    const ecs_term_access *access = ecs_query_get_terms_access(writer->query);
+    uint32_t count = ecs_query_get_terms_count(writer->query);
+
+    for (uint32_t i = 0; i < changed_count; i++)
+    {
+        for (uint32_t j = 0; j < count; j++)
+        {
+            if (changed[i] == terms[j] && access[j] == ECS_ACCESS_READ_WRITE)
+                return true;
+        }
+    }
+
+    return false;
 }
 
-static void query_runner_init(query_runner *runner, ecs_system system, archetype_id *archetypes, uint32_t lenght)
+static bool query_runner_conflicts(const query_runner *runner_a, const query_runner *runner_b)
+{
+    const component_id *terms_a = ecs_query_get_terms(runner_a->query);
+    const ecs_term_access *access_a = ecs_query_get_terms_access(runner_a->query);
+    uint32_t count_a = ecs_query_get_terms_count(runner_a->query);
+
+    const component_id *terms_b = ecs_query_get_terms(runner_b->query);
+    const ecs_term_access *access_b = ecs_query_get_terms_access(runner_b->query);
+    uint32_t count_b = ecs_query_get_terms_count(runner_b->query);
+
+    if (query_runner_resources_conflict(runner_a, runner_b))
+        return true;
+
+    if (query_runner_changed_conflict(runner_a, runner_b) || query_runner_changed_conflict(runner_b, runner_a))
+        return true;
+
+    for (uint32_t i = 0; i < count_a; i++)
+    {
+        // tags have no data to race on
+        if (component_id_is_tag(terms_a[i]))
+            continue;
+
+        for (uint32_t j = 0; j < count_b; j++)
+        {
+            if (terms_a[i] != terms_b[j])
+                continue;
+
+            if (access_a[i] == ECS_ACCESS_READ_WRITE || access_b[j] == ECS_ACCESS_READ_WRITE)
+                return true;
+        }
+    }
+
+    return false;
+}
+
+static bool query_runner_resources_conflict(const query_runner *runner_a, const query_runner *runner_b)
+{
+    const component_id *resources_a = ecs_query_get_resources(runner_a->query);
+    const ecs_term_access *access_a = ecs_query_get_resources_access(runner_a->query);
+    uint32_t count_a = ecs_query_get_resources_count(runner_a->query);
+
+    const component_id *resources_b = ecs_query_get_resources(runner_b->query);
+    const ecs_term_access *access_b = ecs_query_get_resources_access(runner_b->query);
+    uint32_t count_b = ecs_query_get_resources_count(runner_b->query);
+
+    for (uint32_t i = 0; i < count_a; i++)
+    {
+        for (uint32_t j = 0; j < count_b; j++)
+        {
+            if (resources_a[i] == resources_b[j] && (access_a[i] == ECS_ACCESS_READ_WRITE || access_b[j] == ECS_ACCESS_READ_WRITE))
+                return true;
+        }
+    }
+
+    return false;
+}
+
+static void query_runner_init(query_runner *runner, const system_index *index, const ecs_query *query, ecs_system system, archetype_id *archetypes, uint32_t lenght)
 {
     if (runner == NULL)
         return;
 
+    uint32_t term_count = ecs_query_get_terms_count(query);
+    uint32_t resource_count = ecs_query_get_resources_count(query);
+    const storage_index *storages = index->storage_index;
+
+    runner->query = query;
+    runner->storages = storages;
+    runner->resources = index->resources;
+    runner->sparse = index->sparse;
+    runner->index = index;
+    runner->iterator = (struct ecs_iterator){
+        .storage = NULL,
+        .columns = (void **)CFF_ALLOC(sizeof(void *) * (term_count ? term_count : 1), "QUERY RUNNER COLUMNS"),
+        .column_count = term_count,
+        .resources = resource_count ? (void **)CFF_ALLOC(sizeof(void *) * resource_count, "QUERY RUNNER RESOURCES") : NULL,
+        .resource_count = resource_count,
+        .sparse = index->sparse,
+        .pairs = index->pairs,
+        .shared = index->shared,
+        .source = runner,
+        .next = query_runner_next,
+    };
+
     archetype_list_init(&(runner->archetypes), lenght);
+    column_table_init(&(runner->columns), lenght * term_count);
+    column_table_init(&(runner->filters), lenght * term_count);
+    column_table_init(&(runner->changed), lenght * ecs_query_get_changed_count(query));
+    column_table_init(&(runner->written), lenght * term_count);
+    range_list_init(&(runner->ranges), 0);
+    pointer_list_init(&(runner->range_columns), 0);
+    job_batch_init(&(runner->range_batch), 0);
 
     for (size_t i = 0; i < lenght; i++)
     {
         archetype_id arch = archetypes[i];
-        archetype_list_add(&(runner->archetypes), arch);
+        query_runner_add_arch(runner, arch, ecs_storage_index_get(storages, arch));
     }
 
     runner->system = system;
@@ -228,12 +706,366 @@ static void query_runner_init(query_runner *runner, ecs_system system, archetype
 static void query_runner_release(query_runner *runner)
 {
     archetype_list_release(&(runner->archetypes));
+    column_table_release(&(runner->columns));
+    column_table_release(&(runner->filters));
+    column_table_release(&(runner->changed));
+    column_table_release(&(runner->written));
+    range_list_release(&(runner->ranges));
+    pointer_list_release(&(runner->range_columns));
+    job_batch_release(&(runner->range_batch));
+    CFF_RELEASE(runner->iterator.columns);
+    if (runner->iterator.resources != NULL)
+        CFF_RELEASE(runner->iterator.resources);
     runner->system = NULL;
 }
 
-static void query_runner_add_arch(query_runner *runner, archetype_id archetype)
+static void query_runner_reset(query_runner *runner)
+{
+    // every reset starts a new run of the cached query
+    query_runner_begin(runner);
+
+    struct ecs_iterator *it = &(runner->iterator);
+    it->storage = NULL;
+    it->cursor = 0;
+    it->chunk = 0;
+    it->offset = 0;
+    it->count = 0;
+}
+
+static bool query_runner_next(struct ecs_iterator *it)
+{
+    query_runner *runner = (query_runner *)it->source;
+    uint32_t term_count = it->column_count;
+    uint32_t changed_count = ecs_query_get_changed_count(runner->query);
+
+    // continue after the rows handed out last
+    uint32_t chunk = it->chunk;
+    uint32_t row = it->offset + it->count;
+
+    while (it->cursor < runner->archetypes.count)
+    {
+        const ecs_storage *storage = ecs_storage_index_get(runner->storages, archetype_list_get(&(runner->archetypes), it->cursor));
+        const int32_t *columns = column_table_get_ref(&(runner->columns), it->cursor * term_count);
+        const int32_t *slots = column_table_get_ref(&(runner->filters), it->cursor * term_count);
+        const int32_t *changed = column_table_get_ref(&(runner->changed), it->cursor * changed_count);
+        const int32_t *written = column_table_get_ref(&(runner->written), it->cursor * term_count);
+        uint32_t chunk_count = ecs_storage_chunk_count(storage);
+
+        for (; chunk < chunk_count; chunk++, row = 0)
+        {
+            uint32_t rows = ecs_storage_chunk_rows(storage, chunk);
+            uint32_t first = row;
+            uint32_t lenght = 0;
+
+            if (row < rows && query_runner_chunk_changed(runner, storage, chunk, changed))
+                lenght = query_runner_next_run(runner, storage, chunk, slots, changed, row, rows, &first);
+
+            if (lenght == 0)
+                continue;
+
+            it->storage = storage;
+            it->chunk = chunk;
+            query_runner_bind(it, columns, first, lenght);
+
+            // the caller may write every mutable column it gets
+            query_runner_mark_written(runner, it, written);
+            return true;
+        }
+
+        it->cursor++;
+        chunk = 0;
+        row = 0;
+    }
+
+    it->count = 0;
+    return false;
+}
+
+static bool query_runner_filters(const query_runner *runner)
+{
+    // aligned queries get whole chunks, a run could start anywhere
+    return (ecs_query_get_flags(runner->query) & (ECS_QUERY_INCLUDE_DISABLED | ECS_QUERY_SIMD_ALIGNED)) == 0;
+}
+
+static void query_runner_bind(struct ecs_iterator *it, const int32_t *columns, uint32_t first, uint32_t lenght)
+{
+    for (uint32_t t = 0; t < it->column_count; t++)
+    {
+        void *column = ecs_storage_get_chunk_column(it->storage, it->chunk, columns[t]);
+        if (column != NULL)
+            column = (void *)((uintptr_t)column + first * ecs_storage_get_column_size(it->storage, columns[t]));
+        it->columns[t] = column;
+    }
+
+    it->offset = first;
+    it->count = lenght;
+}
+
+static void query_runner_invoke(const query_runner *runner, struct ecs_iterator *it, const int32_t *columns, const int32_t *slots, const int32_t *changed, const int32_t *written, uint32_t lenght, double delta_time)
+{
+    bool changes = ecs_query_get_changed_count(runner->query) > 0 && !(ecs_query_get_flags(runner->query) & ECS_QUERY_SIMD_ALIGNED);
+
+    if (!changes && !query_runner_has_sparse(runner) && !query_runner_has_row_tags(runner) && (!query_runner_filters(runner) || !ecs_storage_has_disabled(it->storage)))
+    {
+        it->count = lenght;
+        runner->system(it, lenght, delta_time);
+        query_runner_mark_written(runner, it, written);
+        return;
+    }
+
+    // the system only sees the enabled and changed runs of the rows it was given
+    uint32_t row = it->offset;
+    uint32_t end = it->offset + lenght;
+    uint32_t first = 0;
+    uint32_t run = 0;
+
+    while ((run = query_runner_next_run(runner, it->storage, it->chunk, slots, changed, row, end, &first)) > 0)
+    {
+        query_runner_bind(it, columns, first, run);
+        runner->system(it, run, delta_time);
+        query_runner_mark_written(runner, it, written);
+        row = first + run;
+    }
+}
+
+static void query_runner_begin(query_runner *runner)
+{
+    runner->last_tick = runner->tick;
+    runner->tick = ecs_storage_index_next_tick((storage_index *)runner->storages);
+
+    // resources can be set or removed between runs
+    const component_id *resources = ecs_query_get_resources(runner->query);
+    for (uint32_t i = 0; i < runner->iterator.resource_count; i++)
+        runner->iterator.resources[i] = ecs_resource_index_get(runner->resources, resources[i]);
+
+    if ((ecs_query_get_flags(runner->query) & ECS_QUERY_HIERARCHY) && runner->depth_version != runner->index->depth_version)
+        query_runner_sort_by_depth(runner);
+}
+
+static uint32_t query_runner_depth(const query_runner *runner, uint32_t position)
+{
+    archetype_id archetype = archetype_list_get(&(runner->archetypes), position);
+    return archetype < runner->index->depth_count ? runner->index->depths[archetype] : 0;
+}
+
+static void query_runner_sort_by_depth(query_runner *runner)
+{
+    uint32_t term_count = runner->iterator.column_count;
+    uint32_t changed_count = ecs_query_get_changed_count(runner->query);
+
+    // stable insertion sort, depths rarely change between runs so the list is almost always in order already
+    for (uint32_t i = 1; i < runner->archetypes.count; i++)
+    {
+        for (uint32_t j = i; j > 0 && query_runner_depth(runner, j - 1) > query_runner_depth(runner, j); j--)
+        {
+            archetype_id archetype = runner->archetypes.buffer[j];
+            runner->archetypes.buffer[j] = runner->archetypes.buffer[j - 1];
+            runner->archetypes.buffer[j - 1] = archetype;
+
+            // the column tables follow their archetype
+            column_table_swap(&(runner->columns), j - 1, j, term_count);
+            column_table_swap(&(runner->filters), j - 1, j, term_count);
+            column_table_swap(&(runner->written), j - 1, j, term_count);
+            column_table_swap(&(runner->changed), j - 1, j, changed_count);
+        }
+    }
+
+    runner->depth_version = runner->index->depth_version;
+}
+
+static void column_table_swap(column_table *table, uint32_t a, uint32_t b, uint32_t stride)
+{
+    for (uint32_t i = 0; i < stride; i++)
+    {
+        int32_t value = table->buffer[a * stride + i];
+        table->buffer[a * stride + i] = table->buffer[b * stride + i];
+        table->buffer[b * stride + i] = value;
+    }
+}
+
+static bool query_runner_chunk_changed(const query_runner *runner, const ecs_storage *storage, uint32_t chunk, const int32_t *changed)
+{
+    uint32_t changed_count = ecs_query_get_changed_count(runner->query);
+    return changed_count == 0 || ecs_storage_chunk_changed(storage, chunk, changed, changed_count, runner->last_tick);
+}
+
+static uint32_t query_runner_next_run(const query_runner *runner, const ecs_storage *storage, uint32_t chunk, const int32_t *slots, const int32_t *changed, uint32_t row, uint32_t end, uint32_t *first_out)
+{
+    uint32_t changed_count = ecs_query_get_changed_count(runner->query);
+    bool enabled_only = query_runner_filters(runner) && ecs_storage_has_disabled(storage);
+
+    // aligned queries get whole chunks, a run could start anywhere
+    if (ecs_query_get_flags(runner->query) & ECS_QUERY_SIMD_ALIGNED)
+        changed_count = 0;
+
+    while (row < end)
+    {
+        uint32_t first = row;
+        uint32_t lenght = end - row;
+
+        if (enabled_only)
+            lenght = ecs_storage_next_enabled_run(storage, chunk, slots, runner->iterator.column_count, row, end, &first);
+
+        if (lenght == 0)
+            return 0;
+
+        uint32_t run_end = first + lenght;
+
+        // the changed rows inside the enabled run, the next enabled run when there are none
+        if (changed_count > 0)
+        {
+            lenght = ecs_storage_next_changed_run(storage, chunk, changed, changed_count, runner->last_tick, first, run_end, &first);
+            if (lenght == 0)
+            {
+                row = run_end;
+                continue;
+            }
+            run_end = first + lenght;
+        }
+
+        // the rows holding the row tags, a bitmask scan over the tag bits of the storage
+        if (query_runner_has_row_tags(runner))
+        {
+            lenght = ecs_storage_next_tagged_run(storage, chunk, ecs_query_get_row_tags(runner->query), ecs_query_get_row_tags_count(runner->query),
+                                                 ecs_query_get_row_tags_without(runner->query), ecs_query_get_row_tags_without_count(runner->query), first, run_end, &first);
+            if (lenght == 0)
+            {
+                row = run_end;
+                continue;
+            }
+            run_end = first + lenght;
+        }
+
+        // then the rows whose entities pass the sparse terms
+        if (query_runner_has_sparse(runner))
+        {
+            lenght = query_runner_next_sparse_run(runner, storage, chunk, first, run_end, &first);
+            if (lenght == 0)
+            {
+                row = run_end;
+                continue;
+            }
+        }
+
+        *first_out = first;
+        return lenght;
+    }
+
+    return 0;
+}
+
+static uint32_t query_runner_next_sparse_run(const query_runner *runner, const ecs_storage *storage, uint32_t chunk, uint32_t row, uint32_t end, uint32_t *first_out)
+{
+    const entity_id *ids = ecs_storage_get_chunk_ids(storage, chunk);
+
+    while (row < end && !query_runner_sparse_matches(runner, ids[row]))
+        row++;
+
+    uint32_t first = row;
+    while (row < end && query_runner_sparse_matches(runner, ids[row]))
+        row++;
+
+    *first_out = first;
+    return row - first;
+}
+
+static bool query_runner_sparse_matches(const query_runner *runner, entity_id entity)
+{
+    const component_id *sparse = ecs_query_get_sparse(runner->query);
+    uint32_t sparse_count = ecs_query_get_sparse_count(runner->query);
+
+    for (uint32_t i = 0; i < sparse_count; i++)
+    {
+        if (!ecs_sparse_index_has(runner->sparse, sparse[i], entity))
+            return false;
+    }
+
+    const component_id *without = ecs_query_get_sparse_without(runner->query);
+    uint32_t without_count = ecs_query_get_sparse_without_count(runner->query);
+
+    for (uint32_t i = 0; i < without_count; i++)
+    {
+        if (ecs_sparse_index_has(runner->sparse, without[i], entity))
+            return false;
+    }
+
+    return true;
+}
+
+static bool query_runner_has_sparse(const query_runner *runner)
+{
+    // aligned queries get whole chunks, their systems check the sparse terms themselves
+    if (ecs_query_get_flags(runner->query) & ECS_QUERY_SIMD_ALIGNED)
+        return false;
+    return ecs_query_get_sparse_count(runner->query) + ecs_query_get_sparse_without_count(runner->query) > 0;
+}
+
+static bool query_runner_has_row_tags(const query_runner *runner)
+{
+    // aligned queries get whole chunks, their systems check the row tags with ecs_iterator_has_row_tag
+    if (ecs_query_get_flags(runner->query) & ECS_QUERY_SIMD_ALIGNED)
+        return false;
+    return ecs_query_get_row_tags_count(runner->query) + ecs_query_get_row_tags_without_count(runner->query) > 0;
+}
+
+static void query_runner_mark_written(const query_runner *runner, const struct ecs_iterator *it, const int32_t *written)
+{
+    uint32_t row = ecs_storage_chunk_first_row(it->storage, it->chunk) + it->offset;
+
+    for (uint32_t t = 0; t < it->column_count; t++)
+    {
+        if (written[t] >= 0)
+            ecs_storage_mark_changed((ecs_storage *)it->storage, written[t], row, it->count, runner->tick);
+    }
+}
+
+static void query_runner_add_arch(query_runner *runner, archetype_id archetype, const ecs_storage *storage)
 {
+    const component_id *terms = ecs_query_get_terms(runner->query);
+    uint32_t term_count = ecs_query_get_terms_count(runner->query);
+    const component_id *required = ecs_query_get_components(runner->query);
+    uint32_t required_count = ecs_query_get_count(runner->query);
+
+    if ((ecs_query_get_flags(runner->query) & ECS_QUERY_SIMD_ALIGNED) && ecs_storage_get_alignment(storage) < ECS_SIMD_ALIGNMENT)
+    {
+        caff_log_warn("[SYSTEM INDEX] Archetype %" PRIu64 " skipped: storage columns are not SIMD aligned\n", archetype);
+        return;
+    }
+
     archetype_list_add(&(runner->archetypes), archetype);
+    runner->depth_version = 0;
+
+    for (uint32_t t = 0; t < term_count; t++)
+    {
+        int32_t column = storage != NULL ? ecs_storage_get_column_index(storage, terms[t]) : -1;
+        column_table_add(&(runner->columns), column);
+
+        int32_t slot = -1;
+        for (uint32_t r = 0; r < required_count && storage != NULL; r++)
+        {
+            if (required[r] == terms[t])
+                slot = ecs_storage_get_component_slot(storage, terms[t]);
+        }
+        column_table_add(&(runner->filters), slot);
+
+        int32_t written = -1;
+        if (storage != NULL && column >= 0 && ecs_query_get_terms_access(runner->query)[t] == ECS_ACCESS_READ_WRITE)
+            written = ecs_storage_get_component_slot(storage, terms[t]);
+        column_table_add(&(runner->written), written);
+    }
+
+    const component_id *changed = ecs_query_get_changed(runner->query);
+    uint32_t changed_count = ecs_query_get_changed_count(runner->query);
+
+    for (uint32_t c = 0; c < changed_count; c++)
+    {
+        int32_t slot = storage != NULL ? ecs_storage_get_component_slot(storage, changed[c]) : -1;
+        column_table_add(&(runner->changed), slot);
+
+        // the storage starts keeping ticks for the slot, its current rows count as changed once
+        if (slot >= 0)
+            ecs_storage_track_changes((ecs_storage *)storage, slot);
+    }
 }
 // static void query_runner_rem_arch(query_runner *runner, archetype_id archetype)
 // {
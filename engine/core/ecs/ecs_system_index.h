@@ -4,10 +4,23 @@
 
 typedef struct system_index system_index;
 typedef struct storage_index storage_index;
+typedef struct resource_index resource_index;
+typedef struct sparse_index sparse_index;
+typedef struct pair_index pair_index;
+typedef struct shared_index shared_index;
+typedef struct cff_bitset cff_bitset;
 
-system_index *ecs_system_index_new(const storage_index *const storage_index, uint32_t capacity);
+system_index *ecs_system_index_new(const storage_index *const storage_index, const resource_index *const resources, const sparse_index *const sparse, const pair_index *const pairs, const shared_index *const shared, uint32_t capacity);
 void ecs_system_index_release(system_index *index);
 
-void ecs_system_index_add(system_index *index, ecs_query *query, archetype_id *archetypes, uint32_t archetypes_count, ecs_system system);
-void ecs_system_index_add_archetype(system_index *index, archetype_id archetype, const component_id *components, uint32_t component_count);
+void ecs_system_index_add(system_index *index, ecs_query *query, archetype_id *archetypes, uint32_t archetypes_count, ecs_system system, bool parallel);
+void ecs_system_index_add_archetype(system_index *index, archetype_id archetype, const cff_bitset *mask);
+// depth of every archetype in the ChildOf hierarchy, ECS_QUERY_HIERARCHY runners order their archetypes by it on their next run,
+// archetypes past count are roots
+void ecs_system_index_set_depths(system_index *index, const uint32_t *depths, uint32_t count);
+// archetypes with the prefab tag only reach the queries requiring it
+void ecs_system_index_set_prefab(system_index *index, component_id prefab);
+// cached queries, the returned iterator is reset to the first matched chunk
+ecs_iterator *ecs_system_index_get_cache(system_index *index, const ecs_query *query);
+ecs_iterator *ecs_system_index_add_cache(system_index *index, ecs_query *query, archetype_id *archetypes, uint32_t archetypes_count);
 void ecs_system_step(system_index *index, double delta_time);
\ No newline at end of file
@@ -6,6 +6,9 @@
 
 #define MAX_NAME_LENGHT 128
 
+// every storage column starts on this boundary and is padded to a multiple of it
+#define ECS_SIMD_ALIGNMENT 64
+
 typedef union
 {
     struct
@@ -20,8 +23,10 @@ typedef union
 typedef uint64_t component_id;
 typedef uint64_t archetype_id;
 typedef uint64_t entity_id;
-typedef const struct ecs_storage *const query_it;
+typedef const struct ecs_iterator *const query_it;
+typedef struct ecs_iterator ecs_iterator;
 typedef struct ecs_query ecs_query;
+typedef struct ecs_world ecs_world;
 
 typedef struct
 {
@@ -30,16 +35,91 @@ typedef struct
     uint32_t capacity;
 } ecs_archetype;
 
+// lifecycle of components owning resources, every hook gets count contiguous elements of a column
+// without hooks rows are left uninitialized, copied and relocated with memcpy and dropped as they are
+typedef struct
+{
+    void (*ctor)(void *data, uint32_t count);
+    void (*dtor)(void *data, uint32_t count);
+    void (*copy)(void *dst, const void *src, uint32_t count);
+    // only needed by types that can't be relocated with memcpy, the source is not destroyed afterwards
+    void (*move)(void *dst, void *src, uint32_t count);
+} ecs_type_info;
+
 typedef enum
 {
     COMPONENT_REGULAR = 0,
     COMPONENT_TAG = ((uint16_t)1 << 15),
+    // kept in a sparse set per component instead of the archetype tables, adding or removing it never moves the entity
+    COMPONENT_SPARSE = ((uint16_t)1 << 14),
+    // tag kept as one bit per row of the storage the entity lives in, adding or removing it never moves the entity
+    COMPONENT_ROW_TAG = ((uint16_t)1 << 13),
+    // (relation, target) pair, registered by the world the first time the pair is asked for
+    COMPONENT_PAIR = ((uint16_t)1 << 12),
+    // component with one value per group of entities, rows only hold a tag of their value and entities sharing it share a storage
+    COMPONENT_SHARED = ((uint16_t)1 << 11),
 } component_type;
 
+typedef enum
+{
+    ECS_QUERY_DEFAULT = 0,
+    // columns handed to the system start on ECS_SIMD_ALIGNMENT and can be read up to the next multiple of it
+    // aligned queries also get the disabled rows, the system checks them with ecs_iterator_is_enabled
+    ECS_QUERY_SIMD_ALIGNED = (1 << 0),
+    // rows of disabled entities and components are handed to the system too
+    ECS_QUERY_INCLUDE_DISABLED = (1 << 1),
+    // storages are visited breadth first, parents before the entities that are ChildOf them
+    ECS_QUERY_HIERARCHY = (1 << 2),
+} ecs_query_flags;
+
+typedef enum
+{
+    ECS_ACCESS_READ_WRITE = 0,
+    // systems that only read a component can run in parallel with each other
+    ECS_ACCESS_READ = 1,
+} ecs_term_access;
+
+typedef enum
+{
+    ECS_STORAGE_LINEAR = 0,
+    ECS_STORAGE_CHUNKED = 1,
+} ecs_storage_layout;
+
 extern const uint64_t INVALID_ID;
 
+// entity ids carry the slot index in the low 32 bits and the slot generation above it,
+// bit 63 is left out of the generation so it can mark deferred entities
+#define ECS_ENTITY_GENERATION_MASK 0x7fffffffu
+
+static inline uint32_t ecs_entity_index_of(entity_id entity)
+{
+    return (uint32_t)(entity & 0xffffffffu);
+}
+
+static inline uint32_t ecs_entity_generation_of(entity_id entity)
+{
+    return (uint32_t)(entity >> 32) & ECS_ENTITY_GENERATION_MASK;
+}
+
+static inline entity_id ecs_entity_make(uint32_t index, uint32_t generation)
+{
+    return ((entity_id)(generation & ECS_ENTITY_GENERATION_MASK) << 32) | index;
+}
+
 typedef void (*ecs_system)(query_it iterator, uint32_t lenght, double delta_time);
 
+typedef enum
+{
+    // the entity started matching the observer, by creation or by a component added
+    ECS_ON_ADD = 0,
+    // the entity stopped matching the observer, destroyed entities are no longer alive when it is delivered
+    ECS_ON_REMOVE = 1,
+    ECS_ON_SET = 2,
+} ecs_observer_event;
+
+// entities that triggered the same observer since the last flush, component is the one set for ECS_ON_SET
+typedef void (*ecs_observer)(ecs_world *world, const entity_id *entities, uint32_t count, component_id component, void *context);
+
 CAFF_API ecs_archetype ecs_create_archetype(uint32_t len);
 
 CAFF_API void ecs_archetype_add(ecs_archetype *const arch_mut_ref, component_id id);
@@ -67,4 +147,24 @@ inline uint32_t component_id_index(component_id id)
 inline uint32_t component_id_is_tag(component_id id)
 {
     return ((*(component_id_metadata *)(&id)).flags & COMPONENT_TAG) != 0;
+}
+
+inline uint32_t component_id_is_sparse(component_id id)
+{
+    return ((*(component_id_metadata *)(&id)).flags & COMPONENT_SPARSE) != 0;
+}
+
+inline uint32_t component_id_is_row_tag(component_id id)
+{
+    return ((*(component_id_metadata *)(&id)).flags & COMPONENT_ROW_TAG) != 0;
+}
+
+inline uint32_t component_id_is_pair(component_id id)
+{
+    return ((*(component_id_metadata *)(&id)).flags & COMPONENT_PAIR) != 0;
+}
+
+inline uint32_t component_id_is_shared(component_id id)
+{
+    return ((*(component_id_metadata *)(&id)).flags & COMPONENT_SHARED) != 0;
 }
\ No newline at end of file
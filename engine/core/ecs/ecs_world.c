@@ -1,4 +1,6 @@
 #include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
 #include "ecs_world.h"
 #include "ecs_storage.h"
 #include "component_dependency.h"
@@ -7,8 +9,55 @@
 #include "ecs_storage_index.h"
 #include "ecs_entity_index.h"
 #include "ecs_system_index.h"
+#include "ecs_observer_index.h"
+#include "ecs_resource_index.h"
+#include "ecs_sparse_index.h"
+#include "ecs_pair_index.h"
+#include "ecs_shared_index.h"
+#include "ecs_command_buffer.h"
 #include "../caffeine_memory.h"
 #include "../caffeine_logging.h"
+#include "../caffeine_jobs.h"
+#include "../caffeine_time.h"
+#include "../ds/caffeine_vector.h"
+#include "../ds/caffeine_bitset.h"
+
+// longest pair name, "(relation,target)" with the target printed as a number
+#define ECS_PAIR_NAME_SIZE 128
+// longest shared value name, "(component,#value)"
+#define ECS_SHARED_NAME_SIZE 128
+
+// archetype depths while the hierarchy is being updated
+#define HIERARCHY_DEPTH_UNKNOWN 0xffffffffu
+#define HIERARCHY_DEPTH_VISITING 0xfffffffeu
+
+typedef struct
+{
+    entity_id entity;
+    uint32_t buffer;
+    uint32_t command;
+    // entity created for a deferred handle, kept on the first command of its group
+    entity_id resolved;
+} pending_command;
+
+typedef struct
+{
+    entity_id entity;
+    archetype_id from;
+    archetype_id to;
+    bool destroyed;
+    // range of the entity commands in the sorted pending list
+    uint32_t first;
+    uint32_t count;
+    // last parent command when its parent is a deferred handle, UINT32_MAX otherwise
+    uint32_t deferred_parent;
+} entity_change;
+
+cff_arr_dcltype(pending_list, pending_command);
+cff_arr_impl(pending_list, pending_command);
+
+cff_arr_dcltype(change_list, entity_change);
+cff_arr_impl(change_list, entity_change);
 
 struct ecs_world
 {
@@ -18,10 +67,61 @@ struct ecs_world
     component_dependency *dependencies_owning;
     entity_index *entities_owning;
     system_index *systems_owning;
+    observer_index *observers_owning;
+    resource_index *resources_owning;
+    sparse_index *sparse_owning;
+    pair_index *pairs_owning;
+    shared_index *shared_owning;
+
+    // built-in exclusive relation, the hierarchy orders archetypes by the depth of their ChildOf target
+    component_id child_of;
+    // depth of every generated archetype, updated before systems run once something moved a parent
+    uint32_t *depths;
+    uint32_t depth_capacity;
+    bool hierarchy_dirty;
+    // built-in tag of the template entities instantiated with ecs_world_instantiate
+    component_id prefab;
+
+    // one command buffer per job thread, structural changes are recorded there while deferred
+    ecs_command_buffer **command_buffers_owning;
+    uint32_t command_buffer_count;
+    pending_list pending_commands;
+    change_list entity_changes;
+    bool deferred;
+
+    // archetype the next ecs_world_compact call starts from
+    uint32_t compact_cursor;
 };
 
-static bool ecs_world_is_archetype_valid(const ecs_world *const world, archetype_id id, ecs_query *query);
+static bool ecs_world_is_archetype_valid(const ecs_world *const world, archetype_id id, const ecs_query *query);
+static uint32_t ecs_world_match_query(const ecs_world *const world_ref, const ecs_query *const query_ref, archetype_id **matched_out);
 static void ecs_world_setup_archetype(const ecs_world *const world_ref, archetype_id archetype_id);
+static void ecs_world_add_system(const ecs_world *const world_ref, ecs_query *query_owning, ecs_system system, bool parallel);
+static ecs_storage *ecs_world_get_or_setup_storage(const ecs_world *const world_ref, archetype_id archetype);
+static void ecs_world_move_entity(const ecs_world *const world_ref, entity_id entity, archetype_id next_archetype);
+static void ecs_world_move_entities(const ecs_world *const world_ref, archetype_id archetype, archetype_id next_archetype, int *rows, uint32_t count);
+static void ecs_world_change_entities_component(const ecs_world *const world_ref, const entity_id *ids, uint32_t count, component_id component, bool add);
+static void ecs_world_reserve_command_buffers(const ecs_world *const world_ref, uint32_t count);
+static void ecs_world_remove_entity(const ecs_world *const world_ref, entity_id id);
+static void ecs_world_remove_sparse_components(const ecs_world *const world_ref, entity_id entity);
+static void ecs_world_remove_row_tags(const ecs_world *const world_ref, ecs_storage *storage, int row, entity_id entity);
+static bool ecs_world_moves_entity(component_id component);
+static bool ecs_world_is_child_of(const ecs_world *const world_ref, component_id component);
+static component_id ecs_world_archetype_parent_pair(const ecs_world *const world_ref, archetype_id archetype);
+static bool ecs_world_is_shared(const ecs_world *const world_ref, component_id component);
+static component_id ecs_world_archetype_shared_value(const ecs_world *const world_ref, archetype_id archetype, component_id component);
+static component_id ecs_world_archetype_exclusive(const ecs_world *const world_ref, archetype_id archetype, component_id component);
+static archetype_id ecs_world_archetype_add(const ecs_world *const world_ref, archetype_id archetype, component_id component);
+static archetype_id ecs_world_archetype_remove(const ecs_world *const world_ref, archetype_id archetype, component_id component);
+static bool ecs_world_creates_cycle(const ecs_world *const world_ref, entity_id entity, component_id component);
+static archetype_id ecs_world_archetype_parent(const ecs_world *const world_ref, entity_id entity, archetype_id archetype, entity_id parent);
+static entity_id ecs_world_resolve_deferred(const pending_list *const pending_ref, entity_id handle);
+static void ecs_world_parent_moved(const ecs_world *const world_ref, entity_id entity);
+static void ecs_world_remove_target(const ecs_world *const world_ref, entity_id target);
+static void ecs_world_update_hierarchy(const ecs_world *const world_ref);
+static bool ecs_world_is_prefab_archetype(const ecs_world *const world_ref, archetype_id archetype);
+static void ecs_world_copy_detached(const ecs_world *const world_ref, entity_id prefab, const entity_id *ids, uint32_t count);
+static uint32_t ecs_world_archetype_depth(const ecs_world *const world_ref, archetype_id archetype);
 
 ecs_world *ecs_world_new()
 {
@@ -75,10 +175,85 @@ ecs_world *ecs_world_new()
         return NULL;
     }
 
-    system_index *systems_owning = ecs_system_index_new(storages_owning, 64);
+    resource_index *resources_owning = ecs_resource_index_new(16);
+    if (resources_owning == NULL)
+    {
+        caff_log_error("[ECS_WORLD] World creation error: fail to init resource index\n");
+        ecs_entity_index_release(entities_owning);
+        ecs_storage_index_release(storages_owning);
+        ecs_component_dependency_release(dependencies_owning);
+        ecs_release_archetype_index(archetypes_owning);
+        ecs_release_component_index(components_owning);
+        return NULL;
+    }
+
+    sparse_index *sparse_owning = ecs_sparse_index_new(16);
+    if (sparse_owning == NULL)
+    {
+        caff_log_error("[ECS_WORLD] World creation error: fail to init sparse index\n");
+        ecs_resource_index_release(resources_owning);
+        ecs_entity_index_release(entities_owning);
+        ecs_storage_index_release(storages_owning);
+        ecs_component_dependency_release(dependencies_owning);
+        ecs_release_archetype_index(archetypes_owning);
+        ecs_release_component_index(components_owning);
+        return NULL;
+    }
+
+    pair_index *pairs_owning = ecs_pair_index_new(16);
+    if (pairs_owning == NULL)
+    {
+        caff_log_error("[ECS_WORLD] World creation error: fail to init pair index\n");
+        ecs_sparse_index_release(sparse_owning);
+        ecs_resource_index_release(resources_owning);
+        ecs_entity_index_release(entities_owning);
+        ecs_storage_index_release(storages_owning);
+        ecs_component_dependency_release(dependencies_owning);
+        ecs_release_archetype_index(archetypes_owning);
+        ecs_release_component_index(components_owning);
+        return NULL;
+    }
+
+    shared_index *shared_owning = ecs_shared_index_new(16);
+    if (shared_owning == NULL)
+    {
+        caff_log_error("[ECS_WORLD] World creation error: fail to init shared index\n");
+        ecs_pair_index_release(pairs_owning);
+        ecs_sparse_index_release(sparse_owning);
+        ecs_resource_index_release(resources_owning);
+        ecs_entity_index_release(entities_owning);
+        ecs_storage_index_release(storages_owning);
+        ecs_component_dependency_release(dependencies_owning);
+        ecs_release_archetype_index(archetypes_owning);
+        ecs_release_component_index(components_owning);
+        return NULL;
+    }
+
+    system_index *systems_owning = ecs_system_index_new(storages_owning, resources_owning, sparse_owning, pairs_owning, shared_owning, 64);
     if (systems_owning == NULL)
     {
         caff_log_error("[ECS_WORLD] World creation error: fail to init system index\n");
+        ecs_shared_index_release(shared_owning);
+        ecs_pair_index_release(pairs_owning);
+        ecs_sparse_index_release(sparse_owning);
+        ecs_resource_index_release(resources_owning);
+        ecs_entity_index_release(entities_owning);
+        ecs_storage_index_release(storages_owning);
+        ecs_component_dependency_release(dependencies_owning);
+        ecs_release_archetype_index(archetypes_owning);
+        ecs_release_component_index(components_owning);
+        return NULL;
+    }
+
+    observer_index *observers_owning = ecs_observer_index_new(archetypes_owning, 16);
+    if (observers_owning == NULL)
+    {
+        caff_log_error("[ECS_WORLD] World creation error: fail to init observer index\n");
+        ecs_system_index_release(systems_owning);
+        ecs_shared_index_release(shared_owning);
+        ecs_pair_index_release(pairs_owning);
+        ecs_sparse_index_release(sparse_owning);
+        ecs_resource_index_release(resources_owning);
         ecs_entity_index_release(entities_owning);
         ecs_storage_index_release(storages_owning);
         ecs_component_dependency_release(dependencies_owning);
@@ -92,6 +267,12 @@ ecs_world *ecs_world_new()
     if (world_owning == NULL)
     {
         caff_log_error("[ECS_WORLD] World creation error: fail to allocate world memory\n");
+        ecs_observer_index_release(observers_owning);
+        ecs_system_index_release(systems_owning);
+        ecs_shared_index_release(shared_owning);
+        ecs_pair_index_release(pairs_owning);
+        ecs_sparse_index_release(sparse_owning);
+        ecs_resource_index_release(resources_owning);
         ecs_entity_index_release(entities_owning);
         ecs_storage_index_release(storages_owning);
         ecs_component_dependency_release(dependencies_owning);
@@ -107,25 +288,108 @@ ecs_world *ecs_world_new()
         .dependencies_owning = dependencies_owning,
         .entities_owning = entities_owning,
         .systems_owning = systems_owning,
+        .observers_owning = observers_owning,
+        .resources_owning = resources_owning,
+        .sparse_owning = sparse_owning,
+        .pairs_owning = pairs_owning,
+        .shared_owning = shared_owning,
+        .child_of = INVALID_ID,
+        .depths = NULL,
+        .depth_capacity = 0,
+        .hierarchy_dirty = false,
+        .prefab = INVALID_ID,
+        .command_buffers_owning = NULL,
+        .command_buffer_count = 0,
+        .deferred = false,
+        .compact_cursor = 0,
     };
 
+    pending_list_init(&(world_owning->pending_commands), 64);
+    change_list_init(&(world_owning->entity_changes), 64);
+
+    world_owning->child_of = ecs_world_add_tag(world_owning, "ChildOf");
+    world_owning->prefab = ecs_world_add_tag(world_owning, "Prefab");
+    ecs_system_index_set_prefab(systems_owning, world_owning->prefab);
+
     return world_owning;
 }
 
 void ecs_world_release(const ecs_world *const world_owning)
 {
+    for (uint32_t i = 0; i < world_owning->command_buffer_count; i++)
+    {
+        ecs_command_buffer_release(world_owning->command_buffers_owning[i]);
+    }
+    if (world_owning->command_buffers_owning != NULL)
+        CFF_RELEASE(world_owning->command_buffers_owning);
+    pending_list_release((pending_list *)&(world_owning->pending_commands));
+    change_list_release((change_list *)&(world_owning->entity_changes));
+
+    ecs_observer_index_release(world_owning->observers_owning);
     ecs_system_index_release(world_owning->systems_owning);
+    ecs_resource_index_release(world_owning->resources_owning);
+    ecs_sparse_index_release(world_owning->sparse_owning);
     ecs_entity_index_release(world_owning->entities_owning);
     ecs_storage_index_release(world_owning->storages_owning);
     ecs_component_dependency_release(world_owning->dependencies_owning);
     ecs_release_archetype_index(world_owning->archetypes_owning);
     ecs_release_component_index(world_owning->components_owning);
+    // the component and storage name tables pointed to the pair and shared value names
+    ecs_pair_index_release(world_owning->pairs_owning);
+    ecs_shared_index_release(world_owning->shared_owning);
+    if (world_owning->depths != NULL)
+        CFF_RELEASE(world_owning->depths);
     CFF_RELEASE(world_owning);
 }
 
 void ecs_world_step(const ecs_world *const world_ref, double delta_time)
 {
+    ecs_world *world_mut_ref = (ecs_world *)world_ref;
+
+    ecs_world_reserve_command_buffers(world_ref, caff_jobs_worker_count() + 1);
+    ecs_world_update_hierarchy(world_ref);
+
+    // storages must not change while systems iterate them
+    world_mut_ref->deferred = true;
     ecs_system_step(world_ref->systems_owning, delta_time);
+    world_mut_ref->deferred = false;
+
+    ecs_world_flush_commands(world_ref);
+}
+
+void ecs_world_set_storage_layout(const ecs_world *const world_ref, ecs_storage_layout layout)
+{
+    // only storages created after this call use the new layout
+    ecs_storage_index_set_layout(world_ref->storages_owning, layout);
+}
+
+bool ecs_world_compact(const ecs_world *const world_ref, uint32_t budget_us)
+{
+    if (world_ref->deferred)
+    {
+        caff_log_warn("[ECS_WORLD] Storages can't be compacted while systems are running\n");
+        return false;
+    }
+
+    ecs_world *world_mut_ref = (ecs_world *)world_ref;
+    uint32_t capacity = ecs_storage_index_capacity(world_ref->storages_owning);
+    double deadline = caff_time_precise() + budget_us / 1e6;
+
+    // storages left as they were cost nothing, the budget is checked after each one compacted so every call makes progress
+    while (world_mut_ref->compact_cursor < capacity)
+    {
+        ecs_storage *storage = ecs_storage_index_get(world_ref->storages_owning, world_mut_ref->compact_cursor);
+        world_mut_ref->compact_cursor++;
+
+        if (storage != NULL && ecs_storage_compact(storage) && caff_time_precise() >= deadline)
+            break;
+    }
+
+    if (world_mut_ref->compact_cursor < capacity)
+        return false;
+
+    world_mut_ref->compact_cursor = 0;
+    return true;
 }
 
 #pragma region COMPONENT
@@ -135,14 +399,124 @@ component_id ecs_world_get_component(const ecs_world *const world_ref, const cha
     return ecs_get_component_id(world_ref->components_owning, name);
 }
 
-component_id ecs_world_add_component(const ecs_world *const world_ref, const char *name, size_t size, size_t align)
+component_id ecs_world_add_component(const ecs_world *const world_ref, const char *name, size_t size, size_t align, const ecs_type_info *const hooks)
 {
-    return ecs_register_component(world_ref->components_owning, name, COMPONENT_REGULAR, size, align);
+    return ecs_register_component(world_ref->components_owning, name, COMPONENT_REGULAR, size, align, hooks);
+}
+
+component_id ecs_world_add_sparse_component(const ecs_world *const world_ref, const char *name, size_t size, size_t align, const ecs_type_info *const hooks)
+{
+    component_id component = ecs_register_component(world_ref->components_owning, name, COMPONENT_SPARSE, size, align, hooks);
+
+    if (component != INVALID_ID && component_id_is_sparse(component))
+        ecs_sparse_index_add_component(world_ref->sparse_owning, component, size, align, hooks);
+
+    return component;
 }
 
 component_id ecs_world_add_tag(const ecs_world *const world_ref, const char *name)
 {
-    return ecs_register_component(world_ref->components_owning, name, COMPONENT_TAG, 0, 0);
+    return ecs_register_component(world_ref->components_owning, name, COMPONENT_TAG, 0, 0, NULL);
+}
+
+component_id ecs_world_add_row_tag(const ecs_world *const world_ref, const char *name)
+{
+    return ecs_register_component(world_ref->components_owning, name, (component_type)(COMPONENT_TAG | COMPONENT_ROW_TAG), 0, 0, NULL);
+}
+
+component_id ecs_world_add_shared_component(const ecs_world *const world_ref, const char *name, size_t size, size_t align, const ecs_type_info *const hooks)
+{
+    // archetypes only get the tag, the size and hooks are used by its values
+    return ecs_register_component(world_ref->components_owning, name, (component_type)(COMPONENT_TAG | COMPONENT_SHARED), size, align, hooks);
+}
+
+component_id ecs_world_shared_value(const ecs_world *const world_ref, component_id component, const void *data)
+{
+    if (!ecs_world_is_shared(world_ref, component))
+    {
+        caff_log_warn("[ECS_WORLD] Shared values must be given for shared components\n");
+        return INVALID_ID;
+    }
+
+    size_t size = ecs_get_component_size(world_ref->components_owning, component);
+    component_id value = ecs_shared_index_find(world_ref->shared_owning, component, data, size);
+    if (value != INVALID_ID)
+        return value;
+
+    // the name tables keep the pointer, the shared index owns the name
+    char *name = (char *)CFF_ALLOC(ECS_SHARED_NAME_SIZE, "SHARED VALUE NAME");
+    if (name == NULL)
+        return INVALID_ID;
+    snprintf(name, ECS_SHARED_NAME_SIZE, "(%s,#%u)", ecs_get_component_name(world_ref->components_owning, component), ecs_shared_index_count(world_ref->shared_owning));
+
+    value = ecs_register_component(world_ref->components_owning, name, (component_type)(COMPONENT_TAG | COMPONENT_SHARED), 0, 0, NULL);
+    if (value == INVALID_ID || !component_id_is_shared(value))
+    {
+        caff_log_warn("[ECS_WORLD] Shared value %s could not be registered\n", name);
+        CFF_RELEASE(name);
+        return INVALID_ID;
+    }
+
+    size_t align = ecs_get_component_align(world_ref->components_owning, component);
+    const ecs_type_info *hooks = ecs_get_component_hooks(world_ref->components_owning, component);
+    ecs_shared_index_add(world_ref->shared_owning, component, value, data, size, align, hooks, name);
+    return value;
+}
+
+component_id ecs_world_pair(const ecs_world *const world_ref, component_id relation, entity_id target)
+{
+    component_id pair = ecs_pair_index_get(world_ref->pairs_owning, relation, target);
+    if (pair != INVALID_ID)
+        return pair;
+
+    if (relation == INVALID_ID || component_id_is_sparse(relation) || component_id_is_row_tag(relation) || component_id_is_pair(relation) || component_id_is_shared(relation))
+    {
+        caff_log_warn("[ECS_WORLD] Pair relations must be archetype components or tags\n");
+        return INVALID_ID;
+    }
+
+    if (!ecs_entity_index_is_alive(world_ref->entities_owning, target))
+    {
+        caff_log_warn("[ECS_WORLD] Pair target %" PRIu64 " is not alive\n", target);
+        return INVALID_ID;
+    }
+
+    // the name tables keep the pointer, the pair index owns the name
+    char *name = (char *)CFF_ALLOC(ECS_PAIR_NAME_SIZE, "PAIR NAME");
+    if (name == NULL)
+        return INVALID_ID;
+    snprintf(name, ECS_PAIR_NAME_SIZE, "(%s,%" PRIu64 ")", ecs_get_component_name(world_ref->components_owning, relation), target);
+
+    component_type type = (component_type)(COMPONENT_PAIR | (component_id_is_tag(relation) ? COMPONENT_TAG : COMPONENT_REGULAR));
+    size_t size = ecs_get_component_size(world_ref->components_owning, relation);
+    size_t align = ecs_get_component_align(world_ref->components_owning, relation);
+    const ecs_type_info *hooks = ecs_get_component_hooks(world_ref->components_owning, relation);
+
+    pair = ecs_register_component(world_ref->components_owning, name, type, size, align, hooks);
+    if (pair == INVALID_ID || !component_id_is_pair(pair))
+    {
+        caff_log_warn("[ECS_WORLD] Pair %s could not be registered\n", name);
+        CFF_RELEASE(name);
+        return INVALID_ID;
+    }
+
+    ecs_pair_index_add(world_ref->pairs_owning, pair, relation, target, name);
+    return pair;
+}
+
+component_id ecs_world_pair_relation(const ecs_world *const world_ref, component_id pair)
+{
+    return ecs_pair_index_relation(world_ref->pairs_owning, pair);
+}
+
+entity_id ecs_world_pair_target(const ecs_world *const world_ref, component_id pair)
+{
+    return ecs_pair_index_target(world_ref->pairs_owning, pair);
+}
+
+component_id ecs_world_child_of(const ecs_world *const world_ref)
+{
+    return world_ref->child_of;
 }
 
 void ecs_world_remove_component(const ecs_world *const world_ref, component_id id)
@@ -159,7 +533,12 @@ archetype_id ecs_world_add_archetype(const ecs_world *const world_ref, ecs_arche
 {
     archetype_id archetype_id = ecs_register_archetype(world_ref->archetypes_owning, archetype);
 
-    ecs_world_setup_archetype(world_ref, archetype_id);
+    // a new storage grows the column tables of the running systems under them, the flush or the first entity sets it up
+    if (world_ref->deferred)
+        return archetype_id;
+
+    // registering an existing archetype returns its id, it already has a storage
+    ecs_world_get_or_setup_storage(world_ref, archetype_id);
     return archetype_id;
 }
 
@@ -182,19 +561,17 @@ void ecs_world_remove_archetype(const ecs_world *const world_ref, archetype_id i
     ecs_storage_index_remove(world_ref->storages_owning, id);
 }
 
-static bool ecs_world_is_archetype_valid(const ecs_world *const world_ref, archetype_id id, ecs_query *query_ref)
+static bool ecs_world_is_archetype_valid(const ecs_world *const world_ref, archetype_id id, const ecs_query *query_ref)
 {
-    const component_id *comps = ecs_query_get_components(query_ref);
-    uint32_t comp_count = ecs_query_get_count(query_ref);
-    for (size_t j = 0; j < comp_count; j++)
-    {
-        component_id comp_id = comps[j];
-        if (!ecs_archetype_has_component(world_ref->archetypes_owning, id, comp_id))
-        {
-            return false;
-        }
-    }
-    return true;
+    const cff_bitset *mask = ecs_archetype_get_mask(world_ref->archetypes_owning, id);
+    if (mask == NULL)
+        return false;
+
+    // prefabs are templates, only queries requiring the tag iterate them
+    if (cff_bitset_test(mask, component_id_index(world_ref->prefab)) && !ecs_query_requires(query_ref, world_ref->prefab))
+        return false;
+
+    return ecs_query_matches(query_ref, mask);
 }
 
 static void ecs_world_setup_archetype(const ecs_world *const world_ref, archetype_id archetype_id)
@@ -205,9 +582,8 @@ static void ecs_world_setup_archetype(const ecs_world *const world_ref, archetyp
     const component_id *components = NULL;
     uint32_t compoennts_len = ecs_archetype_get_components(archetype_index, archetype_id, &components);
 
-    ecs_system_index_add_archetype(world_ref->systems_owning, archetype_id, components, compoennts_len);
-
     size_t *component_sizes = (size_t *)CFF_ALLOC(compoennts_len * sizeof(size_t), "STORAGE COMPONENTS SIZES");
+    size_t *component_aligns = (size_t *)CFF_ALLOC(compoennts_len * sizeof(size_t), "STORAGE COMPONENTS ALIGNS");
     component_id *components_copy = (component_id *)CFF_ALLOC(compoennts_len * sizeof(component_id), "STORAGE COMPONENTS");
     const char **component_names = (const char **)CFF_ALLOC(compoennts_len * sizeof(const char *), "STORAGE COMPONENTS NAMES");
 
@@ -215,12 +591,29 @@ static void ecs_world_setup_archetype(const ecs_world *const world_ref, archetyp
     {
         component_id component = components[i];
         components_copy[i] = component;
-        component_sizes[i] = ecs_get_component_size(world_ref->components_owning, component);
+        // tags keep no column, shared components only lend their size to their values
+        component_sizes[i] = component_id_is_tag(component) ? 0 : ecs_get_component_size(world_ref->components_owning, component);
+        component_aligns[i] = ecs_get_component_align(world_ref->components_owning, component);
         component_names[i] = ecs_get_component_name(world_ref->components_owning, component);
         ecs_component_dependency_add_dependency_for_component(dependency_index, component, archetype_id);
     }
 
-    ecs_storage_index_new_storage(world_ref->storages_owning, archetype_id, components_copy, component_sizes, component_names, compoennts_len);
+    ecs_storage_index_new_storage(world_ref->storages_owning, archetype_id, components_copy, component_sizes, component_aligns, component_names, compoennts_len);
+
+    // the storage is still empty, hooks only run for rows added from now on
+    ecs_storage *storage = ecs_storage_index_get(world_ref->storages_owning, archetype_id);
+    for (uint32_t i = 0; i < compoennts_len; i++)
+    {
+        const ecs_type_info *hooks = ecs_get_component_hooks(world_ref->components_owning, components[i]);
+        if (hooks != NULL && !component_id_is_tag(components[i]))
+            ecs_storage_set_hooks(storage, i, hooks);
+    }
+
+    // the storage must exist before the system index builds the query column tables
+    ecs_system_index_add_archetype(world_ref->systems_owning, archetype_id, ecs_archetype_get_mask(archetype_index, archetype_id));
+
+    // the new archetype has no depth yet
+    ((ecs_world *)world_ref)->hierarchy_dirty = true;
 }
 #pragma endregion
 
@@ -228,78 +621,1353 @@ static void ecs_world_setup_archetype(const ecs_world *const world_ref, archetyp
 
 entity_id ecs_world_create_entity(const ecs_world *const world_ref, archetype_id arhcetype_id)
 {
+    if (world_ref->deferred)
+        return ecs_command_buffer_create_entity(ecs_world_get_command_buffer(world_ref), arhcetype_id);
+
     entity_id entity_id = ecs_entity_index_new_entity(world_ref->entities_owning);
-    ecs_storage *storage = ecs_storage_index_get(world_ref->storages_owning, arhcetype_id);
+    ecs_storage *storage = ecs_world_get_or_setup_storage(world_ref, arhcetype_id);
     int row = ecs_storage_add_entity(storage, entity_id);
     ecs_entity_index_set_entity(world_ref->entities_owning, entity_id, arhcetype_id, row, storage);
+    ecs_observer_index_emit_transition(world_ref->observers_owning, INVALID_ID, arhcetype_id, &entity_id, 1);
     return entity_id;
 }
 
 void ecs_world_destroy_entity(const ecs_world *const world_ref, entity_id id)
+{
+    if (world_ref->deferred)
+    {
+        ecs_command_buffer_destroy_entity(ecs_world_get_command_buffer(world_ref), id);
+        return;
+    }
+
+    if (!ecs_entity_index_is_alive(world_ref->entities_owning, id))
+        return;
+
+    ecs_world_remove_entity(world_ref, id);
+    ecs_world_remove_target(world_ref, id);
+}
+
+static void ecs_world_remove_entity(const ecs_world *const world_ref, entity_id id)
 {
     entity_record record = ecs_entity_index_get_entity(world_ref->entities_owning, id);
-    entity_id moved_entity = ecs_storage_remove_entity(record.storage, record.row);
+    ecs_storage *storage = ecs_storage_index_get(world_ref->storages_owning, record.archetype);
+
+    ecs_world_remove_sparse_components(world_ref, id);
+    ecs_world_remove_row_tags(world_ref, storage, record.row, id);
+
+    entity_id moved_entity = ecs_storage_remove_entity(storage, record.row);
     ecs_entity_index_remove_entity(world_ref->entities_owning, id);
-    ecs_entity_index_set_entity(world_ref->entities_owning, moved_entity, record.row, record.archetype, record.storage);
+    ecs_observer_index_emit_transition(world_ref->observers_owning, record.archetype, INVALID_ID, &id, 1);
+
+    // the last entity of the storage took the removed row
+    if (moved_entity != INVALID_ID)
+        ecs_entity_index_set_entity(world_ref->entities_owning, moved_entity, record.archetype, record.row, storage);
+}
+
+void ecs_world_create_entities(const ecs_world *const world_ref, archetype_id arhcetype_id, uint32_t count, entity_id *out_ids)
+{
+    ecs_world_create_entities_with(world_ref, arhcetype_id, count, NULL, NULL, 0, out_ids);
+}
+
+void ecs_world_create_entities_with(const ecs_world *const world_ref, archetype_id arhcetype_id, uint32_t count, const component_id *components, const void *const *values, uint32_t values_count, entity_id *out_ids)
+{
+    if (count == 0)
+        return;
+
+    if (world_ref->deferred)
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            entity_id entity = ecs_world_create_entity(world_ref, arhcetype_id);
+            for (uint32_t v = 0; v < values_count; v++)
+                ecs_world_set_entity_component(world_ref, entity, components[v], (void *)values[v]);
+            if (out_ids != NULL)
+                out_ids[i] = entity;
+        }
+        return;
+    }
+
+    entity_id *ids = out_ids;
+    if (ids == NULL)
+        ids = (entity_id *)CFF_ALLOC(sizeof(entity_id) * count, "WORLD ENTITY BATCH");
+
+    ecs_storage *storage = ecs_world_get_or_setup_storage(world_ref, arhcetype_id);
+
+    ecs_entity_index_new_entities(world_ref->entities_owning, count, ids);
+    int first_row = ecs_storage_add_entities(storage, ids, count);
+    ecs_entity_index_set_entities(world_ref->entities_owning, ids, count, arhcetype_id, first_row, storage);
+
+    ecs_observer_index_emit_transition(world_ref->observers_owning, INVALID_ID, arhcetype_id, ids, count);
+
+    for (uint32_t v = 0; v < values_count; v++)
+    {
+        ecs_storage_fill_component(storage, first_row, count, components[v], values[v]);
+        ecs_observer_index_emit_set(world_ref->observers_owning, arhcetype_id, components[v], ids, count);
+    }
+
+    if (out_ids == NULL)
+        CFF_RELEASE(ids);
+}
+
+static int ecs_world_cmp_records(const void *a, const void *b)
+{
+    const entity_record *record_a = (const entity_record *)a;
+    const entity_record *record_b = (const entity_record *)b;
+
+    if (record_a->archetype != record_b->archetype)
+        return record_a->archetype < record_b->archetype ? -1 : 1;
+
+    // higher rows first, a swap-remove then never moves a row that is still waiting to be removed
+    if (record_a->row != record_b->row)
+        return record_a->row > record_b->row ? -1 : 1;
+    return 0;
+}
+
+void ecs_world_destroy_entities(const ecs_world *const world_ref, const entity_id *ids, uint32_t count)
+{
+    if (count == 0)
+        return;
+
+    if (world_ref->deferred)
+    {
+        for (uint32_t i = 0; i < count; i++)
+            ecs_world_destroy_entity(world_ref, ids[i]);
+        return;
+    }
+
+    entity_record *records = (entity_record *)CFF_ALLOC(sizeof(entity_record) * count, "WORLD DESTROY BATCH");
+    uint32_t alive_count = 0;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (ecs_entity_index_is_alive(world_ref->entities_owning, ids[i]))
+        {
+            records[alive_count] = ecs_entity_index_get_entity(world_ref->entities_owning, ids[i]);
+            alive_count++;
+        }
+    }
+
+    qsort(records, alive_count, sizeof(entity_record), ecs_world_cmp_records);
+
+    ecs_storage *storage = NULL;
+    archetype_id storage_archetype = INVALID_ID;
+
+    for (uint32_t i = 0; i < alive_count; i++)
+    {
+        // an entity passed twice is removed once, its row already holds another entity
+        if (i > 0 && records[i].archetype == records[i - 1].archetype && records[i].row == records[i - 1].row)
+            continue;
+
+        if (records[i].archetype != storage_archetype)
+        {
+            storage_archetype = records[i].archetype;
+            storage = ecs_storage_index_get(world_ref->storages_owning, storage_archetype);
+        }
+
+        entity_id entity = ecs_storage_get_entity(storage, records[i].row);
+        ecs_world_remove_sparse_components(world_ref, entity);
+        ecs_world_remove_row_tags(world_ref, storage, records[i].row, entity);
+        ecs_observer_index_emit_transition(world_ref->observers_owning, storage_archetype, INVALID_ID, &entity, 1);
+
+        entity_id moved_entity = ecs_storage_remove_entity(storage, records[i].row);
+
+        if (moved_entity != INVALID_ID)
+            ecs_entity_index_set_entity(world_ref->entities_owning, moved_entity, storage_archetype, records[i].row, storage);
+    }
+
+    ecs_entity_index_remove_entities(world_ref->entities_owning, ids, count);
+
+    // children are looked up once the whole batch is gone
+    for (uint32_t i = 0; i < count; i++)
+        ecs_world_remove_target(world_ref, ids[i]);
+
+    CFF_RELEASE(records);
+}
+
+bool ecs_world_entity_alive(const ecs_world *const world_ref, entity_id entity)
+{
+    return ecs_entity_index_is_alive(world_ref->entities_owning, entity);
 }
 
 void *ecs_world_get_entity_component(const ecs_world *const world_ref, entity_id entity, component_id component)
 {
+    if (!ecs_entity_index_is_alive(world_ref->entities_owning, entity))
+        return NULL;
+
+    if (component_id_is_sparse(component))
+        return ecs_sparse_index_get(world_ref->sparse_owning, component, entity);
+
     entity_record record = ecs_entity_index_get_entity(world_ref->entities_owning, entity);
-    return ecs_storage_get_component(record.storage, record.row, component);
+
+    // the value is shared by the whole storage, writing to it would change every entity of the group
+    if (ecs_world_is_shared(world_ref, component))
+        return (void *)ecs_shared_index_get(world_ref->shared_owning, ecs_world_archetype_shared_value(world_ref, record.archetype, component));
+
+    ecs_storage *storage = ecs_storage_index_get(world_ref->storages_owning, record.archetype);
+    return ecs_storage_get_component(storage, record.row, component);
 }
 
 void ecs_world_set_entity_component(const ecs_world *const world_ref, entity_id entity, component_id component, void *data)
 {
+    if (world_ref->deferred)
+    {
+        size_t size = ecs_get_component_size(world_ref->components_owning, component);
+        ecs_command_buffer_set_component(ecs_world_get_command_buffer(world_ref), entity, component, data, size);
+        return;
+    }
+
+    if (!ecs_entity_index_is_alive(world_ref->entities_owning, entity))
+        return;
+
+    if (component_id_is_sparse(component))
+    {
+        if (!ecs_sparse_index_has(world_ref->sparse_owning, component, entity))
+            return;
+
+        ecs_sparse_index_set(world_ref->sparse_owning, component, entity, data);
+        ecs_observer_index_emit_component(world_ref->observers_owning, ECS_ON_SET, component, &entity, 1);
+        return;
+    }
+
+    // setting a shared component moves the entity to the storage of the value
+    if (ecs_world_is_shared(world_ref, component))
+    {
+        component_id value = ecs_world_shared_value(world_ref, component, data);
+        if (value == INVALID_ID)
+            return;
+
+        ecs_world_add_entity_component(world_ref, entity, value);
+        entity_record record = ecs_entity_index_get_entity(world_ref->entities_owning, entity);
+        ecs_observer_index_emit_set(world_ref->observers_owning, record.archetype, component, &entity, 1);
+        return;
+    }
+
     entity_record record = ecs_entity_index_get_entity(world_ref->entities_owning, entity);
-    ecs_storage_set_component(record.storage, record.row, component, data);
+    ecs_storage *storage = ecs_storage_index_get(world_ref->storages_owning, record.archetype);
+    ecs_storage_set_component(storage, record.row, component, data);
+    ecs_observer_index_emit_set(world_ref->observers_owning, record.archetype, component, &entity, 1);
 }
 
 void ecs_world_add_entity_component(const ecs_world *const world_ref, entity_id entity, component_id component)
 {
+    if (world_ref->deferred)
+    {
+        ecs_command_buffer_add_component(ecs_world_get_command_buffer(world_ref), entity, component);
+        return;
+    }
+
+    if (!ecs_entity_index_is_alive(world_ref->entities_owning, entity))
+        return;
+
+    // sparse components never move the entity
+    if (component_id_is_sparse(component))
+    {
+        bool added = false;
+        ecs_sparse_index_emplace(world_ref->sparse_owning, component, entity, &added);
+        if (added)
+            ecs_observer_index_emit_component(world_ref->observers_owning, ECS_ON_ADD, component, &entity, 1);
+        return;
+    }
+
+    // neither do row tags, only the bit of its row is set
+    if (component_id_is_row_tag(component))
+    {
+        entity_record record = ecs_entity_index_get_entity(world_ref->entities_owning, entity);
+        ecs_storage *storage = ecs_storage_index_get(world_ref->storages_owning, record.archetype);
+        if (ecs_storage_set_row_tag(storage, record.row, component, true))
+            ecs_observer_index_emit_component(world_ref->observers_owning, ECS_ON_ADD, component, &entity, 1);
+        return;
+    }
+
+    if (ecs_world_creates_cycle(world_ref, entity, component))
+        return;
+
     // get wich archetype the entity is
     const entity_index *const entity_index_ref = world_ref->entities_owning;
     entity_record record = ecs_entity_index_get_entity(entity_index_ref, entity);
-    archetype_id current_archetype = record.archetype;
 
     // get what archetype result on add component to previus archetype
-    archetype_index *const archetype_index_mut_ref = world_ref->archetypes_owning;
-    archetype_id next_archetype = ecs_archetype_add_component(archetype_index_mut_ref, current_archetype, component);
-    ecs_world_setup_archetype(world_ref, next_archetype);
-
-    // get storages from both archetypes
-    const storage_index *const storage_index_ref = world_ref->storages_owning;
-    ecs_storage *current_storage = record.storage;
-    ecs_storage *next_storage = ecs_storage_index_get(storage_index_ref, next_archetype);
-
-    // move entity from one storage to other
-    int new_row = ecs_storage_move_entity(current_storage, next_storage, entity, record.row);
+    archetype_id next_archetype = ecs_world_archetype_add(world_ref, record.archetype, component);
 
-    // update entity on index
-    ecs_entity_index_set_entity(world_ref->entities_owning, entity, next_archetype, new_row, next_storage);
+    ecs_world_move_entity(world_ref, entity, next_archetype);
 }
 
 void ecs_world_remove_entity_component(const ecs_world *const world_ref, entity_id entity, component_id component)
 {
+    if (world_ref->deferred)
+    {
+        ecs_command_buffer_remove_component(ecs_world_get_command_buffer(world_ref), entity, component);
+        return;
+    }
+
+    if (!ecs_entity_index_is_alive(world_ref->entities_owning, entity))
+        return;
+
+    if (component_id_is_sparse(component))
+    {
+        if (ecs_sparse_index_remove(world_ref->sparse_owning, component, entity))
+            ecs_observer_index_emit_component(world_ref->observers_owning, ECS_ON_REMOVE, component, &entity, 1);
+        return;
+    }
+
+    if (component_id_is_row_tag(component))
+    {
+        entity_record record = ecs_entity_index_get_entity(world_ref->entities_owning, entity);
+        ecs_storage *storage = ecs_storage_index_get(world_ref->storages_owning, record.archetype);
+        if (ecs_storage_set_row_tag(storage, record.row, component, false))
+            ecs_observer_index_emit_component(world_ref->observers_owning, ECS_ON_REMOVE, component, &entity, 1);
+        return;
+    }
+
     // get wich archetype the entity is
     const entity_index *const entity_index_ref = world_ref->entities_owning;
     entity_record record = ecs_entity_index_get_entity(entity_index_ref, entity);
-    archetype_id current_archetype = record.archetype;
 
-    // get what archetype result on add component to previus archetype
-    archetype_index *const archetype_index_mut_ref = world_ref->archetypes_owning;
-    archetype_id next_archetype = ecs_archetype_remove_component(archetype_index_mut_ref, current_archetype, component);
+    // get what archetype result on remove component from previus archetype
+    archetype_id next_archetype = ecs_world_archetype_remove(world_ref, record.archetype, component);
 
-    // get storages from both archetypes
-    const storage_index *const storage_index_ref = world_ref->storages_owning;
-    ecs_storage *current_storage = record.storage;
-    ecs_storage *next_storage = ecs_storage_index_get(storage_index_ref, next_archetype);
+    ecs_world_move_entity(world_ref, entity, next_archetype);
+}
 
-    // move entity from one storage to other
-    int new_row = ecs_storage_move_entity(current_storage, next_storage, entity, record.row);
+void ecs_world_add_entities_component(const ecs_world *const world_ref, const entity_id *ids, uint32_t count, component_id component)
+{
+    ecs_world_change_entities_component(world_ref, ids, count, component, true);
+}
 
-    // update entity on index
-    ecs_entity_index_set_entity(world_ref->entities_owning, entity, new_row, next_archetype, next_storage);
+void ecs_world_remove_entities_component(const ecs_world *const world_ref, const entity_id *ids, uint32_t count, component_id component)
+{
+    ecs_world_change_entities_component(world_ref, ids, count, component, false);
+}
+
+static void ecs_world_change_entities_component(const ecs_world *const world_ref, const entity_id *ids, uint32_t count, component_id component, bool add)
+{
+    if (count == 0)
+        return;
+
+    if (world_ref->deferred || !ecs_world_moves_entity(component))
+    {
+        for (uint32_t i = 0; i < count; i++)
+        {
+            if (add)
+                ecs_world_add_entity_component(world_ref, ids[i], component);
+            else
+                ecs_world_remove_entity_component(world_ref, ids[i], component);
+        }
+        return;
+    }
+
+    entity_record *records = (entity_record *)CFF_ALLOC(sizeof(entity_record) * count, "WORLD MOVE BATCH");
+    int *rows = (int *)CFF_ALLOC(sizeof(int) * count, "WORLD MOVE BATCH ROWS");
+    uint32_t alive_count = 0;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (ecs_entity_index_is_alive(world_ref->entities_owning, ids[i]) && !(add && ecs_world_creates_cycle(world_ref, ids[i], component)))
+        {
+            records[alive_count] = ecs_entity_index_get_entity(world_ref->entities_owning, ids[i]);
+            alive_count++;
+        }
+    }
+
+    qsort(records, alive_count, sizeof(entity_record), ecs_world_cmp_records);
+
+    // every archetype group takes a single edge and moves at once
+    uint32_t first = 0;
+    while (first < alive_count)
+    {
+        archetype_id archetype = records[first].archetype;
+        uint32_t row_count = 0;
+        uint32_t last = first;
+
+        for (; last < alive_count && records[last].archetype == archetype; last++)
+        {
+            // an entity passed twice is moved once
+            if (row_count == 0 || rows[row_count - 1] != records[last].row)
+                rows[row_count++] = records[last].row;
+        }
+
+        archetype_id next_archetype = add ? ecs_world_archetype_add(world_ref, archetype, component)
+                                          : ecs_world_archetype_remove(world_ref, archetype, component);
+
+        ecs_world_move_entities(world_ref, archetype, next_archetype, rows, row_count);
+        first = last;
+    }
+
+    CFF_RELEASE(rows);
+    CFF_RELEASE(records);
+}
+
+void ecs_world_set_entity_enabled(const ecs_world *const world_ref, entity_id entity, bool enabled)
+{
+    if (world_ref->deferred)
+    {
+        ecs_command_buffer_set_entity_enabled(ecs_world_get_command_buffer(world_ref), entity, enabled);
+        return;
+    }
+
+    if (!ecs_entity_index_is_alive(world_ref->entities_owning, entity))
+        return;
+
+    entity_record record = ecs_entity_index_get_entity(world_ref->entities_owning, entity);
+    ecs_storage *storage = ecs_storage_index_get(world_ref->storages_owning, record.archetype);
+    ecs_storage_set_enabled(storage, record.row, enabled);
+}
+
+bool ecs_world_is_entity_enabled(const ecs_world *const world_ref, entity_id entity)
+{
+    if (!ecs_entity_index_is_alive(world_ref->entities_owning, entity))
+        return false;
+
+    entity_record record = ecs_entity_index_get_entity(world_ref->entities_owning, entity);
+    ecs_storage *storage = ecs_storage_index_get(world_ref->storages_owning, record.archetype);
+    return ecs_storage_is_enabled(storage, record.row);
+}
+
+void ecs_world_set_entity_component_enabled(const ecs_world *const world_ref, entity_id entity, component_id component, bool enabled)
+{
+    if (world_ref->deferred)
+    {
+        ecs_command_buffer_set_component_enabled(ecs_world_get_command_buffer(world_ref), entity, component, enabled);
+        return;
+    }
+
+    if (!ecs_entity_index_is_alive(world_ref->entities_owning, entity))
+        return;
+
+    entity_record record = ecs_entity_index_get_entity(world_ref->entities_owning, entity);
+    ecs_storage *storage = ecs_storage_index_get(world_ref->storages_owning, record.archetype);
+    ecs_storage_set_component_enabled(storage, record.row, component, enabled);
+}
+
+bool ecs_world_is_entity_component_enabled(const ecs_world *const world_ref, entity_id entity, component_id component)
+{
+    if (!ecs_entity_index_is_alive(world_ref->entities_owning, entity))
+        return false;
+
+    entity_record record = ecs_entity_index_get_entity(world_ref->entities_owning, entity);
+    ecs_storage *storage = ecs_storage_index_get(world_ref->storages_owning, record.archetype);
+    return ecs_storage_is_component_enabled(storage, record.row, component);
+}
+
+static ecs_storage *ecs_world_get_or_setup_storage(const ecs_world *const world_ref, archetype_id archetype)
+{
+    ecs_storage *storage = ecs_storage_index_get(world_ref->storages_owning, archetype);
+
+    // only archetypes reached for the first time need a storage
+    if (storage == NULL)
+    {
+        ecs_world_setup_archetype(world_ref, archetype);
+        storage = ecs_storage_index_get(world_ref->storages_owning, archetype);
+    }
+
+    return storage;
+}
+
+static void ecs_world_move_entity(const ecs_world *const world_ref, entity_id entity, archetype_id next_archetype)
+{
+    entity_record record = ecs_entity_index_get_entity(world_ref->entities_owning, entity);
+
+    if (next_archetype == INVALID_ID || next_archetype == record.archetype)
+        return;
+
+    // setup may grow the storage index, so the current storage is fetched after it
+    ecs_storage *next_storage = ecs_world_get_or_setup_storage(world_ref, next_archetype);
+    ecs_storage *current_storage = ecs_storage_index_get(world_ref->storages_owning, record.archetype);
+
+    // move entity from one storage to other
+    entity_id moved_entity = INVALID_ID;
+    int new_row = ecs_storage_move_entity(current_storage, next_storage, entity, record.row, &moved_entity);
+
+    // update entity on index
+    ecs_entity_index_set_entity(world_ref->entities_owning, entity, next_archetype, new_row, next_storage);
+
+    if (moved_entity != INVALID_ID)
+        ecs_entity_index_set_entity(world_ref->entities_owning, moved_entity, record.archetype, record.row, current_storage);
+
+    ecs_observer_index_emit_transition(world_ref->observers_owning, record.archetype, next_archetype, &entity, 1);
+    ecs_world_parent_moved(world_ref, entity);
+}
+
+static int ecs_world_cmp_rows(const void *a, const void *b)
+{
+    int row_a = *(const int *)a;
+    int row_b = *(const int *)b;
+
+    if (row_a != row_b)
+        return row_a > row_b ? -1 : 1;
+    return 0;
+}
+
+static void ecs_world_move_entities(const ecs_world *const world_ref, archetype_id archetype, archetype_id next_archetype, int *rows, uint32_t count)
+{
+    if (count == 0 || next_archetype == INVALID_ID || next_archetype == archetype)
+        return;
+
+    // higher rows first, a swap-remove then never moves a row that is still waiting to be moved
+    qsort(rows, count, sizeof(int), ecs_world_cmp_rows);
+
+    ecs_storage *next_storage = ecs_world_get_or_setup_storage(world_ref, next_archetype);
+    ecs_storage *current_storage = ecs_storage_index_get(world_ref->storages_owning, archetype);
+
+    entity_id *entities = (entity_id *)CFF_ALLOC(sizeof(entity_id) * count * 2, "WORLD MOVE BATCH ENTITIES");
+    entity_id *moved_entities = entities + count;
+
+    for (uint32_t r = 0; r < count; r++)
+        entities[r] = ecs_storage_get_entity(current_storage, rows[r]);
+
+    int first_row = ecs_storage_move_entities(current_storage, next_storage, rows, count, moved_entities);
+
+    // in removal order, an entity that filled a hole may fill a later one again
+    for (uint32_t r = 0; r < count; r++)
+    {
+        ecs_entity_index_set_entity(world_ref->entities_owning, entities[r], next_archetype, first_row + (int)r, next_storage);
+
+        if (moved_entities[r] != INVALID_ID)
+            ecs_entity_index_set_entity(world_ref->entities_owning, moved_entities[r], archetype, rows[r], current_storage);
+
+        ecs_world_parent_moved(world_ref, entities[r]);
+    }
+
+    ecs_observer_index_emit_transition(world_ref->observers_owning, archetype, next_archetype, entities, count);
+
+    CFF_RELEASE(entities);
+}
+
+static void ecs_world_remove_sparse_components(const ecs_world *const world_ref, entity_id entity)
+{
+    uint32_t count = ecs_sparse_index_component_count(world_ref->sparse_owning);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        component_id component = ecs_sparse_index_get_component(world_ref->sparse_owning, i);
+        if (ecs_sparse_index_remove(world_ref->sparse_owning, component, entity))
+            ecs_observer_index_emit_component(world_ref->observers_owning, ECS_ON_REMOVE, component, &entity, 1);
+    }
+}
+
+static void ecs_world_remove_row_tags(const ecs_world *const world_ref, ecs_storage *storage, int row, entity_id entity)
+{
+    uint32_t count = ecs_storage_row_tag_count(storage);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        component_id tag = ecs_storage_get_row_tag(storage, i);
+        if (ecs_storage_set_row_tag(storage, row, tag, false))
+            ecs_observer_index_emit_component(world_ref->observers_owning, ECS_ON_REMOVE, tag, &entity, 1);
+    }
+}
+
+// sparse components and row tags live outside of the archetypes
+static bool ecs_world_moves_entity(component_id component)
+{
+    return !component_id_is_sparse(component) && !component_id_is_row_tag(component);
+}
+
+#pragma endregion
+
+#pragma region PREFAB
+
+component_id ecs_world_prefab(const ecs_world *const world_ref)
+{
+    return world_ref->prefab;
+}
+
+entity_id ecs_world_create_prefab(const ecs_world *const world_ref, archetype_id archetype)
+{
+    if (world_ref->deferred)
+    {
+        entity_id entity = ecs_world_create_entity(world_ref, archetype);
+        ecs_world_add_entity_component(world_ref, entity, world_ref->prefab);
+        return entity;
+    }
+
+    archetype_id prefab_archetype = ecs_archetype_add_component(world_ref->archetypes_owning, archetype, world_ref->prefab);
+    if (prefab_archetype == INVALID_ID)
+        return INVALID_ID;
+
+    ecs_world_get_or_setup_storage(world_ref, prefab_archetype);
+    return ecs_world_create_entity(world_ref, prefab_archetype);
+}
+
+void ecs_world_instantiate(const ecs_world *const world_ref, entity_id prefab, uint32_t count, entity_id *out_ids)
+{
+    if (count == 0 || !ecs_entity_index_is_alive(world_ref->entities_owning, prefab))
+        return;
+
+    entity_record record = ecs_entity_index_get_entity(world_ref->entities_owning, prefab);
+    const ecs_storage *source = ecs_storage_index_get(world_ref->storages_owning, record.archetype);
+    bool is_prefab = ecs_world_is_prefab_archetype(world_ref, record.archetype);
+
+    const component_id *components = NULL;
+    uint32_t component_count = 0;
+
+    if (world_ref->deferred)
+    {
+        // instances start in the prefab archetype, the flush moves them out of it before writing the values
+        component_count = ecs_storage_get_components(source, &components);
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            entity_id entity = ecs_world_create_entity(world_ref, record.archetype);
+            if (is_prefab)
+                ecs_world_remove_entity_component(world_ref, entity, world_ref->prefab);
+
+            for (uint32_t c = 0; c < component_count; c++)
+            {
+                void *data = ecs_storage_get_component(source, record.row, components[c]);
+                if (data != NULL)
+                    ecs_world_set_entity_component(world_ref, entity, components[c], data);
+            }
+
+            ecs_world_copy_detached(world_ref, prefab, &entity, 1);
+
+            if (out_ids != NULL)
+                out_ids[i] = entity;
+        }
+        return;
+    }
+
+    archetype_id archetype = record.archetype;
+    if (is_prefab)
+        archetype = ecs_archetype_remove_component(world_ref->archetypes_owning, archetype, world_ref->prefab);
+
+    entity_id *ids = out_ids;
+    if (ids == NULL)
+        ids = (entity_id *)CFF_ALLOC(sizeof(entity_id) * count, "WORLD INSTANCE BATCH");
+
+    // setup may grow the storage index, the storages are fetched after it
+    ecs_world_get_or_setup_storage(world_ref, archetype);
+    ecs_storage *storage = ecs_storage_index_get(world_ref->storages_owning, archetype);
+
+    ecs_entity_index_new_entities(world_ref->entities_owning, count, ids);
+    int first_row = ecs_storage_add_entities(storage, ids, count);
+    ecs_entity_index_set_entities(world_ref->entities_owning, ids, count, archetype, first_row, storage);
+
+    ecs_observer_index_emit_transition(world_ref->observers_owning, INVALID_ID, archetype, ids, count);
+
+    // the template row is read once the rows were added, a plain entity used as template shares the storage of its instances
+    source = ecs_storage_index_get(world_ref->storages_owning, record.archetype);
+    component_count = ecs_storage_get_components(storage, &components);
+
+    // one fill per column, it copies the template once and doubles the filled rows from there
+    for (uint32_t c = 0; c < component_count; c++)
+    {
+        const void *data = ecs_storage_get_component(source, record.row, components[c]);
+        if (data == NULL)
+            continue;
+
+        ecs_storage_fill_component(storage, first_row, count, components[c], data);
+        ecs_observer_index_emit_set(world_ref->observers_owning, archetype, components[c], ids, count);
+    }
+
+    ecs_world_copy_detached(world_ref, prefab, ids, count);
+
+    if (out_ids == NULL)
+        CFF_RELEASE(ids);
+}
+
+static bool ecs_world_is_prefab_archetype(const ecs_world *const world_ref, archetype_id archetype)
+{
+    const cff_bitset *mask = ecs_archetype_get_mask(world_ref->archetypes_owning, archetype);
+    return mask != NULL && cff_bitset_test(mask, component_id_index(world_ref->prefab));
+}
+
+static void ecs_world_copy_detached(const ecs_world *const world_ref, entity_id prefab, const entity_id *ids, uint32_t count)
+{
+    // sparse components and row tags live outside of the template row, every instance gets its own
+    uint32_t sparse_count = ecs_sparse_index_component_count(world_ref->sparse_owning);
+
+    for (uint32_t s = 0; s < sparse_count; s++)
+    {
+        component_id component = ecs_sparse_index_get_component(world_ref->sparse_owning, s);
+        if (!ecs_sparse_index_has(world_ref->sparse_owning, component, prefab))
+            continue;
+
+        for (uint32_t i = 0; i < count; i++)
+        {
+            ecs_world_add_entity_component(world_ref, ids[i], component);
+
+            // read again every time, adding to the set may move its values
+            void *data = ecs_sparse_index_get(world_ref->sparse_owning, component, prefab);
+            if (data != NULL)
+                ecs_world_set_entity_component(world_ref, ids[i], component, data);
+        }
+    }
+
+    entity_record record = ecs_entity_index_get_entity(world_ref->entities_owning, prefab);
+    const ecs_storage *source = ecs_storage_index_get(world_ref->storages_owning, record.archetype);
+    uint32_t tag_count = ecs_storage_row_tag_count(source);
+
+    for (uint32_t t = 0; t < tag_count; t++)
+    {
+        component_id tag = ecs_storage_get_row_tag(source, t);
+        if (!ecs_storage_has_row_tag(source, record.row, tag))
+            continue;
+
+        for (uint32_t i = 0; i < count; i++)
+            ecs_world_add_entity_component(world_ref, ids[i], tag);
+    }
+}
+
+#pragma endregion
+
+#pragma region HIERARCHY
+
+void ecs_world_set_parent(const ecs_world *const world_ref, entity_id entity, entity_id parent)
+{
+    // the pair is asked for on flush, registering it here would race with the other systems
+    if (world_ref->deferred)
+    {
+        ecs_command_buffer_set_parent(ecs_world_get_command_buffer(world_ref), entity, parent);
+        return;
+    }
+
+    if (parent != INVALID_ID)
+    {
+        // the pair replaces the current ChildOf pair of the entity
+        ecs_world_add_entity_component(world_ref, entity, ecs_world_pair(world_ref, world_ref->child_of, parent));
+        return;
+    }
+
+    entity_id current = ecs_world_get_parent(world_ref, entity);
+    if (current != INVALID_ID)
+        ecs_world_remove_entity_component(world_ref, entity, ecs_pair_index_get(world_ref->pairs_owning, world_ref->child_of, current));
+}
+
+entity_id ecs_world_get_parent(const ecs_world *const world_ref, entity_id entity)
+{
+    if (!ecs_entity_index_is_alive(world_ref->entities_owning, entity))
+        return INVALID_ID;
+
+    archetype_id archetype = ecs_entity_index_get_entity(world_ref->entities_owning, entity).archetype;
+    component_id pair = ecs_world_archetype_parent_pair(world_ref, archetype);
+    return pair != INVALID_ID ? ecs_pair_index_target(world_ref->pairs_owning, pair) : INVALID_ID;
+}
+
+uint32_t ecs_world_get_depth(const ecs_world *const world_ref, entity_id entity)
+{
+    if (!ecs_entity_index_is_alive(world_ref->entities_owning, entity))
+        return 0;
+
+    ecs_world_update_hierarchy(world_ref);
+
+    archetype_id archetype = ecs_entity_index_get_entity(world_ref->entities_owning, entity).archetype;
+    return archetype < world_ref->depth_capacity ? world_ref->depths[archetype] : 0;
+}
+
+static bool ecs_world_is_child_of(const ecs_world *const world_ref, component_id component)
+{
+    return component != INVALID_ID && component_id_is_pair(component) && ecs_pair_index_relation(world_ref->pairs_owning, component) == world_ref->child_of;
+}
+
+static component_id ecs_world_archetype_parent_pair(const ecs_world *const world_ref, archetype_id archetype)
+{
+    const component_id *components = NULL;
+    uint32_t count = ecs_archetype_get_components(world_ref->archetypes_owning, archetype, &components);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (ecs_world_is_child_of(world_ref, components[i]))
+            return components[i];
+    }
+
+    return INVALID_ID;
+}
+
+static bool ecs_world_is_shared(const ecs_world *const world_ref, component_id component)
+{
+    // values are shared components too, they are the ones the shared index knows
+    return component != INVALID_ID && component_id_is_shared(component) && ecs_shared_index_component(world_ref->shared_owning, component) == INVALID_ID;
+}
+
+static component_id ecs_world_archetype_shared_value(const ecs_world *const world_ref, archetype_id archetype, component_id component)
+{
+    const component_id *components = NULL;
+    uint32_t count = ecs_archetype_get_components(world_ref->archetypes_owning, archetype, &components);
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (component_id_is_shared(components[i]) && ecs_shared_index_component(world_ref->shared_owning, components[i]) == component)
+            return components[i];
+    }
+
+    return INVALID_ID;
+}
+
+static component_id ecs_world_archetype_exclusive(const ecs_world *const world_ref, archetype_id archetype, component_id component)
+{
+    if (ecs_world_is_child_of(world_ref, component))
+        return ecs_world_archetype_parent_pair(world_ref, archetype);
+
+    component_id shared = ecs_shared_index_component(world_ref->shared_owning, component);
+    return shared != INVALID_ID ? ecs_world_archetype_shared_value(world_ref, archetype, shared) : INVALID_ID;
+}
+
+static archetype_id ecs_world_archetype_add(const ecs_world *const world_ref, archetype_id archetype, component_id component)
+{
+    // shared components are given through their values, see ecs_world_shared_value
+    if (ecs_world_is_shared(world_ref, component))
+        return archetype;
+
+    // ChildOf pairs and the values of a shared component are exclusive, the new one takes the place of the previous one
+    component_id previous = ecs_world_archetype_exclusive(world_ref, archetype, component);
+    if (previous == component)
+        return archetype;
+    if (previous != INVALID_ID)
+        archetype = ecs_archetype_remove_component(world_ref->archetypes_owning, archetype, previous);
+
+    // values come with their shared component, queries on it match every group
+    component_id shared = ecs_shared_index_component(world_ref->shared_owning, component);
+    if (shared != INVALID_ID)
+        archetype = ecs_archetype_add_component(world_ref->archetypes_owning, archetype, shared);
+
+    return ecs_archetype_add_component(world_ref->archetypes_owning, archetype, component);
+}
+
+static archetype_id ecs_world_archetype_remove(const ecs_world *const world_ref, archetype_id archetype, component_id component)
+{
+    // a shared component and its value leave together
+    if (ecs_world_is_shared(world_ref, component))
+    {
+        component_id value = ecs_world_archetype_shared_value(world_ref, archetype, component);
+        if (value != INVALID_ID)
+            archetype = ecs_archetype_remove_component(world_ref->archetypes_owning, archetype, value);
+    }
+    else
+    {
+        component_id shared = ecs_shared_index_component(world_ref->shared_owning, component);
+        if (shared != INVALID_ID && ecs_world_archetype_shared_value(world_ref, archetype, shared) == component)
+            archetype = ecs_archetype_remove_component(world_ref->archetypes_owning, archetype, shared);
+    }
+
+    return ecs_archetype_remove_component(world_ref->archetypes_owning, archetype, component);
+}
+
+static bool ecs_world_creates_cycle(const ecs_world *const world_ref, entity_id entity, component_id component)
+{
+    if (!ecs_world_is_child_of(world_ref, component))
+        return false;
+
+    // only an entity that already is a parent can be an ancestor of the new one
+    if (ecs_pair_index_get(world_ref->pairs_owning, world_ref->child_of, entity) == INVALID_ID)
+        return false;
+
+    // every ancestor lives in an archetype of its own, a longer walk can only be a loop
+    uint32_t bound = ecs_archetype_get_generated_count(world_ref->archetypes_owning) + 1;
+    entity_id ancestor = ecs_pair_index_target(world_ref->pairs_owning, component);
+
+    // with up to date depths the entity can only be found as many levels above the parent as their depths differ
+    if (!world_ref->hierarchy_dirty && ecs_entity_index_is_alive(world_ref->entities_owning, entity) &&
+        ecs_entity_index_is_alive(world_ref->entities_owning, ancestor))
+    {
+        archetype_id entity_archetype = ecs_entity_index_get_entity(world_ref->entities_owning, entity).archetype;
+        archetype_id parent_archetype = ecs_entity_index_get_entity(world_ref->entities_owning, ancestor).archetype;
+
+        if (entity_archetype < world_ref->depth_capacity && parent_archetype < world_ref->depth_capacity)
+        {
+            uint32_t entity_depth = world_ref->depths[entity_archetype];
+            uint32_t parent_depth = world_ref->depths[parent_archetype];
+            if (parent_depth <= entity_depth)
+                return false;
+            bound = parent_depth - entity_depth + 1;
+        }
+    }
+
+    for (uint32_t i = 0; i < bound && ancestor != INVALID_ID; i++)
+    {
+        if (ancestor == entity)
+        {
+            caff_log_warn("[ECS_WORLD] ChildOf pair skipped: entity %" PRIu64 " would be its own ancestor\n", entity);
+            return true;
+        }
+        ancestor = ecs_world_get_parent(world_ref, ancestor);
+    }
+
+    return false;
+}
+
+static void ecs_world_parent_moved(const ecs_world *const world_ref, entity_id entity)
+{
+    // the depth of the children follows the archetype of their parent
+    if (!world_ref->hierarchy_dirty && ecs_pair_index_get(world_ref->pairs_owning, world_ref->child_of, entity) != INVALID_ID)
+        ((ecs_world *)world_ref)->hierarchy_dirty = true;
+}
+
+static void ecs_world_remove_target(const ecs_world *const world_ref, entity_id target)
+{
+    uint32_t relation_count = ecs_pair_index_relation_count(world_ref->pairs_owning);
+
+    for (uint32_t r = 0; r < relation_count; r++)
+    {
+        component_id relation = ecs_pair_index_get_relation(world_ref->pairs_owning, r);
+        component_id pair = ecs_pair_index_get(world_ref->pairs_owning, relation, target);
+        if (pair == INVALID_ID)
+            continue;
+
+        ecs_pair_index_remove(world_ref->pairs_owning, pair);
+
+        const archetype_id *archetypes = NULL;
+        uint32_t archetype_count = ecs_component_dependency_get_dependencies(world_ref->dependencies_owning, pair, &archetypes);
+        uint32_t holder_count = 0;
+
+        for (uint32_t a = 0; a < archetype_count; a++)
+            holder_count += ecs_storage_count(ecs_storage_index_get(world_ref->storages_owning, archetypes[a]));
+
+        if (holder_count == 0)
+            continue;
+
+        // holders are gathered first, destroying or moving them changes the storages and the dependencies
+        entity_id *holders = (entity_id *)CFF_ALLOC(sizeof(entity_id) * holder_count, "WORLD PAIR HOLDERS");
+        uint32_t holder = 0;
+
+        for (uint32_t a = 0; a < archetype_count; a++)
+        {
+            const ecs_storage *storage = ecs_storage_index_get(world_ref->storages_owning, archetypes[a]);
+            uint32_t count = ecs_storage_count(storage);
+
+            for (uint32_t row = 0; row < count; row++)
+                holders[holder++] = ecs_storage_get_entity(storage, (int)row);
+        }
+
+        // children go with their parent, the other relations only lose the pair
+        if (relation == world_ref->child_of)
+            ecs_world_destroy_entities(world_ref, holders, holder_count);
+        else
+            ecs_world_remove_entities_component(world_ref, holders, holder_count, pair);
+
+        CFF_RELEASE(holders);
+    }
+}
+
+static void ecs_world_update_hierarchy(const ecs_world *const world_ref)
+{
+    ecs_world *world_mut_ref = (ecs_world *)world_ref;
+
+    if (!world_ref->hierarchy_dirty)
+        return;
+
+    uint32_t count = ecs_archetype_get_generated_count(world_ref->archetypes_owning);
+    if (count == 0)
+        return;
+
+    if (count > world_ref->depth_capacity)
+    {
+        uint32_t *depths = world_ref->depths == NULL ? (uint32_t *)CFF_ALLOC(sizeof(uint32_t) * count, "WORLD HIERARCHY DEPTHS")
+                                                     : CFF_ARR_RESIZE(world_mut_ref->depths, count);
+        if (depths == NULL)
+            return;
+
+        world_mut_ref->depths = depths;
+        world_mut_ref->depth_capacity = count;
+    }
+
+    for (uint32_t a = 0; a < count; a++)
+        world_mut_ref->depths[a] = HIERARCHY_DEPTH_UNKNOWN;
+
+    for (uint32_t a = 0; a < count; a++)
+        ecs_world_archetype_depth(world_ref, a);
+
+    world_mut_ref->hierarchy_dirty = false;
+    ecs_system_index_set_depths(world_ref->systems_owning, world_ref->depths, count);
+}
+
+static uint32_t ecs_world_archetype_depth(const ecs_world *const world_ref, archetype_id archetype)
+{
+    uint32_t *depths = world_ref->depths;
+
+    // a loop made by a single flush, its archetypes count as roots
+    if (depths[archetype] == HIERARCHY_DEPTH_VISITING)
+        return 0;
+    if (depths[archetype] != HIERARCHY_DEPTH_UNKNOWN)
+        return depths[archetype];
+
+    depths[archetype] = HIERARCHY_DEPTH_VISITING;
+
+    uint32_t depth = 0;
+    component_id pair = ecs_world_archetype_parent_pair(world_ref, archetype);
+    entity_id parent = pair != INVALID_ID ? ecs_pair_index_target(world_ref->pairs_owning, pair) : INVALID_ID;
+
+    // every row of the archetype has the same parent, so the same depth
+    if (parent != INVALID_ID && ecs_entity_index_is_alive(world_ref->entities_owning, parent))
+        depth = ecs_world_archetype_depth(world_ref, ecs_entity_index_get_entity(world_ref->entities_owning, parent).archetype) + 1;
+
+    depths[archetype] = depth;
+    return depth;
+}
+
+#pragma endregion
+
+#pragma region COMMANDS
+
+ecs_command_buffer *ecs_world_get_command_buffer(const ecs_world *const world_ref)
+{
+    uint32_t thread = caff_jobs_thread_index();
+
+    // workers only record while deferred, their buffers are created before systems run
+    if (thread >= world_ref->command_buffer_count)
+        ecs_world_reserve_command_buffers(world_ref, thread + 1);
+
+    return world_ref->command_buffers_owning[thread];
+}
+
+static void ecs_world_reserve_command_buffers(const ecs_world *const world_ref, uint32_t count)
+{
+    ecs_world *world_mut_ref = (ecs_world *)world_ref;
+
+    if (count <= world_mut_ref->command_buffer_count)
+        return;
+
+    if (world_mut_ref->command_buffers_owning == NULL)
+        world_mut_ref->command_buffers_owning = (ecs_command_buffer **)CFF_ALLOC(sizeof(ecs_command_buffer *) * count, "WORLD COMMAND BUFFERS");
+    else
+        world_mut_ref->command_buffers_owning = CFF_ARR_RESIZE(world_mut_ref->command_buffers_owning, count);
+
+    for (uint32_t i = world_mut_ref->command_buffer_count; i < count; i++)
+    {
+        world_mut_ref->command_buffers_owning[i] = ecs_command_buffer_new(i);
+    }
+
+    world_mut_ref->command_buffer_count = count;
+}
+
+static int ecs_world_cmp_pending(const void *a, const void *b)
+{
+    const pending_command *pending_a = (const pending_command *)a;
+    const pending_command *pending_b = (const pending_command *)b;
+
+    if (pending_a->entity != pending_b->entity)
+        return pending_a->entity < pending_b->entity ? -1 : 1;
+    if (pending_a->buffer != pending_b->buffer)
+        return pending_a->buffer < pending_b->buffer ? -1 : 1;
+    if (pending_a->command != pending_b->command)
+        return pending_a->command < pending_b->command ? -1 : 1;
+    return 0;
+}
+
+static int ecs_world_cmp_change(const void *a, const void *b)
+{
+    const entity_change *change_a = (const entity_change *)a;
+    const entity_change *change_b = (const entity_change *)b;
+
+    if (change_a->from != change_b->from)
+        return change_a->from < change_b->from ? -1 : 1;
+    if (change_a->to != change_b->to)
+        return change_a->to < change_b->to ? -1 : 1;
+    if (change_a->first != change_b->first)
+        return change_a->first < change_b->first ? -1 : 1;
+    return 0;
+}
+
+static archetype_id ecs_world_archetype_parent(const ecs_world *const world_ref, entity_id entity, archetype_id archetype, entity_id parent)
+{
+    if (parent == INVALID_ID)
+    {
+        component_id current = ecs_world_archetype_parent_pair(world_ref, archetype);
+        return current != INVALID_ID ? ecs_world_archetype_remove(world_ref, archetype, current) : archetype;
+    }
+
+    component_id pair = ecs_world_pair(world_ref, world_ref->child_of, parent);
+    if (pair == INVALID_ID || ecs_world_creates_cycle(world_ref, entity, pair))
+        return archetype;
+
+    return ecs_world_archetype_add(world_ref, archetype, pair);
+}
+
+static entity_id ecs_world_resolve_deferred(const pending_list *const pending_ref, entity_id handle)
+{
+    // the pending list is sorted by entity, the first command of the group holds the created entity
+    uint32_t low = 0;
+    uint32_t high = pending_ref->count;
+    while (low < high)
+    {
+        uint32_t middle = low + (high - low) / 2;
+        if (pending_ref->buffer[middle].entity < handle)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+
+    if (low < pending_ref->count && pending_ref->buffer[low].entity == handle)
+        return pending_ref->buffer[low].resolved;
+    return INVALID_ID;
+}
+
+void ecs_world_flush_commands(const ecs_world *const world_ref)
+{
+    if (world_ref->deferred)
+    {
+        caff_log_warn("[ECS_WORLD] Commands can't be flushed while systems are running\n");
+        return;
+    }
+
+    ecs_world *world_mut_ref = (ecs_world *)world_ref;
+    pending_list *pending = &(world_mut_ref->pending_commands);
+    change_list *changes = &(world_mut_ref->entity_changes);
+
+    pending->count = 0;
+    changes->count = 0;
+
+    for (uint32_t b = 0; b < world_ref->command_buffer_count; b++)
+    {
+        const ecs_command_buffer *buffer = world_ref->command_buffers_owning[b];
+        uint32_t count = ecs_command_buffer_count(buffer);
+
+        for (uint32_t c = 0; c < count; c++)
+        {
+            pending_command command = {.entity = ecs_command_buffer_get(buffer, c)->entity, .buffer = b, .command = c, .resolved = INVALID_ID};
+            pending_list_add(pending, command);
+        }
+    }
+
+    if (pending->count == 0)
+    {
+        ecs_observer_index_dispatch(world_ref->observers_owning, world_mut_ref);
+        return;
+    }
+
+    // group the commands of each entity keeping the order they were recorded
+    qsort(pending->buffer, pending->count, sizeof(pending_command), ecs_world_cmp_pending);
+
+    // collapse every group into a single transition from the current to the final archetype
+    uint32_t first = 0;
+    while (first < pending->count)
+    {
+        entity_id entity = pending->buffer[first].entity;
+        uint32_t last = first;
+
+        entity_change change = {
+            .entity = entity,
+            .from = INVALID_ID,
+            .to = INVALID_ID,
+            .destroyed = false,
+            .first = first,
+            .deferred_parent = UINT32_MAX,
+        };
+
+        // commands on entities destroyed before the flush are dropped
+        if (!ecs_entity_is_deferred(entity) && !ecs_entity_index_is_alive(world_ref->entities_owning, entity))
+        {
+            change.destroyed = true;
+        }
+        else if (!ecs_entity_is_deferred(entity))
+        {
+            change.from = ecs_entity_index_get_entity(world_ref->entities_owning, entity).archetype;
+            change.to = change.from;
+        }
+
+        while (last < pending->count && pending->buffer[last].entity == entity)
+        {
+            const pending_command *ref = pending->buffer + last;
+            const ecs_command *command = ecs_command_buffer_get(world_ref->command_buffers_owning[ref->buffer], ref->command);
+            last++;
+
+            if (change.destroyed)
+                continue;
+
+            switch (command->type)
+            {
+            case ECS_COMMAND_CREATE:
+                change.to = command->target;
+                break;
+            case ECS_COMMAND_DESTROY:
+                change.destroyed = true;
+                break;
+            case ECS_COMMAND_ADD:
+                if (change.to != INVALID_ID && ecs_world_moves_entity(command->target) && !ecs_world_creates_cycle(world_ref, entity, command->target))
+                    change.to = ecs_world_archetype_add(world_ref, change.to, command->target);
+                break;
+            case ECS_COMMAND_REMOVE:
+                if (change.to != INVALID_ID && ecs_world_moves_entity(command->target))
+                    change.to = ecs_world_archetype_remove(world_ref, change.to, command->target);
+                break;
+            case ECS_COMMAND_PARENT:
+                // parents created by a buffer only exist once the transitions are applied, their pair is added with the values
+                change.deferred_parent = ecs_entity_is_deferred(command->target) ? last - 1 : UINT32_MAX;
+                if (change.to != INVALID_ID && !ecs_entity_is_deferred(command->target))
+                    change.to = ecs_world_archetype_parent(world_ref, entity, change.to, command->target);
+                break;
+            case ECS_COMMAND_SET:
+            case ECS_COMMAND_ENABLE:
+            case ECS_COMMAND_DISABLE:
+                break;
+            }
+        }
+
+        change.count = last - first;
+        change_list_add(changes, change);
+        first = last;
+    }
+
+    // entities doing the same transition are applied together
+    qsort(changes->buffer, changes->count, sizeof(entity_change), ecs_world_cmp_change);
+
+    for (uint32_t i = 0; i < changes->count; i++)
+    {
+        entity_change *change = changes->buffer + i;
+        bool deferred = ecs_entity_is_deferred(change->entity);
+
+        if (change->destroyed)
+        {
+            // children of destroyed parents are destroyed once every transition was applied, see below
+            if (!deferred && ecs_entity_index_is_alive(world_ref->entities_owning, change->entity))
+                ecs_world_remove_entity(world_ref, change->entity);
+            continue;
+        }
+
+        if (change->to == INVALID_ID)
+            continue;
+
+        if (deferred)
+        {
+            // new entities of the same archetype are next to each other after sorting, create them at once
+            uint32_t run = 1;
+            while (i + run < changes->count && ecs_entity_is_deferred(changes->buffer[i + run].entity) &&
+                   !changes->buffer[i + run].destroyed && changes->buffer[i + run].to == change->to)
+                run++;
+
+            entity_id *ids = (entity_id *)CFF_ALLOC(sizeof(entity_id) * run, "WORLD COMMAND ENTITIES");
+
+            ecs_world_get_or_setup_storage(world_ref, change->to);
+            ecs_world_create_entities(world_ref, change->to, run, ids);
+
+            for (uint32_t r = 0; r < run; r++)
+            {
+                changes->buffer[i + r].entity = ids[r];
+                pending->buffer[changes->buffer[i + r].first].resolved = ids[r];
+            }
+
+            CFF_RELEASE(ids);
+            i += run - 1;
+        }
+        else if (change->from != change->to)
+        {
+            // entities doing the same transition move together, column by column
+            uint32_t run = 1;
+            while (i + run < changes->count && !ecs_entity_is_deferred(changes->buffer[i + run].entity) && !changes->buffer[i + run].destroyed &&
+                   changes->buffer[i + run].from == change->from && changes->buffer[i + run].to == change->to)
+                run++;
+
+            if (run == 1)
+            {
+                ecs_world_move_entity(world_ref, change->entity, change->to);
+                continue;
+            }
+
+            int *rows = (int *)CFF_ALLOC(sizeof(int) * run, "WORLD COMMAND ROWS");
+
+            for (uint32_t r = 0; r < run; r++)
+                rows[r] = ecs_entity_index_get_entity(world_ref->entities_owning, changes->buffer[i + r].entity).row;
+
+            ecs_world_move_entities(world_ref, change->from, change->to, rows, run);
+
+            CFF_RELEASE(rows);
+            i += run - 1;
+        }
+    }
+
+    // values are written once every entity reached its final storage
+    for (uint32_t i = 0; i < changes->count; i++)
+    {
+        const entity_change *change = changes->buffer + i;
+
+        if (change->destroyed || change->to == INVALID_ID)
+            continue;
+
+        for (uint32_t p = change->first; p < change->first + change->count; p++)
+        {
+            const pending_command *ref = pending->buffer + p;
+            const ecs_command_buffer *buffer = world_ref->command_buffers_owning[ref->buffer];
+            const ecs_command *command = ecs_command_buffer_get(buffer, ref->command);
+
+            bool enabled = command->type == ECS_COMMAND_ENABLE;
+            bool detached = command->target != INVALID_ID && !ecs_world_moves_entity(command->target);
+
+            // sparse components and row tags are added and removed in the order they were recorded with their values
+            if (command->type == ECS_COMMAND_ADD && detached)
+                ecs_world_add_entity_component(world_ref, change->entity, command->target);
+            else if (command->type == ECS_COMMAND_REMOVE && detached)
+                ecs_world_remove_entity_component(world_ref, change->entity, command->target);
+            else if (command->type == ECS_COMMAND_SET)
+                ecs_world_set_entity_component(world_ref, change->entity, command->target, (void *)ecs_command_buffer_get_data(buffer, command));
+            else if ((command->type == ECS_COMMAND_ENABLE || command->type == ECS_COMMAND_DISABLE) && command->target == INVALID_ID)
+                ecs_world_set_entity_enabled(world_ref, change->entity, enabled);
+            else if (command->type == ECS_COMMAND_ENABLE || command->type == ECS_COMMAND_DISABLE)
+                ecs_world_set_entity_component_enabled(world_ref, change->entity, command->target, enabled);
+        }
+
+        if (change->deferred_parent != UINT32_MAX)
+        {
+            const pending_command *ref = pending->buffer + change->deferred_parent;
+            const ecs_command *command = ecs_command_buffer_get(world_ref->command_buffers_owning[ref->buffer], ref->command);
+
+            // a parent destroyed before it was created leaves the entity where it is
+            entity_id parent = ecs_world_resolve_deferred(pending, command->target);
+            if (parent != INVALID_ID)
+                ecs_world_set_parent(world_ref, change->entity, parent);
+        }
+    }
+
+    for (uint32_t b = 0; b < world_ref->command_buffer_count; b++)
+    {
+        ecs_command_buffer_clear(world_ref->command_buffers_owning[b]);
+    }
+
+    // the transitions above were computed before any of these, removing the pairs earlier would move their holders under them
+    for (uint32_t i = 0; i < changes->count; i++)
+    {
+        const entity_change *change = changes->buffer + i;
+        if (change->destroyed && !ecs_entity_is_deferred(change->entity))
+            ecs_world_remove_target(world_ref, change->entity);
+    }
+
+    // observers run once every command was applied, what they record is applied by the next flush
+    ecs_observer_index_dispatch(world_ref->observers_owning, world_mut_ref);
+}
+
+#pragma endregion
+
+#pragma region OBSERVERS
+
+uint32_t ecs_world_observe(const ecs_world *const world_ref, ecs_observer_event event, component_id component, ecs_observer observer, void *context)
+{
+    return ecs_observer_index_add(world_ref->observers_owning, event, component, NULL, observer, context);
+}
+
+uint32_t ecs_world_observe_query(const ecs_world *const world_ref, ecs_observer_event event, ecs_query *query_owning, ecs_observer observer, void *context)
+{
+    return ecs_observer_index_add(world_ref->observers_owning, event, INVALID_ID, query_owning, observer, context);
+}
+
+void ecs_world_remove_observer(const ecs_world *const world_ref, uint32_t observer_id)
+{
+    ecs_observer_index_remove(world_ref->observers_owning, observer_id);
+}
+
+#pragma endregion
+
+#pragma region RESOURCES
+
+void *ecs_world_set_resource(const ecs_world *const world_ref, component_id resource, const void *data)
+{
+    size_t size = ecs_get_component_size(world_ref->components_owning, resource);
+    size_t align = ecs_get_component_align(world_ref->components_owning, resource);
+    const ecs_type_info *hooks = ecs_get_component_hooks(world_ref->components_owning, resource);
+
+    void *storage = ecs_resource_index_set(world_ref->resources_owning, resource, size, align, hooks, data);
+    if (storage == NULL)
+        caff_log_warn("[ECS_WORLD] Resources must be registered components with data\n");
+
+    return storage;
+}
+
+void *ecs_world_get_resource(const ecs_world *const world_ref, component_id resource)
+{
+    return ecs_resource_index_get(world_ref->resources_owning, resource);
+}
+
+void ecs_world_remove_resource(const ecs_world *const world_ref, component_id resource)
+{
+    ecs_resource_index_remove(world_ref->resources_owning, resource);
 }
 
 #pragma endregion
@@ -308,28 +1976,91 @@ void ecs_world_remove_entity_component(const ecs_world *const world_ref, entity_
 
 void ecs_worl_register_system(const ecs_world *const world_ref, ecs_query *query_owning, ecs_system system)
 {
-    const component_id *comps = ecs_query_get_components(query_owning);
-    uint32_t comp_count = ecs_query_get_count(query_owning);
+    ecs_world_add_system(world_ref, query_owning, system, false);
+}
+
+void ecs_world_register_parallel_system(const ecs_world *const world_ref, ecs_query *query_owning, ecs_system system)
+{
+    ecs_world_add_system(world_ref, query_owning, system, true);
+}
+
+static void ecs_world_add_system(const ecs_world *const world_ref, ecs_query *query_owning, ecs_system system, bool parallel)
+{
+    archetype_id *matched = NULL;
+    uint32_t matched_count = ecs_world_match_query(world_ref, query_owning, &matched);
+
+    ecs_system_index_add(world_ref->systems_owning, query_owning, matched, matched_count, system, parallel);
+
+    CFF_RELEASE(matched);
+}
+
+ecs_iterator *ecs_world_query_iter(const ecs_world *const world_ref, ecs_query *query)
+{
+    ecs_world_update_hierarchy(world_ref);
+
+    ecs_iterator *it = ecs_system_index_get_cache(world_ref->systems_owning, query);
+    if (it != NULL)
+        return it;
+
+    // first use, later archetypes are matched as they are created
+    archetype_id *matched = NULL;
+    uint32_t matched_count = ecs_world_match_query(world_ref, query, &matched);
+
+    it = ecs_system_index_add_cache(world_ref->systems_owning, query, matched, matched_count);
+
+    CFF_RELEASE(matched);
+    return it;
+}
+
+static uint32_t ecs_world_match_query(const ecs_world *const world_ref, const ecs_query *const query_ref, archetype_id **matched_out)
+{
+    const component_id *comps = ecs_query_get_components(query_ref);
+    uint32_t comp_count = ecs_query_get_count(query_ref);
+
+    if (comp_count == 0)
+    {
+        // without required components every archetype is a candidate
+        uint32_t arch_count = ecs_archetype_get_generated_count(world_ref->archetypes_owning);
+        archetype_id *matched = (archetype_id *)CFF_ALLOC(sizeof(archetype_id) * (arch_count ? arch_count : 1), "QUERY MATCHED ARCHETYPES");
+        uint32_t matched_count = 0;
+
+        for (archetype_id arch_id = 0; arch_id < arch_count; arch_id++)
+        {
+            if (ecs_storage_index_get(world_ref->storages_owning, arch_id) == NULL)
+                continue;
+
+            if (ecs_world_is_archetype_valid(world_ref, arch_id, query_ref))
+            {
+                matched[matched_count] = arch_id;
+                matched_count++;
+            }
+        }
+
+        *matched_out = matched;
+        return matched_count;
+    }
 
+    // only the archetypes of the rarest component can match
     component_id min_deps = ecs_component_dependency_get_less_dependencies(world_ref->dependencies_owning, comps, comp_count);
 
     const archetype_id *dependencies = NULL;
     uint32_t dep_count = ecs_component_dependency_get_dependencies(world_ref->dependencies_owning, min_deps, &dependencies);
 
-    archetype_id eleged[dep_count];
-    uint32_t eleged_count = 0;
+    archetype_id *matched = (archetype_id *)CFF_ALLOC(sizeof(archetype_id) * (dep_count ? dep_count : 1), "QUERY MATCHED ARCHETYPES");
+    uint32_t matched_count = 0;
 
     for (size_t i = 0; i < dep_count; i++)
     {
         archetype_id arch_id = dependencies[i];
-        if (ecs_world_is_archetype_valid(world_ref, arch_id, query_owning))
+        if (ecs_world_is_archetype_valid(world_ref, arch_id, query_ref))
         {
-            eleged[eleged_count] = arch_id;
-            eleged_count++;
+            matched[matched_count] = arch_id;
+            matched_count++;
         }
     }
 
-    ecs_system_index_add(world_ref->systems_owning, query_owning, eleged, eleged_count, system);
+    *matched_out = matched;
+    return matched_count;
 }
 
 #pragma endregion
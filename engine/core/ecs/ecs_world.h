@@ -2,26 +2,101 @@
 
 #include "ecs_types.h"
 #include "ecs_query.h"
+#include "ecs_command_buffer.h"
 
 typedef struct ecs_world ecs_world;
 
 ecs_world *ecs_world_new();
 void ecs_world_release(const ecs_world *const world_owning);
 
-CAFF_API component_id ecs_world_add_component(const ecs_world *const world_ref, const char *name, size_t size, size_t align);
+// hooks may be NULL for plain data components, they are copied
+CAFF_API component_id ecs_world_add_component(const ecs_world *const world_ref, const char *name, size_t size, size_t align, const ecs_type_info *const hooks);
+// sparse components live in a set keyed by entity instead of the archetypes, adding and removing them never moves the entity,
+// queries filter the rows of the entities that have them and read them with ecs_iterator_get_sparse
+CAFF_API component_id ecs_world_add_sparse_component(const ecs_world *const world_ref, const char *name, size_t size, size_t align, const ecs_type_info *const hooks);
 CAFF_API component_id ecs_world_add_tag(const ecs_world *const world_ref, const char *name);
+// row tags are kept as one bit per row of the storage instead of forking the archetype, adding and removing them never moves the entity,
+// queries with them scan the tag bits of the rows and aligned queries check them with ecs_iterator_has_row_tag
+CAFF_API component_id ecs_world_add_row_tag(const ecs_world *const world_ref, const char *name);
+// shared components hold one value per group of entities, every value is a component of its own and entities with the same value
+// share a storage, systems read it once per storage with ecs_iterator_get_shared, values are compared byte by byte
+CAFF_API component_id ecs_world_add_shared_component(const ecs_world *const world_ref, const char *name, size_t size, size_t align, const ecs_type_info *const hooks);
+// value component of data, registered the first time it is asked for, values must be asked for outside of parallel systems,
+// ecs_world_set_entity_component with the shared component does it for one entity and may be deferred
+CAFF_API component_id ecs_world_shared_value(const ecs_world *const world_ref, component_id component, const void *data);
 CAFF_API component_id ecs_world_get_component(const ecs_world *const world_ref, const char *name);
 CAFF_API void ecs_world_remove_component(const ecs_world *const world_ref, component_id id);
 
+// (relation, target) pairs are components registered the first time they are asked for, with the size and hooks of the relation,
+// entities sharing a pair share a storage, pairs must be asked for outside of parallel systems
+CAFF_API component_id ecs_world_pair(const ecs_world *const world_ref, component_id relation, entity_id target);
+CAFF_API component_id ecs_world_pair_relation(const ecs_world *const world_ref, component_id pair);
+CAFF_API entity_id ecs_world_pair_target(const ecs_world *const world_ref, component_id pair);
+// built-in exclusive relation, a new (ChildOf, parent) pair replaces the previous one and destroying a parent destroys its children,
+// queries built with ECS_QUERY_HIERARCHY visit every parent before its children
+CAFF_API component_id ecs_world_child_of(const ecs_world *const world_ref);
+// INVALID_ID as parent makes the entity a root, while systems run the change is recorded and applied on flush
+CAFF_API void ecs_world_set_parent(const ecs_world *const world_ref, entity_id entity, entity_id parent);
+CAFF_API entity_id ecs_world_get_parent(const ecs_world *const world_ref, entity_id entity);
+// number of ChildOf ancestors of the entity
+CAFF_API uint32_t ecs_world_get_depth(const ecs_world *const world_ref, entity_id entity);
+
+// while systems run the archetype is only registered, its storage is set up on flush
 CAFF_API archetype_id ecs_world_add_archetype(const ecs_world *const world_ref, ecs_archetype archetype);
 CAFF_API void ecs_world_remove_archetype(const ecs_world *const world_ref, archetype_id id);
 
 CAFF_API entity_id ecs_world_create_entity(const ecs_world *const world_ref, archetype_id id);
 CAFF_API void ecs_world_destroy_entity(const ecs_world *const world_ref, entity_id id);
+CAFF_API void ecs_world_create_entities(const ecs_world *const world_ref, archetype_id id, uint32_t count, entity_id *out_ids);
+// every new entity starts with values[i] in components[i]
+CAFF_API void ecs_world_create_entities_with(const ecs_world *const world_ref, archetype_id id, uint32_t count, const component_id *components, const void *const *values, uint32_t values_count, entity_id *out_ids);
+// duplicated ids are destroyed once
+CAFF_API void ecs_world_destroy_entities(const ecs_world *const world_ref, const entity_id *ids, uint32_t count);
+// prefabs are template entities with the built-in Prefab tag, systems and cached queries skip them unless they require the tag
+CAFF_API component_id ecs_world_prefab(const ecs_world *const world_ref);
+CAFF_API entity_id ecs_world_create_prefab(const ecs_world *const world_ref, archetype_id id);
+// count new entities in the archetype of the prefab without the Prefab tag, every column is filled from the prefab row at once,
+// out_ids may be NULL
+CAFF_API void ecs_world_instantiate(const ecs_world *const world_ref, entity_id prefab, uint32_t count, entity_id *out_ids);
+CAFF_API bool ecs_world_entity_alive(const ecs_world *const world_ref, entity_id entity);
 CAFF_API void *ecs_world_get_entity_component(const ecs_world *const world_ref, entity_id entity, component_id component);
 CAFF_API void ecs_world_set_entity_component(const ecs_world *const world_ref, entity_id entity, component_id component, void *data);
 CAFF_API void ecs_world_add_entity_component(const ecs_world *const world_ref, entity_id entity, component_id component);
 CAFF_API void ecs_world_remove_entity_component(const ecs_world *const world_ref, entity_id entity, component_id component);
+// moves every entity sharing an archetype at once, duplicated ids are moved once
+CAFF_API void ecs_world_add_entities_component(const ecs_world *const world_ref, const entity_id *ids, uint32_t count, component_id component);
+CAFF_API void ecs_world_remove_entities_component(const ecs_world *const world_ref, const entity_id *ids, uint32_t count, component_id component);
+// disabled entities and components stay in their storage, queries skip their rows
+CAFF_API void ecs_world_set_entity_enabled(const ecs_world *const world_ref, entity_id entity, bool enabled);
+CAFF_API bool ecs_world_is_entity_enabled(const ecs_world *const world_ref, entity_id entity);
+CAFF_API void ecs_world_set_entity_component_enabled(const ecs_world *const world_ref, entity_id entity, component_id component, bool enabled);
+CAFF_API bool ecs_world_is_entity_component_enabled(const ecs_world *const world_ref, entity_id entity, component_id component);
 CAFF_API void ecs_worl_register_system(const ecs_world *const world_ref, ecs_query *query, ecs_system system);
+// the system may be called concurrently with disjoint row ranges of the same storage
+CAFF_API void ecs_world_register_parallel_system(const ecs_world *const world_ref, ecs_query *query, ecs_system system);
+// the world takes the query on its first use and keeps its matches up to date, later calls restart the iteration,
+// structural changes made while iterating must go through a command buffer
+CAFF_API ecs_iterator *ecs_world_query_iter(const ecs_world *const world_ref, ecs_query *query);
+
+// observers are delivered in batches by ecs_world_flush_commands, changes made outside of a step wait for the next flush,
+// a query observer fires when an entity starts or stops matching the query and on sets of its terms, its sparse and row tag terms are ignored
+CAFF_API uint32_t ecs_world_observe(const ecs_world *const world_ref, ecs_observer_event event, component_id component, ecs_observer observer, void *context);
+CAFF_API uint32_t ecs_world_observe_query(const ecs_world *const world_ref, ecs_observer_event event, ecs_query *query, ecs_observer observer, void *context);
+CAFF_API void ecs_world_remove_observer(const ecs_world *const world_ref, uint32_t observer_id);
+
+// resources are world wide values of a registered component, they live outside of the archetypes,
+// set creates the resource on its first call and copies data into it, the pointers stay valid until the resource is removed
+CAFF_API void *ecs_world_set_resource(const ecs_world *const world_ref, component_id resource, const void *data);
+CAFF_API void *ecs_world_get_resource(const ecs_world *const world_ref, component_id resource);
+CAFF_API void ecs_world_remove_resource(const ecs_world *const world_ref, component_id resource);
+
+// structural changes made while systems run are recorded here and applied by ecs_world_flush_commands
+CAFF_API ecs_command_buffer *ecs_world_get_command_buffer(const ecs_world *const world_ref);
+CAFF_API void ecs_world_flush_commands(const ecs_world *const world_ref);
+
+CAFF_API void ecs_world_set_storage_layout(const ecs_world *const world_ref, ecs_storage_layout layout);
+// gives back the storage capacity removed entities left behind and packs small storages in a single block, meant for idle frames,
+// stops once budget_us is spent and resumes there on the next call, returns true when every storage was visited
+CAFF_API bool ecs_world_compact(const ecs_world *const world_ref, uint32_t budget_us);
 
 void ecs_world_step(const ecs_world *const world_ref, double delta_time);
\ No newline at end of file
@@ -8,6 +8,10 @@ typedef void (*cff_platform_mouse_move_clkb)(uint32_t x, uint32_t y);
 typedef void (*cff_platform_mouse_scroll_clkb)(int32_t dir);
 typedef void (*cff_platform_quit_clbk)(void);
 typedef void (*cff_platform_resize_clbk)(uint32_t width, uint32_t lenght);
+typedef uint32_t (*cff_thread_fn)(void *data);
+
+typedef void *cff_thread;
+typedef void *cff_semaphore;
 
 bool cff_platform_init(char *name);
 
@@ -138,4 +142,62 @@ const char *cff_get_app_directory();
 
 const char *cff_get_app_data_directory();
 
-void cff_platform_sleep(uint64_t ms);
\ No newline at end of file
+void cff_platform_sleep(uint64_t ms);
+
+/**
+ * @brief Starts a new thread running the given function.
+ *
+ * @param function The function executed by the thread.
+ * @param data The argument passed to the function.
+ * @return A handle to the thread, or NULL on failure.
+ */
+cff_thread cff_platform_thread_create(cff_thread_fn function, void *data);
+
+/**
+ * @brief Waits for a thread to finish and releases its handle.
+ *
+ * @param thread The thread to wait for.
+ */
+void cff_platform_thread_join(cff_thread thread);
+
+/**
+ * @brief Gives the rest of the current time slice to another thread.
+ */
+void cff_platform_thread_yield();
+
+/**
+ * @brief Retrieves the number of logical processors.
+ *
+ * @return The number of logical processors, at least 1.
+ */
+uint32_t cff_platform_processor_count();
+
+/**
+ * @brief Creates a counting semaphore.
+ *
+ * @param initial_count The initial count of the semaphore.
+ * @return A handle to the semaphore, or NULL on failure.
+ */
+cff_semaphore cff_platform_semaphore_create(uint32_t initial_count);
+
+/**
+ * @brief Blocks until the semaphore count is positive and decrements it.
+ *
+ * @param semaphore The semaphore to wait on.
+ */
+void cff_platform_semaphore_wait(cff_semaphore semaphore);
+
+/**
+ * @brief Increments the semaphore count, waking up to count waiting threads.
+ *
+ * @param semaphore The semaphore to signal.
+ * @param count How many times the semaphore is signaled.
+ */
+void cff_platform_semaphore_post(cff_semaphore semaphore, uint32_t count);
+
+/**
+ * @brief Releases a semaphore created with cff_platform_semaphore_create.
+ *
+ * @param semaphore The semaphore to release.
+ */
+void cff_platform_semaphore_release(cff_semaphore semaphore);
\ No newline at end of file
@@ -0,0 +1,112 @@
+#include "caffeine_platform.h"
+#include "../core/caffeine_logging.h"
+
+#ifdef CFF_LINUX
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <unistd.h>
+
+typedef struct
+{
+  pthread_t handle;
+  cff_thread_fn function;
+  void *data;
+} linux_thread;
+
+static void *_linux_thread_proc(void *param)
+{
+  linux_thread *thread = (linux_thread *)param;
+  thread->function(thread->data);
+  return NULL;
+}
+
+cff_thread cff_platform_thread_create(cff_thread_fn function, void *data)
+{
+  linux_thread *thread = (linux_thread *)cff_malloc(sizeof(linux_thread));
+  if (thread == NULL)
+  {
+    caff_log(LOG_LEVEL_ERROR, "Failed to allocate thread\n");
+    return NULL;
+  }
+
+  thread->function = function;
+  thread->data = data;
+
+  if (pthread_create(&thread->handle, NULL, _linux_thread_proc, thread) != 0)
+  {
+    caff_log(LOG_LEVEL_ERROR, "Failed to create thread\n");
+    cff_free(thread);
+    return NULL;
+  }
+
+  return (cff_thread)thread;
+}
+
+void cff_platform_thread_join(cff_thread thread)
+{
+  linux_thread *linux_handle = (linux_thread *)thread;
+  pthread_join(linux_handle->handle, NULL);
+  cff_free(linux_handle);
+}
+
+void cff_platform_thread_yield()
+{
+  sched_yield();
+}
+
+uint32_t cff_platform_processor_count()
+{
+  long count = sysconf(_SC_NPROCESSORS_ONLN);
+  return count > 0 ? (uint32_t)count : 1;
+}
+
+cff_semaphore cff_platform_semaphore_create(uint32_t initial_count)
+{
+  sem_t *semaphore = (sem_t *)cff_malloc(sizeof(sem_t));
+  if (semaphore == NULL)
+  {
+    caff_log(LOG_LEVEL_ERROR, "Failed to allocate semaphore\n");
+    return NULL;
+  }
+
+  if (sem_init(semaphore, 0, initial_count) != 0)
+  {
+    caff_log(LOG_LEVEL_ERROR, "Failed to create semaphore\n");
+    cff_free(semaphore);
+    return NULL;
+  }
+
+  return (cff_semaphore)semaphore;
+}
+
+void cff_platform_semaphore_wait(cff_semaphore semaphore)
+{
+  // retry when a signal interrupts the wait, any other error would fail again
+  while (sem_wait((sem_t *)semaphore) != 0)
+  {
+    if (errno != EINTR)
+    {
+      caff_log(LOG_LEVEL_ERROR, "Failed to wait on semaphore: errno %d\n", errno);
+      return;
+    }
+  }
+}
+
+void cff_platform_semaphore_post(cff_semaphore semaphore, uint32_t count)
+{
+  for (uint32_t i = 0; i < count; i++)
+  {
+    sem_post((sem_t *)semaphore);
+  }
+}
+
+void cff_platform_semaphore_release(cff_semaphore semaphore)
+{
+  sem_destroy((sem_t *)semaphore);
+  cff_free(semaphore);
+}
+
+#endif
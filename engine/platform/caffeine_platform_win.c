@@ -460,4 +460,78 @@ void cff_platform_sleep(uint64_t ms)
 {
   Sleep(ms);
 }
+
+typedef struct
+{
+  cff_thread_fn function;
+  void *data;
+} win32_thread_start;
+
+static DWORD WINAPI _win32_thread_proc(LPVOID param)
+{
+  win32_thread_start start = *(win32_thread_start *)param;
+  cff_free(param);
+  return (DWORD)start.function(start.data);
+}
+
+cff_thread cff_platform_thread_create(cff_thread_fn function, void *data)
+{
+  win32_thread_start *start = (win32_thread_start *)cff_malloc(sizeof(win32_thread_start));
+  if (start == NULL)
+  {
+    caff_log(LOG_LEVEL_ERROR, "Failed to allocate thread\n");
+    return NULL;
+  }
+
+  start->function = function;
+  start->data = data;
+
+  HANDLE thread = CreateThread(NULL, 0, _win32_thread_proc, start, 0, NULL);
+  if (thread == NULL)
+  {
+    caff_log(LOG_LEVEL_ERROR, "Failed to create thread\n");
+    cff_free(start);
+    return NULL;
+  }
+
+  return (cff_thread)thread;
+}
+
+void cff_platform_thread_join(cff_thread thread)
+{
+  WaitForSingleObject((HANDLE)thread, INFINITE);
+  CloseHandle((HANDLE)thread);
+}
+
+void cff_platform_thread_yield()
+{
+  SwitchToThread();
+}
+
+uint32_t cff_platform_processor_count()
+{
+  SYSTEM_INFO info = {0};
+  GetSystemInfo(&info);
+  return info.dwNumberOfProcessors > 0 ? (uint32_t)info.dwNumberOfProcessors : 1;
+}
+
+cff_semaphore cff_platform_semaphore_create(uint32_t initial_count)
+{
+  return (cff_semaphore)CreateSemaphoreA(NULL, (LONG)initial_count, LONG_MAX, NULL);
+}
+
+void cff_platform_semaphore_wait(cff_semaphore semaphore)
+{
+  WaitForSingleObject((HANDLE)semaphore, INFINITE);
+}
+
+void cff_platform_semaphore_post(cff_semaphore semaphore, uint32_t count)
+{
+  ReleaseSemaphore((HANDLE)semaphore, (LONG)count, NULL);
+}
+
+void cff_platform_semaphore_release(cff_semaphore semaphore)
+{
+  CloseHandle((HANDLE)semaphore);
+}
 #endif
\ No newline at end of file